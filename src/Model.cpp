@@ -1,20 +1,166 @@
 #include "Model.hpp"
+#include "SandboxMeshLoader.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
 
 namespace VulkanSandbox
 {
-	Model::Model(VulkanDevice& device, std::vector<Vertex>& vertices)
-		: vulkanDevice(device)
+	// Hashes every component of a Model::Vertex so identical vertices in triangle soup can be found
+	struct VertexHash {
+		size_t operator()(const Model::Vertex& vertex) const
+		{
+			size_t seed = 0;
+			auto combine = [&seed](float value) {
+				seed ^= std::hash<float>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			};
+			combine(vertex.position.x);
+			combine(vertex.position.y);
+			combine(vertex.colour.x);
+			combine(vertex.colour.y);
+			combine(vertex.colour.z);
+			combine(vertex.colour.w);
+			combine(vertex.uv.x);
+			combine(vertex.uv.y);
+			return seed;
+		}
+	};
+
+	void Model::Builder::addTriangleSoup(const std::vector<Vertex>& soup)
+	{
+		assert(soup.size() % 3 == 0 && "Triangle soup must contain three vertices per triangle!");
+
+		// Seed the lookup with what's already in the builder, so repeated calls keep welding
+		std::unordered_map<Vertex, uint32_t, VertexHash> uniqueVertices;
+		uniqueVertices.reserve(vertices.size() + soup.size());
+		for (uint32_t i = 0; i < vertices.size(); i++)
+			uniqueVertices.emplace(vertices[i], i);
+
+		indices.reserve(indices.size() + soup.size());
+		for (const Vertex& vertex : soup)
+		{
+			auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(vertices.size()));
+			if (inserted.second)
+				vertices.push_back(vertex);
+			indices.push_back(inserted.first->second);
+		}
+	}
+
+	Model::Model(VulkanDevice& device, const std::vector<Vertex>& vertices, MemoryMode memoryMode)
+		: vulkanDevice(device), memoryMode(memoryMode)
 	{
 		createVertexBuffers(vertices);
 	}
 
+	Model::Model(VulkanDevice& device, const Builder& builder, MemoryMode memoryMode)
+		: vulkanDevice(device), memoryMode(memoryMode)
+	{
+		createVertexBuffers(builder.vertices);
+		createIndexBuffers(builder.indices);
+	}
+
+	Model::Model(VulkanDevice& device, VulkanUploadBatcher& uploader, const Builder& builder)
+		: vulkanDevice(device), memoryMode(MemoryMode::DeviceLocal)
+	{
+		createVertexBuffers(builder.vertices, &uploader);
+		createIndexBuffers(builder.indices, &uploader);
+	}
+
+	Model::Model(
+		VulkanDevice& device,
+		VulkanUploadBatcher* uploader,
+		const Vertex* vertices,
+		uint32_t vertexCount,
+		const void* indices,
+		uint32_t indexCount,
+		VkIndexType indexType,
+		const Bounds& bounds)
+		: vulkanDevice(device), memoryMode(MemoryMode::DeviceLocal), vertexCount(vertexCount), bounds(bounds), indexType(indexType), indexCount(indexCount)
+	{
+		assert(vertexCount >= 3 && "Model's vertex count must be at least 3! ie. needs at least one polygon.");
+		assert(indexCount % 3 == 0 && "Model's index count must be a multiple of 3! ie. whole triangles.");
+
+		createDeviceLocalBuffer(
+			vertices, 
+			vertexCount * sizeof(Vertex), 
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+			vertexBuffer, 
+			vertexAllocation, 
+			uploader);
+
+		hasIndexBuffer = indexCount > 0;
+		if (hasIndexBuffer)
+		{
+			createDeviceLocalBuffer(
+				indices, 
+				indexCount * (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)), 
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
+				indexBuffer, 
+				indexAllocation, 
+				uploader);
+		}
+	}
+
+	Model::Model(VulkanDevice& device, const UploadedBuffers& buffers)
+		: vulkanDevice(device), memoryMode(MemoryMode::DeviceLocal)
+	{
+		vertexBuffer = buffers.vertexBuffer;
+		vertexAllocation = buffers.vertexAllocation;
+		vertexCount = buffers.vertexCount;
+		bounds = buffers.bounds;
+		hasIndexBuffer = buffers.indexBuffer != VK_NULL_HANDLE;
+		indexBuffer = buffers.indexBuffer;
+		indexAllocation = buffers.indexAllocation;
+		indexCount = buffers.indexCount;
+		indexType = buffers.indexType;
+	}
+
 	Model::~Model()
 	{
-		vkDestroyBuffer(vulkanDevice.device(), vertexBuffer, nullptr);
-		vkFreeMemory(vulkanDevice.device(), vertexBufferMemory, nullptr);
+		vulkanDevice.destroyBuffer(vertexBuffer, vertexAllocation);
+		if (hasIndexBuffer)
+			vulkanDevice.destroyBuffer(indexBuffer, indexAllocation);
+	}
+
+	std::unique_ptr<Model> Model::loadFromFile(
+		VulkanDevice& device,
+		VulkanUploadBatcher* uploader,
+		const std::string& filepath,
+		bool* loadedFromCache)
+	{
+		const MeshLoader::SourceStamp stamp = MeshLoader::getSourceStamp(filepath);
+		const std::string cachePath = MeshLoader::cachePathFor(filepath);
+
+		// Nothing to parse, the mapped vertices/indices are copied straight into staging
+		MeshLoader::MappedMesh mesh;
+		if (MeshLoader::mapCacheFile(cachePath, stamp, mesh))
+		{
+			if (loadedFromCache)
+				*loadedFromCache = true;
+			return std::make_unique<Model>(
+				device, uploader, mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, mesh.indexType, mesh.bounds);
+		}
+
+		Model::Builder builder = MeshLoader::parseObjFile(filepath);
+		try
+		{
+			MeshLoader::writeCacheFile(cachePath, builder, stamp);
+		}
+		catch (const std::exception& e)
+		{
+			// Only costs the next run its fast path
+			std::cout << "Mesh cache: " << e.what() << std::endl;
+		}
+
+		if (loadedFromCache)
+			*loadedFromCache = false;
+		if (uploader)
+			return std::make_unique<Model>(device, *uploader, builder);
+		return std::make_unique<Model>(device, builder);
 	}
 
 	void Model::bind(VkCommandBuffer commandBuffer)
@@ -22,34 +168,164 @@ namespace VulkanSandbox
 		VkBuffer buffers[] = { vertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+		if (hasIndexBuffer)
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+	}
+
+	void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
+	{
+		if (hasIndexBuffer)
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
+		else
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 	}
 
-	void Model::draw(VkCommandBuffer commandBuffer)
+	void Model::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset)
 	{
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		// A single command, so the stride is never used
+		if (hasIndexBuffer)
+			vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+		else
+			vkCmdDrawIndirect(commandBuffer, buffer, offset, 1, sizeof(VkDrawIndirectCommand));
 	}
 
-	void Model::createVertexBuffers(std::vector<Vertex>& vertices)
+	void Model::writeIndirectCommand(void* command, uint32_t instanceCount, uint32_t firstInstance) const
+	{
+		if (hasIndexBuffer)
+		{
+			VkDrawIndexedIndirectCommand indexedCommand{ indexCount, instanceCount, 0, 0, firstInstance };
+			memcpy(command, &indexedCommand, sizeof(indexedCommand));
+		}
+		else
+		{
+			VkDrawIndirectCommand vertexCommand{ vertexCount, instanceCount, 0, firstInstance };
+			memcpy(command, &vertexCommand, sizeof(vertexCommand));
+		}
+	}
+
+	void Model::createVertexBuffers(const std::vector<Vertex>& vertices, VulkanUploadBatcher* uploader)
 	{
 		vertexCount = static_cast<uint32_t>(vertices.size());
 		assert(vertexCount >= 3 && "Model's vertex count must be at least 3! ie. needs at least one polygon.");
+		bounds = Bounds::fromVertices(vertices.data(), vertices.size());
 
 		// Calculate the vertex buffer size and use that to create the buffer/its associated GPU memory
 		VkDeviceSize vertexBufferSize = vertexCount * sizeof(vertices[0]);
-		vulkanDevice.createBuffer(
+
+		if (memoryMode == MemoryMode::HostVisible)
+		{
+			vulkanDevice.createBuffer(
+				vertexBufferSize, 
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+				vertexBuffer, 
+				vertexAllocation);
+
+			// Host visible allocations come back persistently mapped (VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensures 
+			// writes through the pointer propagate to the GPU without flushing), updateVertices(..) writes through it too
+			memcpy(vertexAllocation.mapped, vertices.data(), static_cast<size_t>(vertexBufferSize));
+			return;
+		}
+
+		createDeviceLocalBuffer(
+			vertices.data(), 
 			vertexBufferSize, 
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
 			vertexBuffer, 
-			vertexBufferMemory);
+			vertexAllocation,
+			uploader);
+	}
 
-		// Now create a data buffer on the CPUl, map it to the GPU vertexBufferMemory (above 
-		// VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ensures changes to this buffer will propagate 
-		// to the mapped GPU buffer), and then write our vertices.data() for the vertex shader
-		void* vertexBufferData;
-		vkMapMemory(vulkanDevice.device(), vertexBufferMemory, 0, vertexBufferSize, 0, &vertexBufferData);
-		memcpy(vertexBufferData, vertices.data(), static_cast<size_t>(vertexBufferSize));
-		vkUnmapMemory(vulkanDevice.device(), vertexBufferMemory);
+	void Model::createIndexBuffers(const std::vector<uint32_t>& indices, VulkanUploadBatcher* uploader)
+	{
+		indexCount = static_cast<uint32_t>(indices.size());
+		hasIndexBuffer = indexCount > 0;
+		if (!hasIndexBuffer)
+			return;
+
+		assert(indexCount % 3 == 0 && "Model's index count must be a multiple of 3! ie. whole triangles.");
+
+		// Half the index memory/bandwidth whenever every index fits in 16 bits
+		indexType = indexTypeFor(vertexCount);
+		if (indexType == VK_INDEX_TYPE_UINT16)
+		{
+			std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+			createDeviceLocalBuffer(
+				shortIndices.data(), 
+				indexCount * sizeof(uint16_t), 
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
+				indexBuffer, 
+				indexAllocation,
+				uploader);
+		}
+		else
+		{
+			createDeviceLocalBuffer(
+				indices.data(), 
+				indexCount * sizeof(uint32_t), 
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
+				indexBuffer, 
+				indexAllocation,
+				uploader);
+		}
+	}
+
+	void Model::createDeviceLocalBuffer(
+		const void* data,
+		VkDeviceSize size,
+		VkBufferUsageFlags usage,
+		VkBuffer& buffer,
+		VulkanAllocation& allocation,
+		VulkanUploadBatcher* uploader)
+	{
+		if (uploader != nullptr)
+		{
+			vulkanDevice.createBuffer(
+				size,
+				usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				buffer,
+				allocation);
+
+			// Vertex and index data are only ever read by the input assembler
+			VkAccessFlags dstAccess = (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) ? VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			uploadTicket = std::max(uploadTicket, uploader->uploadBuffer(buffer, 0, data, size, dstAccess, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT));
+			return;
+		}
+
+		// Write the data into a host visible staging buffer first...
+		VkBuffer stagingBuffer;
+		VulkanAllocation stagingAllocation;
+		vulkanDevice.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			stagingAllocation);
+
+		memcpy(stagingAllocation.mapped, data, static_cast<size_t>(size));
+
+		// ...then copy it on the GPU into device local memory, which the vertex shader can read 
+		// without going over the PCIe bus every frame (on discrete GPUs)
+		vulkanDevice.createBuffer(
+			size,
+			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			buffer,
+			allocation);
+		vulkanDevice.copyBuffer(stagingBuffer, buffer, size);
+
+		vulkanDevice.destroyBuffer(stagingBuffer, stagingAllocation);
+	}
+
+	void Model::updateVertices(const std::vector<Vertex>& vertices)
+	{
+		assert(memoryMode == MemoryMode::HostVisible && "Only HostVisible models can be updated after creation!");
+		assert(vertices.size() == vertexCount && "Updated vertices must match the model's vertex count!");
+
+		memcpy(vertexAllocation.mapped, vertices.data(), vertices.size() * sizeof(Vertex));
+		bounds = Bounds::fromVertices(vertices.data(), vertices.size());
 	}
 	
 	std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions()
@@ -64,7 +340,7 @@ namespace VulkanSandbox
 	
 	std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions()
 	{
-		std::vector<VkVertexInputAttributeDescription> vertexAttribDescriptions(2); // 2 attributes per vertex (pos, colour)
+		std::vector<VkVertexInputAttributeDescription> vertexAttribDescriptions(3); // 3 attributes per vertex (pos, colour, uv)
 		// Vertex position
 		vertexAttribDescriptions[0].location = 0;
 		vertexAttribDescriptions[0].binding = 0;
@@ -75,6 +351,46 @@ namespace VulkanSandbox
 		vertexAttribDescriptions[1].binding = 0; // same because we are interleaving attribs in our vertex buffer
 		vertexAttribDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
 		vertexAttribDescriptions[1].offset = offsetof(Vertex, Vertex::colour);
+		// Texture coordinates, after the instance attributes (locations 2-5) so those didn't have to move
+		vertexAttribDescriptions[2].location = 6;
+		vertexAttribDescriptions[2].binding = 0;
+		vertexAttribDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+		vertexAttribDescriptions[2].offset = offsetof(Vertex, Vertex::uv);
 		return vertexAttribDescriptions;
 	}
-}
+
+	std::vector<VkVertexInputBindingDescription> Model::InstanceData::getBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = BINDING;
+		bindingDescriptions[0].stride = sizeof(InstanceData);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE; // advance once per instance rather than per vertex
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Model::InstanceData::getAttributeDescriptions()
+	{
+		// Locations continue on from Model::Vertex's attributes
+		std::vector<VkVertexInputAttributeDescription> instanceAttribDescriptions(4);
+		// Transform matrix, a mat2 attribute takes up one location per column
+		instanceAttribDescriptions[0].location = 2;
+		instanceAttribDescriptions[0].binding = BINDING;
+		instanceAttribDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		instanceAttribDescriptions[0].offset = offsetof(InstanceData, InstanceData::transform);
+		instanceAttribDescriptions[1].location = 3;
+		instanceAttribDescriptions[1].binding = BINDING;
+		instanceAttribDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+		instanceAttribDescriptions[1].offset = offsetof(InstanceData, InstanceData::transform) + sizeof(glm::vec2);
+		// Offset
+		instanceAttribDescriptions[2].location = 4;
+		instanceAttribDescriptions[2].binding = BINDING;
+		instanceAttribDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+		instanceAttribDescriptions[2].offset = offsetof(InstanceData, InstanceData::offset);
+		// Colour
+		instanceAttribDescriptions[3].location = 5;
+		instanceAttribDescriptions[3].binding = BINDING;
+		instanceAttribDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		instanceAttribDescriptions[3].offset = offsetof(InstanceData, InstanceData::colour);
+		return instanceAttribDescriptions;
+	}
+}
\ No newline at end of file
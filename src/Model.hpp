@@ -1,11 +1,15 @@
 #pragma once
 
 #include "VulkanDevice.hpp"
+#include "VulkanUploadBatcher.hpp"
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
+#include <limits>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace VulkanSandbox {
@@ -17,28 +21,160 @@ namespace VulkanSandbox {
 		struct Vertex {
 			glm::vec2 position;
 			glm::vec4 colour;
+			glm::vec2 uv{ 0.0f };
 
 			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+
+			bool operator==(const Vertex& other) const { 
+				return position == other.position && colour == other.colour && uv == other.uv; 
+			}
+		};
+
+		// Axis aligned box around a model's vertex positions, in model space
+		struct Bounds {
+			glm::vec2 min{ 0.0f };
+			glm::vec2 max{ 0.0f };
+
+			static Bounds fromVertices(const Vertex* vertices, size_t count) {
+				Bounds bounds;
+				if (count == 0)
+					return bounds;
+				bounds.min = bounds.max = vertices[0].position;
+				for (size_t i = 1; i < count; i++) {
+					bounds.min = glm::min(bounds.min, vertices[i].position);
+					bounds.max = glm::max(bounds.max, vertices[i].position);
+				}
+				return bounds;
+			}
+		};
+
+		// Collects indexed geometry for a Model. Triangle soup (every triangle lists its own three vertices)
+		// is welded into unique vertices plus indices, so shared corners are only stored and transformed once
+		struct Builder {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+
+			void addTriangleSoup(const std::vector<Vertex>& soup);
+		};
+
+		// Per-instance data streamed through vertex binding 1, so every object sharing a Model can be
+		// drawn with a single instanced draw call. Laid out to also match std430 rules.
+		struct InstanceData {
+			glm::mat2 transform{ 1.0f };
+			alignas(8) glm::vec2 offset;
+			alignas(16) glm::vec4 colour;
+
+			static constexpr uint32_t BINDING = 1;
+
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+		};
+
+		// Device local buffers filled by someone else (ie. VulkanAssetStreamer on the transfer queue), which
+		// a Model can take ownership of instead of uploading the geometry itself
+		struct UploadedBuffers {
+			VkBuffer vertexBuffer = VK_NULL_HANDLE;
+			VulkanAllocation vertexAllocation;
+			uint32_t vertexCount = 0;
+			VkBuffer indexBuffer = VK_NULL_HANDLE; // VK_NULL_HANDLE for non indexed geometry
+			VulkanAllocation indexAllocation;
+			uint32_t indexCount = 0;
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+			Bounds bounds;
+		};
+
+		// 16 bit indices whenever every index fits in them. Inline, so the CPU only mesh loader doesn't need Model.cpp.
+		static VkIndexType indexTypeFor(uint32_t vertexCount) {
+			return vertexCount <= std::numeric_limits<uint16_t>::max() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		}
+
+		// DeviceLocal geometry is uploaded once through a staging buffer, HostVisible geometry stays 
+		// mapped so it can be rewritten with updateVertices(..) (ie. for dynamic geometry)
+		enum class MemoryMode {
+			DeviceLocal,
+			HostVisible
 		};
 
-		Model(VulkanDevice& device, std::vector<Vertex>& vertices);
+		Model(VulkanDevice& device, const std::vector<Vertex>& vertices, MemoryMode memoryMode = MemoryMode::DeviceLocal);
+		// Indexed model, the index buffer is always device local and 16 bit when the vertex count allows it
+		Model(VulkanDevice& device, const Builder& builder, MemoryMode memoryMode = MemoryMode::DeviceLocal);
+		// Device local indexed model whose geometry is queued into uploader's open batch instead of being copied
+		// right away, it must not be drawn before getUploadTicket() has completed
+		Model(VulkanDevice& device, VulkanUploadBatcher& uploader, const Builder& builder);
+		// Same as above, but from vertices/indices already in their final layout (ie. a mapped mesh cache file).
+		// Without an uploader the geometry is copied and waited on immediately.
+		Model(
+			VulkanDevice& device,
+			VulkanUploadBatcher* uploader,
+			const Vertex* vertices,
+			uint32_t vertexCount,
+			const void* indices,
+			uint32_t indexCount,
+			VkIndexType indexType,
+			const Bounds& bounds);
+		// Takes ownership of the buffers, which must have finished uploading before the model is drawn
+		Model(VulkanDevice& device, const UploadedBuffers& buffers);
 		~Model();
 
+		// Loads a mesh file (see MeshLoader::parseObjFile(..)) through its binary cache, which is (re)written
+		// whenever it's missing or stale. loadedFromCache is set to whether the cache could be used.
+		static std::unique_ptr<Model> loadFromFile(
+			VulkanDevice& device,
+			VulkanUploadBatcher* uploader,
+			const std::string& filepath,
+			bool* loadedFromCache = nullptr);
+
 		Model(const Model&) = delete;
 		Model& operator=(const Model&) = delete;
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+		// Same as draw(..), but with the draw parameters read by the GPU from a command in buffer at offset,
+		// ie. one written by writeIndirectCommand(..) and then filled in by a compute shader
+		void drawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset);
+
+		// Writes this model's VkDrawIndexedIndirectCommand (or VkDrawIndirectCommand when not indexed) to command.
+		// instanceCount sits at the same offset in both, so a shader can count instances without knowing which.
+		void writeIndirectCommand(void* command, uint32_t instanceCount, uint32_t firstInstance = 0) const;
+		// Room for either kind of command, so one stride works for every model
+		static constexpr VkDeviceSize INDIRECT_COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
+		// HostVisible models only, the caller must make sure no frame using this model is still in flight
+		void updateVertices(const std::vector<Vertex>& vertices);
+
+		// Computed from the vertices when the model is created (and by updateVertices(..)), used for culling
+		const Bounds& getBounds() const { return bounds; }
+
+		// Only meaningful for models created through a VulkanUploadBatcher, 0 otherwise (nothing to wait for)
+		VulkanUploadBatcher::Ticket getUploadTicket() const { return uploadTicket; }
 
 	private:
 
-		void createVertexBuffers(std::vector<Vertex>& vertices);
+		// Uploads go through uploader when there is one, otherwise they're copied and waited on immediately
+		void createVertexBuffers(const std::vector<Vertex>& vertices, VulkanUploadBatcher* uploader = nullptr);
+		void createIndexBuffers(const std::vector<uint32_t>& indices, VulkanUploadBatcher* uploader = nullptr);
+		void createDeviceLocalBuffer(
+			const void* data,
+			VkDeviceSize size,
+			VkBufferUsageFlags usage,
+			VkBuffer& buffer,
+			VulkanAllocation& allocation,
+			VulkanUploadBatcher* uploader);
 
 		VulkanDevice& vulkanDevice;
+		MemoryMode memoryMode;
 		VkBuffer vertexBuffer;
-		VkDeviceMemory vertexBufferMemory;
+		VulkanAllocation vertexAllocation;
 		uint32_t vertexCount;
+		Bounds bounds;
+
+		bool hasIndexBuffer = false;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VulkanAllocation indexAllocation;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		uint32_t indexCount = 0;
 
+		VulkanUploadBatcher::Ticket uploadTicket = 0;
 	};
 }
@@ -1,4 +1,6 @@
 #include "SandboxApp.hpp"
+#include "SandboxCullKernel.hpp"
+#include "SandboxTransformKernel.hpp"
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_FORCE_RADIANS
@@ -6,24 +8,71 @@
 #include <glm/gtc/constants.hpp>
 
 #include <stdexcept>
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 namespace VulkanSandbox {
 
-	// Temp
-	struct BasicPushConstantData {
-		glm::mat2 transform{ 1.0f };
-		alignas(8) glm::vec2 offset;
-		alignas(16) glm::vec4 colour;
-	};
+	// Regular polygon with 3 to 8 sides, slightly twisted per index so every model's vertices are distinct
+	static Model::Builder createPolygonBuilder(uint32_t modelIndex)
+	{
+		const uint32_t sides = 3 + modelIndex % 6;
+		const float twist = static_cast<float>(modelIndex) * 0.001f;
+		auto corner = [&](uint32_t i) {
+			const float angle = twist + glm::two_pi<float>() * static_cast<float>(i % sides) / sides;
+			glm::vec2 position{ 0.5f * std::cos(angle), 0.5f * std::sin(angle) };
+			return Model::Vertex{ position, glm::vec4(1.0f), position + glm::vec2(0.5f) };
+		};
+
+		std::vector<Model::Vertex> soup;
+		for (uint32_t i = 0; i < sides; i++)
+		{
+			soup.push_back(Model::Vertex{ glm::vec2(0.0f), glm::vec4(1.0f), glm::vec2(0.5f) });
+			soup.push_back(corner(i));
+			soup.push_back(corner(i + 1));
+		}
+
+		Model::Builder builder;
+		builder.addTriangleSoup(soup);
+		return builder;
+	}
 
-	SandboxApp::SandboxApp()
+	SandboxApp::SandboxApp(const SandboxConfig& config)
+		: config(config)
 	{
+		if (!config.benchmarkOutput.empty())
+			benchmark = std::make_unique<SandboxBenchmark>(config.benchmarkOutput);
+		if (config.timelineSemaphore && !frameSync.usesTimelineSemaphore())
+			std::cout << "Frame sync: timeline semaphores not supported, using a fence per frame" << std::endl;
+		if (config.gpuTiming || benchmark)
+		{
+			gpuProfiler = std::make_unique<VulkanGpuProfiler>(vulkanDevice, frameSync.getFramesInFlight());
+			if (!gpuProfiler->isSupported())
+				std::cout << "GPU timing: timestamps not supported on the graphics queue" << std::endl;
+		}
+		// The thread command pools depend on the swap chain's image count, see createCommandBuffers()
+		if (config.recordThreads > 0)
+			recordThreadPool = std::make_unique<SandboxThreadPool>(config.recordThreads);
+
+		// Sized for the initial scene so a stress test doesn't start with a few buffer regrowths
+		frameRingBuffer = std::make_unique<VulkanFrameRingBuffer>(
+			vulkanDevice,
+			frameSync.getFramesInFlight(),
+			std::max<VkDeviceSize>(VulkanFrameRingBuffer::DEFAULT_FRAME_SIZE, config.objectCount * sizeof(Model::InstanceData)));
+		if (config.gpuCulling)
+			gpuCulling = std::make_unique<VulkanGpuCulling>(vulkanDevice, descriptorLayoutCache, frameSync.getFramesInFlight());
 		loadSandboxObjects();
+		simulation = std::make_unique<SandboxSimulation>(scene, config.tickRate, !config.serialUpdate);
+		createDescriptors();
 		createPipelineLayout();
 		recreateSwapChain();
 		createCommandBuffers();
+
+		startupMilliseconds = std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - constructionStart).count();
 	}
 
 	SandboxApp::~SandboxApp()
@@ -35,33 +84,218 @@ namespace VulkanSandbox {
 	{
 		std::cout << "\nMax push constant size: " << vulkanDevice.properties.limits.maxPushConstantsSize << std::endl;
 
-		while (!appWindow.shouldClose()) {
-			glfwPollEvents();
-			drawFrame();
+		uint32_t framesRendered = 0;
+		auto runStart = SandboxBenchmark::Clock::now();
+		auto secondsSinceStart = [&]() {
+			return std::chrono::duration<double>(SandboxBenchmark::Clock::now() - runStart).count();
+		};
+		auto timeLimitReached = [&]() {
+			return config.maxSeconds > 0.0 && secondsSinceStart() >= config.maxSeconds;
+		};
+		// Where the latency samples end, see VulkanSwapChain::takeFrameLatencies(). Only with present wait is that
+		// the present itself, otherwise it's the frame finishing on the GPU.
+		const char* latencySeriesName = vulkanSwapChain->hasPresentTimedLatency() ? "submitToPresent" : "submitToGpuComplete";
+
+		// The first frame's snapshot, every frame after that kicks off the update for the one following it
+		simulation->beginUpdate(0.0);
+		if (benchmark)
+			benchmark->beginRun();
+
+		while (!appWindow.shouldClose() && 
+			(config.maxFrames == 0 || framesRendered < config.maxFrames) && 
+			!timeLimitReached()) 
+		{
+			if (benchmark)
+				benchmark->beginFrame();
+
+			// --low-latency: the previous frame has been presented (or without present wait, rendered) before
+			// input is sampled, so this frame's input isn't queued behind it. The limiter comes after that, its
+			// sleep then also covers the wait.
+			if (config.lowLatency)
+				vulkanSwapChain->waitForLastSubmittedFrame();
+			frameLimiter.waitForNextFrame();
+			if (benchmark && (config.lowLatency || frameLimiter.isEnabled()))
+				benchmark->endPhase("pacing");
+
+			appWindow.pollEvents();
+			if (benchmark)
+				benchmark->endPhase("events");
+
+			// Frame N draws the snapshot started during frame N-1 while the simulation already advances to
+			// "now" for frame N+1, trading one frame of latency for the update overlapping the recording.
+			// With --serial-update, beginUpdate(..) runs right here instead and only the overlap is lost.
+			currentSnapshot = &simulation->waitForSnapshot();
+			// The simulation isn't running right now, so finished uploads can add objects to the scene
+			if (assetStreamer)
+				assetStreamer->pollCompleted();
+			releaseRetiredTextures();
+			simulation->beginUpdate(secondsSinceStart());
+			if (benchmark)
+				benchmark->endPhase("update");
+
+			bool rendered = drawFrame();
+			// Samples of frames from before a swap chain recreation are lost along with the old swap chain
+			for (double latency : vulkanSwapChain->takeFrameLatencies())
+			{
+				frameLatencies.push_back(latency);
+				if (benchmark)
+					benchmark->addSample(latencySeriesName, latency);
+			}
+
+			if (rendered)
+			{
+				framesRendered++;
+				if (benchmark)
+					benchmark->endFrame();
+			}
+			else if (benchmark)
+				benchmark->discardFrame();
 		}
 
-		vkDeviceWaitIdle(vulkanDevice.device());
+		vulkanDevice.waitIdle();
+		if (!frameLatencies.empty())
+		{
+			SandboxBenchmark::PhaseStats latency = SandboxBenchmark::computeStats(frameLatencies);
+			std::cout << "Latency (" << latencySeriesName << "): mean " << latency.mean << " ms, p99 " << latency.p99 << " ms" << std::endl;
+		}
+		// Let the last update finish, the scene must not be touched while it's running
+		simulation->waitForSnapshot();
+		currentSnapshot = nullptr;
+
+		if (benchmark)
+		{
+			benchmark->addMetric("objectCount", static_cast<double>(scene.size()));
+			benchmark->addMetric("headless", config.headless ? 1.0 : 0.0);
+			benchmark->addMetric("recordThreads", static_cast<double>(config.recordThreads));
+			benchmark->addMetric("tickRate", simulation->getTickRate());
+			benchmark->addMetric("simulationTicks", static_cast<double>(simulation->getTickCount()));
+			benchmark->addMetric("transformSimdLevel", static_cast<double>(TransformKernel::detectSimdLevel()));
+			benchmark->addMetric("culling", config.culling ? 1.0 : 0.0);
+			benchmark->addMetric("gpuCulling", gpuCulling ? 1.0 : 0.0);
+			const double recordedFrames = std::max<double>(framesRendered, 1.0);
+			benchmark->addMetric("drawnObjectsPerFrame", totalDrawnObjects / recordedFrames);
+			benchmark->addMetric("culledObjectsPerFrame", totalCulledObjects / recordedFrames);
+			benchmark->addMetric("commandBufferCaching", config.commandBufferCaching ? 1.0 : 0.0);
+			benchmark->addMetric("commandBuffersRecorded", static_cast<double>(recordedCommandBuffers));
+			benchmark->addMetric("commandBuffersReused", static_cast<double>(reusedCommandBuffers));
+			benchmark->addMetric("presentMode", static_cast<double>(vulkanSwapChain->getPresentMode()));
+			benchmark->addMetric("swapChainImages", static_cast<double>(vulkanSwapChain->imageCount()));
+			benchmark->addMetric("fpsLimit", config.fpsLimit);
+			benchmark->addMetric("lowLatency", config.lowLatency ? 1.0 : 0.0);
+			benchmark->addMetric("framesInFlight", static_cast<double>(frameSync.getFramesInFlight()));
+			benchmark->addMetric("timelineSemaphore", frameSync.usesTimelineSemaphore() ? 1.0 : 0.0);
+			benchmark->addMetric("presentWait", vulkanSwapChain->hasPresentTimedLatency() ? 1.0 : 0.0);
+			benchmark->addMetric("gpuTimedLatency", vulkanSwapChain->hasGpuTimedLatency() ? 1.0 : 0.0);
+			benchmark->addMetric("startupMs", startupMilliseconds);
+			benchmark->addMetric("startupPipelineMs", startupPipelineMilliseconds);
+			benchmark->addMetric("pipelineCacheWarm", vulkanDevice.pipelineCacheLoaded() ? 1.0 : 0.0);
+			benchmark->addMetric("pipelineVariants", static_cast<double>(pipelineVariants.size()));
+			benchmark->addMetric("pipelineVariantsCreated", static_cast<double>(pipelineVariants.getCreatedCount()));
+			benchmark->addMetric("startupModels", static_cast<double>(scene.modelCount()));
+			benchmark->addMetric("startupUploads", static_cast<double>(startupUploadCount));
+			benchmark->addMetric("startupUploadSubmits", static_cast<double>(startupUploadSubmits));
+			benchmark->addMetric("startupLoadMs", startupLoadMilliseconds);
+			// A load too quick for the clock to resolve has no meaningful rate
+			if (startupLoadMilliseconds > 0.0)
+				benchmark->addMetric("startupUploadsPerSecond", startupUploadCount / (startupLoadMilliseconds / 1000.0));
+			if (!config.modelFile.empty())
+			{
+				benchmark->addMetric("modelFromCache", modelLoadedFromCache ? 1.0 : 0.0);
+				benchmark->addMetric("modelLoadMs", modelLoadMilliseconds);
+			}
+
+			VulkanAllocator::Stats memoryStats = vulkanDevice.allocator().getStats();
+			benchmark->addMetric("memoryBytesReserved", static_cast<double>(memoryStats.bytesReserved));
+			benchmark->addMetric("memoryBytesUsed", static_cast<double>(memoryStats.bytesUsed));
+			benchmark->addMetric("memoryDeviceAllocations", static_cast<double>(memoryStats.deviceMemoryCount));
+			benchmark->addMetric("memoryFragmentation", memoryStats.fragmentation);
+			benchmark->addMetric("frameRingBytes", static_cast<double>(frameRingBuffer->getFrameSize()));
+			benchmark->addMetric("frameRingPeakBytes", static_cast<double>(frameRingBuffer->getPeakFrameBytes()));
+			benchmark->addMetric("frameRingGrowths", static_cast<double>(frameRingBuffer->getGrowCount()));
+			benchmark->addMetric("bindless", bindlessTable ? 1.0 : 0.0);
+			benchmark->addMetric("textureMipLevels", static_cast<double>(sandboxTexture->getMipLevels()));
+			benchmark->addMetric("samplers", static_cast<double>(samplerCache.size()));
+			benchmark->addMetric("descriptorSetLayouts", static_cast<double>(descriptorLayoutCache.size()));
+			uint32_t descriptorPools = 0;
+			for (const auto& descriptorAllocator : frameDescriptorAllocators)
+				descriptorPools += descriptorAllocator->getPoolCount();
+			benchmark->addMetric("descriptorPools", static_cast<double>(descriptorPools));
+			if (assetStreamer)
+			{
+				VulkanAssetStreamer::Stats streamStats = assetStreamer->getStats();
+				benchmark->addMetric("dedicatedTransferQueue", assetStreamer->usesDedicatedTransferQueue() ? 1.0 : 0.0);
+				benchmark->addMetric("streamedModels", static_cast<double>(streamStats.modelsStreamed));
+				benchmark->addMetric("streamedTextures", static_cast<double>(streamStats.texturesStreamed));
+				benchmark->addMetric("streamedBytes", static_cast<double>(streamStats.bytesUploaded));
+				benchmark->addMetric("streamUploadMs", streamStats.uploadMilliseconds);
+			}
+			benchmark->writeReport(vulkanDevice.properties.deviceName);
+		}
 	}
 
-	void SandboxApp::createPipelineLayout()
+	void SandboxApp::createDescriptors()
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.size = sizeof(BasicPushConstantData);
-		pushConstantRange.offset = 0;
-		pushConstantRange.stageFlags = 
-			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // so that the push constants can be accessed from either shader
+		frameDescriptorStates.resize(frameSync.getFramesInFlight());
+
+		if (config.bindless && !vulkanDevice.supportsDescriptorIndexing())
+			std::cout << "Bindless: descriptor indexing not supported, using per-frame descriptor sets" << std::endl;
+
+		if (config.bindless && vulkanDevice.supportsDescriptorIndexing())
+		{
+			bindlessTable = std::make_unique<VulkanBindlessTable>(vulkanDevice, descriptorLayoutCache);
+			frameSetLayout = bindlessTable->getLayout();
+
+			// The shaders read element 0 of the texture array, which then works with either layout
+			uint32_t textureSlot = bindlessTable->addTexture(
+				sandboxTexture->getImageView(), 
+				sandboxTexture->getSampler(), 
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			assert(textureSlot == 0 && "The sandbox texture must be the bindless table's first texture!");
+			(void)textureSlot;
+
+			// A slot per frame in flight, each only rewritten once its slot's previous frame is done
+			for (uint32_t i = 0; i < frameSync.getFramesInFlight(); i++)
+				bindlessInstanceSlots.push_back(bindlessTable->addBuffer(frameRingBuffer->getBuffer(), 0, VK_WHOLE_SIZE));
+			return;
+		}
+
+		// The instance data as a storage buffer, readable by shaders (eg. for GPU culling) on top of the
+		// vertex attributes
+		VkDescriptorSetLayoutBinding instanceBinding{};
+		instanceBinding.binding = 0;
+		instanceBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceBinding.descriptorCount = 1;
+		instanceBinding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+		VkDescriptorSetLayoutBinding textureBinding{};
+		textureBinding.binding = 1;
+		textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		textureBinding.descriptorCount = 1;
+		textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+		frameSetLayout = descriptorLayoutCache.getLayout({ instanceBinding, textureBinding });
+
+		for (uint32_t i = 0; i < frameSync.getFramesInFlight(); i++)
+			frameDescriptorAllocators.push_back(std::make_unique<VulkanDescriptorAllocator>(vulkanDevice));
+	}
+
+	void SandboxApp::createPipelineLayout()
+	{
+		// Per-object data comes from the instance buffer now, so there are no push constants (yet)
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &frameSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create pipeline layout!");
 	}
 
-	void SandboxApp::createPipeline()
+	double SandboxApp::createPipeline()
 	{
+		auto createStart = SandboxBenchmark::Clock::now();
+
 		assert(vulkanSwapChain != nullptr && "Cannot create pipeline before pipeline layout!");
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before swap chain!");
 
@@ -69,17 +303,54 @@ namespace VulkanSandbox {
 		VulkanPipeline::setupDefaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = vulkanSwapChain->getRenderPass();
 		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipelineRenderPass = vulkanSwapChain->getSharedRenderPass();
 
-		vulkanPipeline = std::make_unique<VulkanPipeline>(
-			vulkanDevice,
-			"src/shaders/VertexShader.vert.spv",
-			"src/shaders/FragmentShader.frag.spv",
-			pipelineConfig);
+		// Only called for a new render pass, the variants created against the old one can't be used anymore
+		// (the device is idle here, see recreateSwapChain())
+		pipelineVariants.clear();
+		vulkanPipeline = &pipelineVariants.getPipeline(pipelineConfig, getShaderVariant());
+
+		return std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - createStart).count();
+	}
+
+	ShaderVariant SandboxApp::getShaderVariant() const
+	{
+		// constant_id 0 is read by the vertex shader, 1 and 2 by the fragment shader
+		ShaderVariant variant;
+		variant.constants = {
+			config.vertexColours ? VK_TRUE : VK_FALSE,
+			config.textured ? VK_TRUE : VK_FALSE,
+			static_cast<uint32_t>(config.debugView)
+		};
+		return variant;
+	}
+
+	VulkanSwapChain::PresentSettings SandboxApp::getPresentSettings() const
+	{
+		VulkanSwapChain::PresentSettings settings;
+		switch (config.presentMode)
+		{
+		case PresentMode::Fifo:
+			settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+			break;
+		case PresentMode::FifoRelaxed:
+			settings.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			break;
+		case PresentMode::Mailbox:
+			settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			break;
+		case PresentMode::Immediate:
+			settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			break;
+		}
+		settings.imageCount = config.swapChainImages;
+		return settings;
 	}
 
 	void SandboxApp::createCommandBuffers()
 	{
-		commandBuffers.resize(vulkanSwapChain->imageCount());
+		commandBuffers.resize(vulkanSwapChain->imageCount() * frameSync.getFramesInFlight());
+		recordedStates.assign(commandBuffers.size(), RecordedState{});
 
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -89,6 +360,15 @@ namespace VulkanSandbox {
 
 		if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
 			throw std::runtime_error("Failed to allocate command buffers!");
+
+		// Nothing is in flight here (the swap chain is only recreated after waiting for the device)
+		if (recordThreadPool)
+		{
+			threadCommandPools = std::make_unique<VulkanThreadCommandPools>(
+				vulkanDevice, 
+				config.recordThreads, 
+				static_cast<uint32_t>(commandBuffers.size()));
+		}
 	}
 
 	void SandboxApp::freeCommandBuffers()
@@ -101,7 +381,7 @@ namespace VulkanSandbox {
 		commandBuffers.clear();
 	}
 
-	void SandboxApp::drawFrame()
+	bool SandboxApp::drawFrame()
 	{
 		uint32_t imageIndex;
 		auto result = vulkanSwapChain->acquireNextImage(&imageIndex);
@@ -109,23 +389,35 @@ namespace VulkanSandbox {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
 			recreateSwapChain();
-			return;
+			return false;
 		}
 
 		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 			throw std::runtime_error("Failed to acquire next image index in the swap chain!");
 
-		recordCommandBuffer(imageIndex);
-		result = vulkanSwapChain->submitCommandBuffers(&commandBuffers[imageIndex], &imageIndex);
+		if (benchmark)
+			benchmark->endPhase("acquire");
+
+		VkCommandBuffer commandBuffer = recordCommandBuffer(imageIndex);
+		if (benchmark)
+			benchmark->endPhase("record");
+
+		result = vulkanSwapChain->submitCommandBuffers(&commandBuffer, &imageIndex);
+		if (benchmark)
+			benchmark->endPhase("submit");
+
 		if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR || appWindow.wasResized())
 		{
+			// The frame was still submitted, only the swap chain needs rebuilding for the next one
 			appWindow.resetSizeChangedFlag();
 			recreateSwapChain();
-			return; 
+			return true; 
 		}
 
 		if (result != VK_SUCCESS)
 			throw std::runtime_error("Failed to submit command buffer!");
+
+		return true;
 	}
 
 	void SandboxApp::recreateSwapChain()
@@ -134,38 +426,118 @@ namespace VulkanSandbox {
 		while (extent.width == 0 || extent.height == 0)
 		{
 			extent = appWindow.getExtent();
-			glfwWaitEvents();
+			appWindow.waitEvents();
 		}
 
-		vkDeviceWaitIdle(vulkanDevice.device());
+		// Timed from here so a minimised window doesn't count towards the resize
+		auto recreateStart = SandboxBenchmark::Clock::now();
+		bool isResize = vulkanSwapChain != nullptr;
+
+		vulkanDevice.waitIdle();
 		
 		if (vulkanSwapChain == nullptr)
-			vulkanSwapChain = std::make_unique<VulkanSwapChain>(vulkanDevice, extent);
+			vulkanSwapChain = std::make_unique<VulkanSwapChain>(vulkanDevice, frameSync, extent, getPresentSettings());
 		else
 		{
-			vulkanSwapChain = std::make_unique<VulkanSwapChain>(vulkanDevice, extent, std::move(vulkanSwapChain));
-			if (commandBuffers.size() != vulkanSwapChain->imageCount())
+			vulkanSwapChain = std::make_unique<VulkanSwapChain>(vulkanDevice, frameSync, extent, std::move(vulkanSwapChain), getPresentSettings());
+			if (commandBuffers.size() != vulkanSwapChain->imageCount() * frameSync.getFramesInFlight())
 			{
 				freeCommandBuffers();
 				createCommandBuffers();
 			}
 		}
 
-		createPipeline();
+		// Viewport and scissor are dynamic state, so the pipeline only depends on the render pass. The swap chain
+		// hands over its previous render pass whenever the formats didn't change, so most resizes skip this.
+		if (vulkanPipeline == nullptr || vulkanSwapChain->getSharedRenderPass() != pipelineRenderPass)
+		{
+			double pipelineMilliseconds = createPipeline();
+
+			if (!isResize)
+				startupPipelineMilliseconds = pipelineMilliseconds;
+			else if (benchmark)
+				benchmark->addSample("resize pipeline", pipelineMilliseconds);
+		}
+
+		// Every recorded buffer references the old framebuffers and viewport (and maybe the old pipeline)
+		recordedStates.assign(commandBuffers.size(), RecordedState{});
+
+		if (isResize && benchmark)
+		{
+			benchmark->addSample(
+				"resize", 
+				std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - recreateStart).count());
+		}
 	}
 
-	void SandboxApp::recordCommandBuffer(int imageIndex)
+	VkCommandBuffer SandboxApp::recordCommandBuffer(int imageIndex)
 	{
 		static int frame = 0;
 		frame = (frame + 1) % 10000;
 
+		uint32_t frameIndex = static_cast<uint32_t>(vulkanSwapChain->getCurrentFrame());
+		const size_t bufferIndex = static_cast<size_t>(imageIndex) * frameSync.getFramesInFlight() + frameIndex;
+		VkCommandBuffer commandBuffer = commandBuffers[bufferIndex];
+
+		// The swap chain has waited for this frame slot's last frame, so everything streamed for it then is free.
+		// Written on the main thread before any recording, every worker only reads the resulting draw batches.
+		// The data is rewritten every frame, whether or not the command buffer has to be.
+		frameRingBuffer->resetFrame(frameIndex);
+		if (gpuCulling)
+			prepareGpuCulling(frameIndex);
+		else
+			updateInstanceData(frameIndex);
+		updateFrameDescriptors(frameIndex);
+
+		// GPU timings arrive framesInFlight frames late, once this frame slot's previous queries are done
+		auto addGpuSamples = [this]() {
+			for (const auto& scope : gpuProfiler->getLatestResults())
+				benchmark->addSample("gpu " + scope.name, scope.milliseconds);
+		};
+
+		// Nothing the buffer draws changed since it was last recorded, the new data is picked up as is
+		RecordedState& recordedState = recordedStates[bufferIndex];
+		if (config.commandBufferCaching && isRecordedStateCurrent(recordedState, frameIndex))
+		{
+			if (gpuProfiler && gpuProfiler->replayFrame(frameIndex, recordedState.profilerScopes) && benchmark)
+				addGpuSamples();
+			reusedCommandBuffers++;
+			return commandBuffer;
+		}
+
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
 		// Begin recording to command buffer
-		if (vkBeginCommandBuffer(commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS)
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 			throw std::runtime_error("Failed to begin recording to command buffer!");
 
+		uint32_t renderPassScope = VulkanGpuProfiler::INVALID_SCOPE;
+		if (gpuProfiler)
+		{
+			if (gpuProfiler->beginFrame(commandBuffer, frameIndex) && benchmark)
+				addGpuSamples();
+		}
+
+		// Compute work has to be outside of the render pass
+		if (gpuCulling)
+		{
+			uint32_t cullScope = VulkanGpuProfiler::INVALID_SCOPE;
+			if (gpuProfiler)
+				cullScope = gpuProfiler->beginScope(commandBuffer, "cull");
+			gpuCulling->recordDispatch(commandBuffer, frameIndex);
+			if (gpuProfiler)
+				gpuProfiler->endScope(commandBuffer, cullScope);
+		}
+
+		if (gpuProfiler)
+			renderPassScope = gpuProfiler->beginScope(commandBuffer, "render pass");
+
+		// Worker threads record the draws into secondary command buffers, which need the render pass and
+		// framebuffer up front since they're recorded before the primary buffer reaches the render pass
+		if (recordThreadPool)
+			recordSecondaryCommandBuffers(bufferIndex, imageIndex);
+
 		// Render pass command info 
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -183,8 +555,115 @@ namespace VulkanSandbox {
 
 		// Begin render pass command
 		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (recordThreadPool)
+		{
+			// With SECONDARY_COMMAND_BUFFERS contents the subpass may only contain vkCmdExecuteCommands
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			if (!secondaryCommandBuffers.empty())
+			{
+				vkCmdExecuteCommands(
+					commandBuffer, 
+					static_cast<uint32_t>(secondaryCommandBuffers.size()), 
+					secondaryCommandBuffers.data());
+			}
+		}
+		else
+		{
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			setViewportAndScissor(commandBuffer);
+			renderSandboxObjects(commandBuffer, 0, drawBatches.size(), "pipeline");
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		// End render pass command
+
+		if (gpuProfiler)
+			gpuProfiler->endScope(commandBuffer, renderPassScope);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record command buffer!");
+
+		saveRecordedState(recordedState, frameIndex);
+		recordedCommandBuffers++;
+		return commandBuffer;
+	}
+
+	bool SandboxApp::isRecordedStateCurrent(const RecordedState& state, uint32_t frameIndex) const
+	{
+		// The profiler scopes follow from the rest, so they're left out
+		return state.valid &&
+			state.descriptorSet == frameDescriptorSet &&
+			state.descriptorVersion == frameDescriptorStates[frameIndex].version &&
+			state.instanceBuffer == instanceSlice.buffer &&
+			state.instanceOffset == instanceSlice.offset &&
+			state.indirectBuffer == indirectBuffer &&
+			state.gpuCullingVersion == (gpuCulling ? gpuCulling->getRecordVersion(frameIndex) : 0) &&
+			state.drawBatches == drawBatches;
+	}
+
+	void SandboxApp::saveRecordedState(RecordedState& state, uint32_t frameIndex) const
+	{
+		state.valid = true;
+		state.descriptorSet = frameDescriptorSet;
+		state.descriptorVersion = frameDescriptorStates[frameIndex].version;
+		state.instanceBuffer = instanceSlice.buffer;
+		state.instanceOffset = instanceSlice.offset;
+		state.indirectBuffer = indirectBuffer;
+		state.gpuCullingVersion = gpuCulling ? gpuCulling->getRecordVersion(frameIndex) : 0;
+		state.drawBatches = drawBatches;
+		if (gpuProfiler)
+			state.profilerScopes = gpuProfiler->getScopeNames(frameIndex);
+	}
+
+	void SandboxApp::recordSecondaryCommandBuffers(size_t bufferIndex, int imageIndex)
+	{
+		// Only ever executed by this primary buffer, which isn't pending (its frame slot's last frame has been waited on)
+		const uint32_t poolFrame = static_cast<uint32_t>(bufferIndex);
+		threadCommandPools->resetFrame(poolFrame);
+
+		// Contiguous ranges of draw batches per task, one task per worker
+		const size_t batchCount = drawBatches.size();
+		const uint32_t taskCount = static_cast<uint32_t>(std::min<size_t>(recordThreadPool->threadCount(), batchCount));
+		const size_t batchesPerTask = taskCount > 0 ? (batchCount + taskCount - 1) / taskCount : 0;
+		secondaryCommandBuffers.assign(taskCount, VK_NULL_HANDLE);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = vulkanSwapChain->getRenderPass();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = vulkanSwapChain->getFrameBuffer(imageIndex);
+
+		recordThreadPool->parallelFor(taskCount, [&](uint32_t taskIndex, uint32_t threadIndex) {
+			VkCommandBuffer commandBuffer = threadCommandPools->acquireSecondary(poolFrame, threadIndex);
 
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			// Cached primary buffers execute their secondaries again, so they're only one time submit without caching
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			if (!config.commandBufferCaching)
+				beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+				throw std::runtime_error("Failed to begin recording to secondary command buffer!");
+
+			// Dynamic state isn't inherited from the primary buffer, every secondary buffer sets its own
+			setViewportAndScissor(commandBuffer);
+
+			size_t firstBatch = taskIndex * batchesPerTask;
+			size_t endBatch = std::min(firstBatch + batchesPerTask, batchCount);
+			renderSandboxObjects(commandBuffer, firstBatch, endBatch, "record task " + std::to_string(taskIndex));
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to record secondary command buffer!");
+
+			secondaryCommandBuffers[taskIndex] = commandBuffer;
+		});
+	}
+
+	void SandboxApp::setViewportAndScissor(VkCommandBuffer commandBuffer)
+	{
 		// Create the dynamic viewport/scissor and pass to the command buffer
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -194,55 +673,325 @@ namespace VulkanSandbox {
 		viewport.height = static_cast<float>(extent.height);
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(commandBuffers[imageIndex], 0, 1, &viewport);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		VkRect2D scissor{ { 0,0 }, extent };
-		vkCmdSetScissor(commandBuffers[imageIndex], 0, 1, &scissor);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
 
-		renderSandboxObjects(commandBuffers[imageIndex]);
+	void SandboxApp::renderSandboxObjects(
+		VkCommandBuffer commandBuffer, 
+		size_t firstBatch, 
+		size_t endBatch, 
+		const std::string& scopeName)
+	{
+		uint32_t pipelineScope = VulkanGpuProfiler::INVALID_SCOPE;
+		if (gpuProfiler)
+			pipelineScope = gpuProfiler->beginScope(commandBuffer, scopeName);
 
-		vkCmdEndRenderPass(commandBuffers[imageIndex]);
-		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// End render pass command
+		vulkanPipeline->bind(commandBuffer);
+		if (frameDescriptorSet != VK_NULL_HANDLE)
+		{
+			vkCmdBindDescriptorSets(
+				commandBuffer, 
+				VK_PIPELINE_BIND_POINT_GRAPHICS, 
+				pipelineLayout, 
+				0, 1, &frameDescriptorSet, 
+				0, nullptr);
+		}
 
-		if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS)
-			throw std::runtime_error("Failed to record command buffer!");
+		// One scope for all of the draws, a scope per batch would cost a pair of timestamps and a string for
+		// every model, which at thousands of models is more than the draws themselves
+		uint32_t batchesScope = VulkanGpuProfiler::INVALID_SCOPE;
+		if (firstBatch < endBatch)
+		{
+			vkCmdBindVertexBuffers(commandBuffer, Model::InstanceData::BINDING, 1, &instanceSlice.buffer, &instanceSlice.offset);
+			if (gpuProfiler)
+				batchesScope = gpuProfiler->beginScope(commandBuffer, "draw batches");
+		}
+
+		// One instanced draw per model, each batch's instances are contiguous in the instance buffer
+		for (size_t i = firstBatch; i < endBatch; i++)
+		{
+			const DrawBatch& batch = drawBatches[i];
+
+			batch.model->bind(commandBuffer);
+			if (indirectBuffer != VK_NULL_HANDLE)
+			{
+				// The commands' firstInstance is always 0 (see VulkanGpuCulling), the batch's instances are
+				// reached through the binding offset instead
+				VkDeviceSize instanceOffset = instanceSlice.offset + batch.firstInstance * sizeof(Model::InstanceData);
+				vkCmdBindVertexBuffers(commandBuffer, Model::InstanceData::BINDING, 1, &instanceSlice.buffer, &instanceOffset);
+				batch.model->drawIndirect(commandBuffer, indirectBuffer, i * Model::INDIRECT_COMMAND_STRIDE);
+			}
+			else
+			{
+				batch.model->draw(commandBuffer, batch.instanceCount, batch.firstInstance);
+			}
+		}
+
+		if (gpuProfiler)
+		{
+			gpuProfiler->endScope(commandBuffer, batchesScope);
+			gpuProfiler->endScope(commandBuffer, pipelineScope);
+		}
 	}
 
-	void SandboxApp::renderSandboxObjects(VkCommandBuffer commandBuffer)
+	void SandboxApp::updateInstanceData(uint32_t frameIndex)
 	{
-		vulkanPipeline->bind(commandBuffer);
+		assert(currentSnapshot != nullptr && "Recording a frame without a simulation snapshot!");
+		const SandboxSimulation::Snapshot& snapshot = *currentSnapshot;
+		instanceSlice = VulkanFrameRingBuffer::Slice{};
 
-		for (SandboxObject& object : sandboxObjects)
+		cullObjects();
+
+		// Group the visible objects by model with a counting sort, so that every model's instances end up
+		// contiguous. Model handles are small dense indices, so counting needs no hashing at all.
+		modelInstanceCursors.assign(scene.modelCount(), 0);
+		for (uint32_t objectIndex : visibleObjects)
+			modelInstanceCursors[snapshot.modelHandles[objectIndex]]++;
+
+		drawBatches.clear();
+		uint32_t instanceCount = 0;
+		for (SandboxScene::ModelHandle modelHandle = 0; modelHandle < scene.modelCount(); modelHandle++)
+		{
+			uint32_t modelInstances = modelInstanceCursors[modelHandle];
+			modelInstanceCursors[modelHandle] = instanceCount; // reused as the write cursor below
+			if (modelInstances > 0)
+				drawBatches.push_back({ scene.getModel(modelHandle), instanceCount, modelInstances });
+			instanceCount += modelInstances;
+		}
+
+		if (instanceCount == 0)
+			return;
+
+		// Also bound as a storage buffer, so it needs the storage buffer offset alignment
+		instanceSlice = frameRingBuffer->allocate(
+			frameIndex, 
+			instanceCount * sizeof(Model::InstanceData), 
+			std::max<VkDeviceSize>(alignof(Model::InstanceData), vulkanDevice.properties.limits.minStorageBufferOffsetAlignment));
+		Model::InstanceData* instances = static_cast<Model::InstanceData*>(instanceSlice.mapped);
+
+		// One pass over the visible objects in scene order (transforms were already computed by the simulation
+		// update), only the instance writes are scattered (per model)
+		for (uint32_t i : visibleObjects)
+		{
+			Model::InstanceData& instance = instances[modelInstanceCursors[snapshot.modelHandles[i]]++];
+			instance.transform = snapshot.transforms[i];
+			instance.offset = snapshot.translations[i];
+			instance.colour = snapshot.colours[i];
+		}
+	}
+
+	void SandboxApp::cullObjects()
+	{
+		const SandboxSimulation::Snapshot& snapshot = *currentSnapshot;
+		const size_t objectCount = snapshot.modelHandles.size();
+		visibleObjects.resize(objectCount);
+
+		if (!config.culling)
+		{
+			for (size_t i = 0; i < objectCount; i++)
+				visibleObjects[i] = static_cast<uint32_t>(i);
+		}
+		else
 		{
-			object.transform2D.rotation = object.transform2D.rotation + 0.00005;
+			auto cullStart = SandboxBenchmark::Clock::now();
+
+			// Refreshed every frame, there are few models and a HostVisible model's bounds change with its vertices
+			modelCullExtents.resize(scene.modelCount());
+			for (SandboxScene::ModelHandle modelHandle = 0; modelHandle < scene.modelCount(); modelHandle++)
+			{
+				const Model::Bounds& bounds = scene.getModel(modelHandle)->getBounds();
+				modelCullExtents[modelHandle] = glm::vec4((bounds.min + bounds.max) * 0.5f, (bounds.max - bounds.min) * 0.5f);
+			}
+
+			// Instances are positioned straight in normalized device coordinates and the viewport always covers
+			// the whole swap chain extent, so the visible part of the extent is [-1, 1] whatever its size
+			const uint32_t visibleCount = CullKernel::cullObjects(
+				snapshot.transforms.data(),
+				snapshot.translations.data(),
+				snapshot.modelHandles.data(),
+				modelCullExtents.data(),
+				glm::vec2(-1.0f),
+				glm::vec2(1.0f),
+				visibleObjects.data(),
+				objectCount);
+			visibleObjects.resize(visibleCount);
+
+			if (benchmark)
+				benchmark->addSample("cull", std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - cullStart).count());
+		}
+
+		drawnObjects = static_cast<uint32_t>(visibleObjects.size());
+		culledObjects = static_cast<uint32_t>(objectCount - visibleObjects.size());
+		totalDrawnObjects += drawnObjects;
+		totalCulledObjects += culledObjects;
+	}
+
+	void SandboxApp::prepareGpuCulling(uint32_t frameIndex)
+	{
+		assert(currentSnapshot != nullptr && "Recording a frame without a simulation snapshot!");
+		const SandboxSimulation::Snapshot& snapshot = *currentSnapshot;
+		auto cullStart = SandboxBenchmark::Clock::now();
+
+		// Same view as cullObjects(), or one no object can miss with --no-culling
+		const float viewExtent = config.culling ? 1.0f : std::numeric_limits<float>::max();
+		gpuCulling->prepareFrame(
+			frameIndex, 
+			snapshot, 
+			scene, 
+			*frameRingBuffer, 
+			glm::vec2(-viewExtent), 
+			glm::vec2(viewExtent));
+
+		if (benchmark)
+			benchmark->addSample("cull", std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - cullStart).count());
+
+		// The GPU's counts only come back once a frame is done, so these are from this frame slot's last use
+		VulkanGpuCulling::FrameStats stats = gpuCulling->getLastFrameStats();
+		drawnObjects = stats.drawnObjects;
+		culledObjects = stats.objectCount - stats.drawnObjects;
+		totalDrawnObjects += drawnObjects;
+		totalCulledObjects += culledObjects;
 
-			// Create and pass push constants to shaders, then draw
-			BasicPushConstantData pushConstantData{};
-			pushConstantData.transform = object.transform2D.mat2();
-			pushConstantData.offset = object.transform2D.translation;
-			pushConstantData.colour = object.colour;
-			vkCmdPushConstants(
-				commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(BasicPushConstantData),
-				&pushConstantData);
+		drawBatches.clear();
+		instanceSlice = VulkanFrameRingBuffer::Slice{};
+		indirectBuffer = VK_NULL_HANDLE;
+		if (snapshot.modelHandles.empty())
+			return;
+
+		// Batch i draws with command i, whether or not the shader ends up putting any instances in it
+		for (const VulkanGpuCulling::ModelDraw& modelDraw : gpuCulling->getModelDraws())
+			drawBatches.push_back({ scene.getModel(modelDraw.modelHandle), modelDraw.firstInstance, modelDraw.maxInstances });
+
+		// Not part of the ring buffer, but updateFrameDescriptors(..) and the draws only need a buffer range
+		instanceSlice.buffer = gpuCulling->getInstanceBuffer(frameIndex);
+		instanceSlice.size = gpuCulling->getInstanceBufferSize(frameIndex);
+		indirectBuffer = gpuCulling->getIndirectBuffer(frameIndex);
+	}
+
+	void SandboxApp::updateFrameDescriptors(uint32_t frameIndex)
+	{
+		frameDescriptorSet = VK_NULL_HANDLE;
+		if (instanceSlice.buffer == VK_NULL_HANDLE)
+			return;
+
+		// Usually the same range as last time for this frame slot (the ring buffer hands out the same offsets
+		// while the sizes don't change), then the set stays as it is and recorded command buffers stay valid
+		FrameDescriptorState& state = frameDescriptorStates[frameIndex];
+		VkDescriptorBufferInfo instanceInfo{ instanceSlice.buffer, instanceSlice.offset, instanceSlice.size };
+		VkDescriptorImageInfo textureInfo = sandboxTexture->getDescriptorInfo();
+		const bool instanceChanged = instanceInfo.buffer != state.instanceInfo.buffer ||
+			instanceInfo.offset != state.instanceInfo.offset || instanceInfo.range != state.instanceInfo.range;
 
-			object.model->bind(commandBuffer);
-			object.model->draw(commandBuffer);
+		if (bindlessTable)
+		{
+			// Nothing is allocated, this frame's slot is simply pointed at this frame's slice. Update-after-bind
+			// leaves command buffers that bound the set valid, so the version stays the same.
+			if (instanceChanged)
+				bindlessTable->updateBuffer(bindlessInstanceSlots[frameIndex], instanceSlice.buffer, instanceSlice.offset, instanceSlice.size);
+			state.instanceInfo = instanceInfo;
+			frameDescriptorSet = bindlessTable->getSet();
+			return;
 		}
+
+		const bool textureChanged = textureInfo.imageView != state.textureInfo.imageView ||
+			textureInfo.sampler != state.textureInfo.sampler || textureInfo.imageLayout != state.textureInfo.imageLayout;
+		if (state.set != VK_NULL_HANDLE && !instanceChanged && !textureChanged)
+		{
+			frameDescriptorSet = state.set;
+			return;
+		}
+
+		// Everything allocated from this allocator the last time this frame slot was recorded is done with
+		VulkanDescriptorAllocator& descriptorAllocator = *frameDescriptorAllocators[frameIndex];
+		descriptorAllocator.reset();
+		frameDescriptorSet = descriptorAllocator.allocate(frameSetLayout);
+		state.set = frameDescriptorSet;
+		state.instanceInfo = instanceInfo;
+		state.textureInfo = textureInfo;
+		state.version++;
+
+		std::array<VkWriteDescriptorSet, 2> writes{};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = frameDescriptorSet;
+		writes[0].dstBinding = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[0].pBufferInfo = &instanceInfo;
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = frameDescriptorSet;
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[1].pImageInfo = &textureInfo;
+		vkUpdateDescriptorSets(vulkanDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 	}
 
 	void SandboxApp::loadSandboxObjects()
 	{
-		std::vector<Model::Vertex> vertices{
-			//     Positions         Colours
-				{ {  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
-				{ {-0.35f,  0.5f }, { 0.4f, 0.8f, 0.6f, 1.0f } },
-				{ { 0.35f,  0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f } }
+		if (config.streamAssets)
+			assetStreamer = std::make_unique<VulkanAssetStreamer>(vulkanDevice, samplerCache);
+
+		// Everything loaded below is queued into as few submissions as possible and waited on once at the end,
+		// instead of a submit and vkQueueWaitIdle per buffer/image
+		auto loadStart = SandboxBenchmark::Clock::now();
+		std::unique_ptr<VulkanUploadBatcher> uploader;
+		if (config.uploadBatching)
+			uploader = std::make_unique<VulkanUploadBatcher>(vulkanDevice);
+		auto createModel = [&](const Model::Builder& builder) {
+			startupUploadCount += builder.indices.empty() ? 1 : 2;
+			return uploader ? 
+				std::make_shared<Model>(vulkanDevice, *uploader, builder) : 
+				std::make_shared<Model>(vulkanDevice, builder);
 		};
-		std::shared_ptr<Model> testModel = std::make_shared<Model>(vulkanDevice, vertices);
+
+		// Mip levels are generated on the GPU, so far away/tiny objects don't sample the full size image.
+		// When streaming, the checkerboard stands in until the file has been decoded and uploaded.
+		const bool streamTexture = assetStreamer && !config.textureFile.empty();
+		Texture::ImageData textureImage = config.textureFile.empty() || streamTexture ?
+			Texture::createCheckerboard(256, 8, glm::vec4(1.0f), glm::vec4(0.75f, 0.75f, 0.75f, 1.0f)) :
+			Texture::loadImageFile(config.textureFile);
+		startupUploadCount++;
+		if (uploader)
+		{
+			Texture::UploadedImage image = Texture::createImage(vulkanDevice, textureImage.width, textureImage.height, true, true);
+			uploader->uploadImage(image, textureImage.pixels.data(), textureImage.pixels.size());
+			sandboxTexture = std::make_unique<Texture>(vulkanDevice, samplerCache, image);
+		}
+		else
+		{
+			sandboxTexture = std::make_unique<Texture>(vulkanDevice, samplerCache, textureImage);
+		}
+		if (streamTexture)
+		{
+			assetStreamer->streamTextureFile(config.textureFile, [this](std::unique_ptr<Texture> texture) {
+				replaceSandboxTexture(std::move(texture));
+			});
+		}
+
+		std::vector<Model::Vertex> triangleSoup{
+			//     Positions         Colours                   UVs
+				{ {  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.5f, 0.0f } },
+				{ {-0.35f,  0.5f }, { 0.4f, 0.8f, 0.6f, 1.0f }, { 0.0f, 1.0f } },
+				{ { 0.35f,  0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } }
+		};
+		std::shared_ptr<Model> testModel;
+		if (!config.modelFile.empty())
+		{
+			auto modelLoadStart = SandboxBenchmark::Clock::now();
+			bool fromCache = false;
+			testModel = Model::loadFromFile(vulkanDevice, uploader.get(), config.modelFile, &fromCache);
+			startupUploadCount += 2; // loaded meshes are always indexed
+			modelLoadedFromCache = fromCache;
+			modelLoadMilliseconds = std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - modelLoadStart).count();
+		}
+		else
+		{
+			Model::Builder modelBuilder;
+			modelBuilder.addTriangleSoup(triangleSoup);
+			testModel = createModel(modelBuilder);
+		}
 
 		SandboxObject triangleObject = SandboxObject::createSandboxObject();
 		triangleObject.model = testModel;
@@ -253,6 +1002,100 @@ namespace VulkanSandbox {
 		triangleObject.transform2D.scale.x = 1.0f;
 		triangleObject.transform2D.scale.y = 2.0f;
 
-		sandboxObjects.push_back(std::move(triangleObject));
+		scene.reserve(std::max<uint32_t>(config.objectCount, 1));
+		scene.addObject(std::move(triangleObject));
+
+		const uint32_t extraObjects = config.objectCount > 1 ? config.objectCount - 1 : 0;
+		if (extraObjects > 0 && assetStreamer)
+		{
+			// Streamed grids are made of quads instead, so it's obvious when they pop in
+			std::vector<Model::Vertex> quadSoup{
+				//     Positions         Colours                   UVs
+					{ { -0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+					{ {  0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+					{ {  0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+					{ {  0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+					{ { -0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
+					{ { -0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } }
+			};
+			Model::Builder quadBuilder;
+			quadBuilder.addTriangleSoup(quadSoup);
+			assetStreamer->streamModel(std::move(quadBuilder), [this, extraObjects](std::unique_ptr<Model> model) {
+				addObjectGrid({ std::shared_ptr<Model>(std::move(model)) }, extraObjects);
+			});
+		}
+		else if (extraObjects > 0)
+		{
+			std::vector<std::shared_ptr<Model>> gridModels{ testModel };
+			for (uint32_t i = 1; i < config.modelCount; i++)
+				gridModels.push_back(createModel(createPolygonBuilder(i)));
+			addObjectGrid(gridModels, extraObjects);
+		}
+
+		if (uploader)
+		{
+			uploader->waitIdle();
+			startupUploadSubmits = static_cast<uint32_t>(uploader->getStats().batchCount);
+		}
+		else
+		{
+			startupUploadSubmits = startupUploadCount;
+		}
+		startupLoadMilliseconds = std::chrono::duration<double, std::milli>(SandboxBenchmark::Clock::now() - loadStart).count();
+	}
+
+	void SandboxApp::addObjectGrid(const std::vector<std::shared_ptr<Model>>& models, uint32_t objectCount)
+	{
+		const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(objectCount))));
+		const float gridHalfSize = config.gridSpan;
+		const float cellSize = gridSize > 0 ? 2.0f * gridHalfSize / gridSize : 0.0f;
+
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			const uint32_t column = i % gridSize;
+			const uint32_t row = i / gridSize;
+
+			SandboxObject object = SandboxObject::createSandboxObject();
+			object.model = models[i % models.size()];
+			object.colour = glm::vec4(
+				static_cast<float>(column) / gridSize, 
+				static_cast<float>(row) / gridSize, 
+				0.8f, 
+				1.0f);
+			object.transform2D.translation.x = -gridHalfSize + (column + 0.5f) * cellSize;
+			object.transform2D.translation.y = -gridHalfSize + (row + 0.5f) * cellSize;
+			// Wrapped into [-pi, pi), with a large grid i * 0.1 alone would be thousands of radians and lose precision
+			object.transform2D.rotation = std::remainder(static_cast<float>(i) * 0.1f, glm::two_pi<float>());
+			object.transform2D.scale.x = cellSize * 0.8f;
+			object.transform2D.scale.y = cellSize * 0.8f;
+
+			scene.addObject(std::move(object));
+		}
+	}
+
+	void SandboxApp::releaseRetiredTextures()
+	{
+		retiredTextures.erase(
+			std::remove_if(retiredTextures.begin(), retiredTextures.end(), [this](const RetiredTexture& retired) {
+				return frameSync.isComplete(retired.frameValue);
+			}),
+			retiredTextures.end());
+	}
+
+	void SandboxApp::replaceSandboxTexture(std::unique_ptr<Texture> texture)
+	{
+		// Per-frame descriptor sets pick the new texture up from the next frame on. The bindless slot is read
+		// by frames still in flight though, and update-after-bind only allows rewriting slots that aren't,
+		// so that path has to wait for the frames submitted so far once (not the whole device, the asset
+		// streamer's uploads can carry on).
+		if (bindlessTable)
+		{
+			frameSync.waitForValue(frameSync.getLastSubmittedValue());
+			bindlessTable->updateTexture(0, texture->getImageView(), texture->getSampler(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+
+		// Only the frames submitted so far can use the old texture
+		retiredTextures.push_back({ frameSync.getLastSubmittedValue(), std::move(sandboxTexture) });
+		sandboxTexture = std::move(texture);
 	}
 }
@@ -1,10 +1,26 @@
 #pragma once
 
+#include "SandboxBenchmark.hpp"
+#include "SandboxConfig.hpp"
+#include "SandboxFrameLimiter.hpp"
 #include "SandboxWindow.hpp"
 #include "VulkanPipeline.hpp"
+#include "VulkanPipelineVariantCache.hpp"
+#include "VulkanAssetStreamer.hpp"
+#include "VulkanDescriptors.hpp"
 #include "VulkanDevice.hpp"
+#include "VulkanFrameRingBuffer.hpp"
+#include "VulkanFrameSync.hpp"
+#include "VulkanGpuCulling.hpp"
+#include "VulkanGpuProfiler.hpp"
+#include "VulkanSamplerCache.hpp"
 #include "VulkanSwapChain.hpp"
 #include "SandboxObject.hpp"
+#include "SandboxScene.hpp"
+#include "SandboxSimulation.hpp"
+#include "SandboxThreadPool.hpp"
+#include "Texture.hpp"
+#include "VulkanThreadCommandPools.hpp"
 
 #include <memory>
 #include <vector>
@@ -18,7 +34,7 @@ namespace VulkanSandbox {
 		static constexpr int HEIGHT = 1080;
 		const std::string APP_NAME = "Vulkan Sandbox";
 
-		SandboxApp();
+		SandboxApp(const SandboxConfig& config = SandboxConfig{});
 		~SandboxApp();
 
 		SandboxApp(const SandboxApp&) = delete;
@@ -27,25 +43,179 @@ namespace VulkanSandbox {
 		void run();
 
 	private:
+		void createDescriptors();
 		void createPipelineLayout();
-		void createPipeline();
+		// Returns the time taken to create the pipeline in milliseconds
+		double createPipeline();
+		// The objects' specialization constants for config's shader options, in constant_id order
+		ShaderVariant getShaderVariant() const;
+		// config's present mode and image count, passed to every swap chain created
+		VulkanSwapChain::PresentSettings getPresentSettings() const;
 		void createCommandBuffers();
 		void freeCommandBuffers();
-		void drawFrame();
+		// Returns false if no frame was rendered (ie. the swap chain had to be recreated first)
+		bool drawFrame();
 		void recreateSwapChain();
-		void recordCommandBuffer(int imageIndex);
-		void renderSandboxObjects(VkCommandBuffer commandBuffer);
+		// Returns the command buffer to submit for this frame, only re-recorded when its RecordedState changed
+		VkCommandBuffer recordCommandBuffer(int imageIndex);
+		void recordSecondaryCommandBuffers(size_t bufferIndex, int imageIndex);
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+		// Draws drawBatches[firstBatch, endBatch), the instance data must already be written for this frame
+		void renderSandboxObjects(
+			VkCommandBuffer commandBuffer, 
+			size_t firstBatch, 
+			size_t endBatch, 
+			const std::string& scopeName);
 		void loadSandboxObjects();
+		// The stress test objects (--objects), small copies of the models (taking turns) laid out in a grid
+		void addObjectGrid(const std::vector<std::shared_ptr<Model>>& models, uint32_t objectCount);
+		// Swaps in a streamed texture, the old one is kept alive until the frames in flight that may use it are done
+		void replaceSandboxTexture(std::unique_ptr<Texture> texture);
+		// Destroys the retired textures whose last frame is done
+		void releaseRetiredTextures();
 
-		SandboxWindow appWindow{ WIDTH, HEIGHT, APP_NAME };
-		VulkanDevice vulkanDevice{ appWindow };
+		// All instances of one model, drawn with a single instanced draw call. With --gpu-culling instanceCount
+		// is only an upper bound, the draw reads the real count from the batch's indirect command.
+		struct DrawBatch {
+			Model* model;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+
+			bool operator==(const DrawBatch& other) const {
+				return model == other.model && firstInstance == other.firstInstance && instanceCount == other.instanceCount;
+			}
+		};
+
+		// Everything a primary command buffer's recording depends on besides the swap chain and pipeline (which
+		// invalidate every buffer when they're recreated). The buffer is submitted again as is while this matches.
+		struct RecordedState {
+			bool valid = false;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			uint64_t descriptorVersion = 0;
+			VkBuffer instanceBuffer = VK_NULL_HANDLE;
+			VkDeviceSize instanceOffset = 0;
+			VkBuffer indirectBuffer = VK_NULL_HANDLE;
+			uint64_t gpuCullingVersion = 0;
+			std::vector<DrawBatch> drawBatches;
+			// The GPU profiler scopes the buffer writes, handed back to the profiler when it's reused
+			std::vector<std::string> profilerScopes;
+		};
+		// Compared and copied field by field against the current frame, so checking allocates nothing
+		bool isRecordedStateCurrent(const RecordedState& state, uint32_t frameIndex) const;
+		void saveRecordedState(RecordedState& state, uint32_t frameIndex) const;
+
+		// Builds the draw batches and writes the instance buffer from currentSnapshot, never the live scene.
+		// Only objects that pass cullObjects() are included.
+		void updateInstanceData(uint32_t frameIndex);
+		// Fills visibleObjects with the dense indices of the snapshot's objects that overlap the view
+		void cullObjects();
+		// --gpu-culling's replacement for updateInstanceData(..): prepares the culling dispatch and builds one
+		// draw batch per model, whose indirect commands the dispatch fills in
+		void prepareGpuCulling(uint32_t frameIndex);
+		// Points this frame's descriptors at the data written by updateInstanceData(..), only touching the
+		// descriptor set when that moved (or the texture changed)
+		void updateFrameDescriptors(uint32_t frameIndex);
+
+		// Declared first so startup time includes creating the window and device below
+		SandboxBenchmark::Clock::time_point constructionStart = SandboxBenchmark::Clock::now();
+		SandboxConfig config;
+		SandboxWindow appWindow{ WIDTH, HEIGHT, APP_NAME, config.headless };
+		VulkanDevice vulkanDevice{ appWindow, config.pipelineCacheFile };
+		// Declared before the swap chain, which submits through it, the frame values outlive every swap chain
+		VulkanFrameSync frameSync{ vulkanDevice, config.framesInFlight, config.timelineSemaphore };
 		std::unique_ptr<VulkanSwapChain> vulkanSwapChain;
-		std::unique_ptr<VulkanPipeline> vulkanPipeline;
+		// Every shader variant created so far against pipelineRenderPass, vulkanPipeline is the one the objects
+		// are drawn with
+		VulkanPipelineVariantCache pipelineVariants{ vulkanDevice, "src/shaders/VertexShader.vert.spv", "src/shaders/FragmentShader.frag.spv" };
+		VulkanPipeline* vulkanPipeline = nullptr;
+		// The render pass vulkanPipeline was created against, the pipelines are only rebuilt when this changes
+		std::shared_ptr<VulkanRenderPass> pipelineRenderPass;
 		VkPipelineLayout pipelineLayout;
+		VulkanDescriptorLayoutCache descriptorLayoutCache{ vulkanDevice };
+		VulkanSamplerCache samplerCache{ vulkanDevice };
+		// Sampled by every object (through set 0, binding 1)
+		std::unique_ptr<Texture> sandboxTexture;
+		struct RetiredTexture {
+			uint64_t frameValue; // the last frame that may sample it
+			std::unique_ptr<Texture> texture;
+		};
+		std::vector<RetiredTexture> retiredTextures;
+		// Only created with --stream-assets, its callbacks run from run() in between simulation updates
+		std::unique_ptr<VulkanAssetStreamer> assetStreamer;
+		// One primary buffer per swap chain image and frame slot (imageIndex * framesInFlight + frameIndex).
+		// Everything a buffer references then belongs to one frame slot, whose last frame is done whenever
+		// that buffer comes around again, so it can be resubmitted unchanged or re-recorded.
 		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<RecordedState> recordedStates;
+		uint64_t recordedCommandBuffers = 0;
+		uint64_t reusedCommandBuffers = 0;
+		std::unique_ptr<SandboxBenchmark> benchmark;
+		// --fps-limit, does nothing without it
+		SandboxFrameLimiter frameLimiter{ config.fpsLimit };
+		// Every latency sample of the run, submit to present or submit to GPU completion depending on whether the
+		// device has present wait, see VulkanSwapChain::takeFrameLatencies()
+		std::vector<double> frameLatencies;
+		// Pipeline creation time during startup, reported once the run finishes
+		double startupPipelineMilliseconds = 0.0;
+		double startupMilliseconds = 0.0;
+		// Loading the models and texture in loadSandboxObjects(), from the first upload until all have finished
+		double startupLoadMilliseconds = 0.0;
+		uint32_t startupUploadCount = 0;
+		uint32_t startupUploadSubmits = 0;
+		// Parsing (or mapping the cache of) --model and queueing its upload, part of startupLoadMilliseconds
+		double modelLoadMilliseconds = 0.0;
+		bool modelLoadedFromCache = false;
+		std::unique_ptr<VulkanGpuProfiler> gpuProfiler;
+
+		// Only created with --record-threads, otherwise everything is recorded inline into the primary buffer.
+		// The command pools have a "frame" per primary buffer, so re-recording one never frees the secondary
+		// buffers a cached one executes.
+		std::unique_ptr<SandboxThreadPool> recordThreadPool;
+		std::unique_ptr<VulkanThreadCommandPools> threadCommandPools;
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
+		SandboxScene scene;
+		// Declared after the scene so its worker thread stops before the scene goes away
+		std::unique_ptr<SandboxSimulation> simulation;
+		// The snapshot the frame being drawn is recorded from, set by run() each frame
+		const SandboxSimulation::Snapshot* currentSnapshot = nullptr;
+
+		// Per-frame streamed data (currently just the instance data), recycled once the frame slot's last frame is done
+		std::unique_ptr<VulkanFrameRingBuffer> frameRingBuffer;
+		// This frame's instance data in the ring buffer, rewritten each frame along with the draw batches
+		VulkanFrameRingBuffer::Slice instanceSlice;
+		// Only created with --gpu-culling. indirectBuffer then holds this frame's draw commands, one per batch.
+		std::unique_ptr<VulkanGpuCulling> gpuCulling;
+		VkBuffer indirectBuffer = VK_NULL_HANDLE;
 
-		// Temp
-		std::vector<SandboxObject> sandboxObjects;
+		// Set 0 of the pipeline layout, bound once per command buffer. Either a set allocated every frame from
+		// that frame's descriptor allocator, or with --bindless the bindless table, which only has this frame's
+		// instance buffer slot rewritten.
+		VkDescriptorSetLayout frameSetLayout = VK_NULL_HANDLE;
+		std::vector<std::unique_ptr<VulkanDescriptorAllocator>> frameDescriptorAllocators;
+		std::unique_ptr<VulkanBindlessTable> bindlessTable;
+		std::vector<uint32_t> bindlessInstanceSlots; // per frame in flight
+		VkDescriptorSet frameDescriptorSet = VK_NULL_HANDLE;
+		// What each frame slot's set currently points at, version changes whenever the set is replaced
+		struct FrameDescriptorState {
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			VkDescriptorBufferInfo instanceInfo{};
+			VkDescriptorImageInfo textureInfo{};
+			uint64_t version = 0;
+		};
+		std::vector<FrameDescriptorState> frameDescriptorStates;
+		std::vector<DrawBatch> drawBatches;
+		// Per scene model handle, instance count and then write cursor while grouping objects by model
+		std::vector<uint32_t> modelInstanceCursors;
+		// Per scene model handle, the model's bounds as centre (xy) and half size (zw) for CullKernel
+		std::vector<glm::vec4> modelCullExtents;
+		// Dense indices of this frame's objects that made it past culling, in scene order
+		std::vector<uint32_t> visibleObjects;
+		// Objects drawn/culled by the last recorded frame, and summed over every frame for the benchmark report
+		uint32_t drawnObjects = 0;
+		uint32_t culledObjects = 0;
+		uint64_t totalDrawnObjects = 0;
+		uint64_t totalCulledObjects = 0;
 	};
 
 
@@ -0,0 +1,166 @@
+#include "SandboxBenchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	static double millisecondsBetween(SandboxBenchmark::Clock::time_point start, SandboxBenchmark::Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	static std::string escapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	SandboxBenchmark::SandboxBenchmark(const std::string& outputFilepath)
+		: outputFilepath(outputFilepath), runStart(Clock::now()), runEnd(runStart)
+	{
+	}
+
+	void SandboxBenchmark::beginRun()
+	{
+		runStart = Clock::now();
+		runEnd = runStart;
+	}
+
+	void SandboxBenchmark::beginFrame()
+	{
+		frameStart = Clock::now();
+		lastPhaseEnd = frameStart;
+		pendingPhases.clear();
+	}
+
+	void SandboxBenchmark::endPhase(const std::string& phaseName)
+	{
+		auto now = Clock::now();
+		pendingPhases.emplace_back(phaseName, millisecondsBetween(lastPhaseEnd, now));
+		lastPhaseEnd = now;
+	}
+
+	void SandboxBenchmark::endFrame()
+	{
+		runEnd = Clock::now();
+		getSeries("frame").push_back(millisecondsBetween(frameStart, runEnd));
+		for (const auto& phase : pendingPhases)
+			getSeries(phase.first).push_back(phase.second);
+		pendingPhases.clear();
+		completedFrames++;
+	}
+
+	void SandboxBenchmark::discardFrame()
+	{
+		pendingPhases.clear();
+	}
+
+	void SandboxBenchmark::addSample(const std::string& seriesName, double milliseconds)
+	{
+		getSeries(seriesName).push_back(milliseconds);
+	}
+
+	void SandboxBenchmark::addMetric(const std::string& name, double value)
+	{
+		metrics.emplace_back(name, value);
+	}
+
+	double SandboxBenchmark::elapsedSeconds() const
+	{
+		return millisecondsBetween(runStart, runEnd) / 1000.0;
+	}
+
+	SandboxBenchmark::PhaseStats SandboxBenchmark::computeStats(std::vector<double> samples)
+	{
+		PhaseStats stats{};
+		if (samples.empty())
+			return stats;
+
+		std::sort(samples.begin(), samples.end());
+
+		// Nearest-rank percentile
+		auto percentile = [&samples](double p) {
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+			return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+		};
+
+		stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		stats.p50 = percentile(50.0);
+		stats.p95 = percentile(95.0);
+		stats.p99 = percentile(99.0);
+		stats.max = samples.back();
+		return stats;
+	}
+
+	void SandboxBenchmark::writeReport(const std::string& deviceName)
+	{
+		const double durationSeconds = elapsedSeconds();
+		const double framesPerSecond = durationSeconds > 0.0 ? completedFrames / durationSeconds : 0.0;
+
+		std::ofstream reportFile{ outputFilepath };
+		if (!reportFile.is_open())
+			throw std::runtime_error("Failed to open benchmark output file: " + outputFilepath);
+
+		reportFile << std::fixed << std::setprecision(4);
+		reportFile << "{\n";
+		reportFile << "  \"device\": \"" << escapeJson(deviceName) << "\",\n";
+		reportFile << "  \"frames\": " << completedFrames << ",\n";
+		reportFile << "  \"durationSeconds\": " << durationSeconds << ",\n";
+		reportFile << "  \"framesPerSecond\": " << framesPerSecond << ",\n";
+
+		// All timings are in milliseconds
+		reportFile << "  \"phases\": {";
+		for (size_t i = 0; i < series.size(); i++)
+		{
+			PhaseStats stats = computeStats(series[i].second);
+			reportFile << (i == 0 ? "\n" : ",\n");
+			reportFile << "    \"" << escapeJson(series[i].first) << "\": { "
+				<< "\"samples\": " << series[i].second.size()
+				<< ", \"mean\": " << stats.mean
+				<< ", \"p50\": " << stats.p50
+				<< ", \"p95\": " << stats.p95
+				<< ", \"p99\": " << stats.p99
+				<< ", \"max\": " << stats.max << " }";
+		}
+		reportFile << "\n  },\n";
+
+		reportFile << "  \"metrics\": {";
+		for (size_t i = 0; i < metrics.size(); i++)
+		{
+			reportFile << (i == 0 ? "\n" : ",\n");
+			reportFile << "    \"" << escapeJson(metrics[i].first) << "\": " << metrics[i].second;
+		}
+		reportFile << "\n  }\n";
+		reportFile << "}\n";
+
+		// Short summary for the console as well
+		PhaseStats frameStats = computeStats(getSeries("frame"));
+		std::cout << "\nBenchmark: " << completedFrames << " frames in " << durationSeconds << "s ("
+			<< framesPerSecond << " fps), frame time mean " << frameStats.mean << "ms, p99 " << frameStats.p99
+			<< "ms -> " << outputFilepath << std::endl;
+	}
+
+	std::vector<double>& SandboxBenchmark::getSeries(const std::string& seriesName)
+	{
+		for (auto& entry : series)
+		{
+			if (entry.first == seriesName)
+				return entry.second;
+		}
+		series.emplace_back(seriesName, std::vector<double>{});
+		return series.back().second;
+	}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// Collects per-frame CPU timings (split into named phases) and writes a JSON summary with
+	// mean/p50/p95/p99/max per phase plus overall throughput once the run is finished
+	class SandboxBenchmark {
+
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		struct PhaseStats {
+			double mean = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		SandboxBenchmark(const std::string& outputFilepath);
+
+		SandboxBenchmark(const SandboxBenchmark&) = delete;
+		SandboxBenchmark& operator=(const SandboxBenchmark&) = delete;
+
+		// Starts the throughput clock, called once the app is done starting up so durationSeconds and
+		// framesPerSecond only cover the frame loop. The clock stops at the last endFrame().
+		void beginRun();
+
+		// A frame's phases are only kept if the frame completes with endFrame(), 
+		// frames that bail out early (eg. swap chain recreation) should call discardFrame()
+		void beginFrame();
+		void endPhase(const std::string& phaseName);
+		void endFrame();
+		void discardFrame();
+
+		// Adds a sample to a series directly, for timings not measured by this class (eg. GPU timestamps)
+		void addSample(const std::string& seriesName, double milliseconds);
+		// Extra scalar values written to the report as-is
+		void addMetric(const std::string& name, double value);
+
+		uint32_t frameCount() const { return completedFrames; }
+		// From beginRun() until the last completed frame
+		double elapsedSeconds() const;
+
+		static PhaseStats computeStats(std::vector<double> samples);
+
+		void writeReport(const std::string& deviceName);
+
+	private:
+		std::vector<double>& getSeries(const std::string& seriesName);
+
+		std::string outputFilepath;
+		Clock::time_point runStart;
+		Clock::time_point runEnd;
+		Clock::time_point frameStart;
+		Clock::time_point lastPhaseEnd;
+		uint32_t completedFrames = 0;
+
+		// Series are kept in insertion order so the report lists phases in the order they happen in a frame
+		std::vector<std::pair<std::string, std::vector<double>>> series;
+		std::vector<std::pair<std::string, double>> pendingPhases;
+		std::vector<std::pair<std::string, double>> metrics;
+	};
+
+}
@@ -0,0 +1,182 @@
+#include "SandboxConfig.hpp"
+
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	SandboxConfig SandboxConfig::fromCommandLine(int argc, char* argv[])
+	{
+		SandboxConfig config{};
+
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+
+			// Fetches the value following a flag, ie. "--frames 100"
+			auto nextValue = [&]() -> std::string {
+				if (i + 1 >= argc)
+					throw std::runtime_error("Missing value for command line option: " + arg);
+				return argv[++i];
+			};
+
+			if (arg == "--headless")
+				config.headless = true;
+			else if (arg == "--frames")
+				config.maxFrames = static_cast<uint32_t>(std::stoul(nextValue()));
+			else if (arg == "--seconds")
+				config.maxSeconds = std::stod(nextValue());
+			else if (arg == "--benchmark")
+				config.benchmarkOutput = nextValue();
+			else if (arg == "--gpu-timing")
+				config.gpuTiming = true;
+			else if (arg == "--record-threads")
+				config.recordThreads = static_cast<uint32_t>(std::stoul(nextValue()));
+			else if (arg == "--pipeline-cache")
+				config.pipelineCacheFile = nextValue();
+			else if (arg == "--no-pipeline-cache")
+				config.pipelineCacheFile.clear();
+			else if (arg == "--objects")
+				config.objectCount = static_cast<uint32_t>(std::stoul(nextValue()));
+			else if (arg == "--tick-rate")
+			{
+				config.tickRate = std::stod(nextValue());
+				if (config.tickRate <= 0.0)
+					throw std::runtime_error("--tick-rate must be greater than 0");
+			}
+			else if (arg == "--serial-update")
+				config.serialUpdate = true;
+			else if (arg == "--bindless")
+				config.bindless = true;
+			else if (arg == "--texture")
+				config.textureFile = nextValue();
+			else if (arg == "--stream-assets")
+				config.streamAssets = true;
+			else if (arg == "--models")
+			{
+				config.modelCount = static_cast<uint32_t>(std::stoul(nextValue()));
+				if (config.modelCount == 0)
+					throw std::runtime_error("--models must be at least 1");
+			}
+			else if (arg == "--no-culling")
+				config.culling = false;
+			else if (arg == "--gpu-culling")
+				config.gpuCulling = true;
+			else if (arg == "--grid-span")
+			{
+				config.gridSpan = std::stof(nextValue());
+				if (config.gridSpan <= 0.0f)
+					throw std::runtime_error("--grid-span must be greater than 0");
+			}
+			else if (arg == "--model")
+				config.modelFile = nextValue();
+			else if (arg == "--vertex-colours")
+				config.vertexColours = true;
+			else if (arg == "--untextured")
+				config.textured = false;
+			else if (arg == "--debug-view")
+			{
+				std::string view = nextValue();
+				if (view == "uv")
+					config.debugView = DebugView::UVs;
+				else if (view == "instance")
+					config.debugView = DebugView::Instances;
+				else
+					throw std::runtime_error("--debug-view must be uv or instance");
+			}
+			else if (arg == "--no-command-cache")
+				config.commandBufferCaching = false;
+			else if (arg == "--present-mode")
+			{
+				std::string mode = nextValue();
+				if (mode == "fifo")
+					config.presentMode = PresentMode::Fifo;
+				else if (mode == "fifo-relaxed")
+					config.presentMode = PresentMode::FifoRelaxed;
+				else if (mode == "mailbox")
+					config.presentMode = PresentMode::Mailbox;
+				else if (mode == "immediate")
+					config.presentMode = PresentMode::Immediate;
+				else
+					throw std::runtime_error("--present-mode must be fifo, fifo-relaxed, mailbox or immediate");
+			}
+			else if (arg == "--swapchain-images")
+				config.swapChainImages = static_cast<uint32_t>(std::stoul(nextValue()));
+			else if (arg == "--fps-limit")
+			{
+				config.fpsLimit = std::stod(nextValue());
+				if (config.fpsLimit < 0.0)
+					throw std::runtime_error("--fps-limit must not be negative");
+			}
+			else if (arg == "--low-latency")
+				config.lowLatency = true;
+			else if (arg == "--frames-in-flight")
+			{
+				config.framesInFlight = static_cast<uint32_t>(std::stoul(nextValue()));
+				if (config.framesInFlight == 0)
+					throw std::runtime_error("--frames-in-flight must be at least 1");
+			}
+			else if (arg == "--no-timeline-semaphore")
+				config.timelineSemaphore = false;
+			else if (arg == "--no-upload-batching")
+				config.uploadBatching = false;
+			else
+				throw std::runtime_error("Unknown command line option: " + arg + "\n" + usage());
+		}
+
+		return config;
+	}
+
+	std::string SandboxConfig::usage()
+	{
+		return
+			"Usage: Vulkan-Sandbox [options]\n"
+			"  --headless      Render offscreen without a window (eg. on a software ICD like lavapipe)\n"
+			"  --frames <n>    Exit after rendering n frames (default: run until the window is closed)\n"
+			"  --seconds <t>   Exit after running for t seconds\n"
+			"  --benchmark <file.json>\n"
+			"                  Record per-frame CPU timings and write a percentile report to the given file\n"
+			"  --gpu-timing    Measure GPU time of the render pass, pipeline binds and draws with timestamp queries\n"
+			"  --record-threads <n>\n"
+			"                  Split draw recording across n worker threads using secondary command buffers\n"
+			"  --pipeline-cache <file>\n"
+			"                  Load/save compiled pipelines from/to the given file (default: pipeline_cache.bin)\n"
+			"  --no-pipeline-cache\n"
+			"                  Compile every pipeline from scratch, at startup and on every resize\n"
+			"  --objects <n>   Fill the scene with n objects (default: 1) for stress testing\n"
+			"  --tick-rate <hz>\n"
+			"                  Simulation ticks per second, independent of the frame rate (default: 120)\n"
+			"  --serial-update Update the simulation on the main thread instead of overlapping it with recording\n"
+			"  --bindless      Bind resources through a single VK_EXT_descriptor_indexing table (if supported)\n"
+			"  --texture <file.ppm|file.tga>\n"
+			"                  Texture every object with the given image (default: a generated checkerboard)\n"
+			"  --stream-assets Upload the --objects grid's model and the --texture image in the background\n"
+			"  --models <n>    Build the --objects grid from n distinct models, all loaded at startup (default: 1)\n"
+			"  --model <file.obj>\n"
+			"                  Load the centre object's model from the given file, through a binary cache next to it\n"
+			"  --grid-span <s> Spread the --objects grid over s times the view's size (default: 1), most of it is off screen\n"
+			"  --no-culling    Draw every object, instead of only those whose bounds overlap the view\n"
+			"  --gpu-culling   Cull on the GPU in a compute shader and draw each model with an indirect draw\n"
+			"  --no-upload-batching\n"
+			"                  Submit and wait for every startup upload on its own instead of batching them\n"
+			"  --vertex-colours\n"
+			"                  Multiply every object's colour by its model's vertex colours\n"
+			"  --untextured    Draw the objects' colours without sampling the texture\n"
+			"  --debug-view <uv|instance>\n"
+			"                  Output texture coordinates, or a colour per instance, instead of the shaded colour\n"
+			"  --no-command-cache\n"
+			"                  Re-record the command buffer every frame, even when nothing it draws changed\n"
+			"  --present-mode <fifo|fifo-relaxed|mailbox|immediate>\n"
+			"                  Swap chain present mode, falls back to fifo when not supported (default: mailbox)\n"
+			"  --swapchain-images <n>\n"
+			"                  Ask for n swap chain images (default: the surface's minimum + 1)\n"
+			"  --fps-limit <hz>\n"
+			"                  Cap the frame rate, sleeping and then spinning until each frame is due\n"
+			"  --low-latency   Wait for the previous frame to be presented (or without present wait, rendered)\n"
+			"                  before sampling input for the next one\n"
+			"  --frames-in-flight <n>\n"
+			"                  Let the CPU prepare up to n frames ahead of the GPU (default: 2)\n"
+			"  --no-timeline-semaphore\n"
+			"                  Track frames in flight with a fence each instead of one timeline semaphore\n";
+	}
+
+}
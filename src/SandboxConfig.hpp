@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace VulkanSandbox {
+
+	// What the object shaders output instead of the shaded colour, a specialization constant (see SandboxApp::getShaderVariant())
+	enum class DebugView : uint32_t {
+		None = 0,
+		UVs = 1,
+		Instances = 2	// a colour per instance index, which shows how the draws are batched
+	};
+
+	// Swap chain present mode (--present-mode), mapped to the VkPresentModeKHR of the same name
+	enum class PresentMode {
+		Fifo,
+		FifoRelaxed,
+		Mailbox,
+		Immediate
+	};
+
+	// Startup options for a SandboxApp, see SandboxConfig::fromCommandLine(..) for the accepted flags
+	struct SandboxConfig {
+		// Render into offscreen images instead of a GLFW window/swap chain (no display required)
+		bool headless = false;
+		// Number of frames to render before exiting, 0 means run until the window is closed
+		uint32_t maxFrames = 0;
+		// Number of seconds to run for before exiting, 0 means no time limit
+		double maxSeconds = 0.0;
+		// When set, per-frame timings are collected and a JSON report is written to this path on exit
+		std::string benchmarkOutput;
+		// Wrap the render pass/pipeline binds/draws in GPU timestamp queries (always on when benchmarking)
+		bool gpuTiming = false;
+		// Worker threads recording secondary command buffers, 0 records everything inline on the main thread
+		uint32_t recordThreads = 0;
+		// Where compiled pipelines are persisted between runs, empty disables pipeline caching entirely
+		std::string pipelineCacheFile = "pipeline_cache.bin";
+		// Total number of objects in the scene, anything past the first is a grid of small triangles for stress tests
+		uint32_t objectCount = 1;
+		// Simulation ticks per second, independent of the frame rate (see SandboxSimulation)
+		double tickRate = 120.0;
+		// Run the simulation update on the main thread before recording instead of overlapping it on a worker
+		bool serialUpdate = false;
+		// Bind every resource through one descriptor indexing table instead of per-frame descriptor sets
+		bool bindless = false;
+		// Image (binary .ppm or uncompressed .tga) every object is textured with, a checkerboard when empty
+		std::string textureFile;
+		// Load the stress test grid's model and the texture on the asset streamer's worker thread (and transfer
+		// queue) while already rendering, instead of blocking startup on the uploads
+		bool streamAssets = false;
+		// Number of distinct models the --objects grid cycles through, all loaded at startup (a scene load
+		// benchmark). 1 keeps every grid object on the same triangle. Ignored with --stream-assets.
+		uint32_t modelCount = 1;
+		// Skip objects whose transformed bounds are outside the view before building the draw batches
+		bool culling = true;
+		// Cull and build the instance data in a compute shader, then draw every model with an indirect draw
+		bool gpuCulling = false;
+		// Width/height of the --objects grid in multiples of the view's, above 1 most of the grid is off screen
+		float gridSpan = 1.0f;
+		// Wavefront .obj file replacing the built-in triangle (the centre object and the grid's first model). A
+		// binary copy is cached next to it (<file>.vsmesh), later runs map that instead of parsing the text.
+		std::string modelFile;
+		// Queue startup uploads into a VulkanUploadBatcher (few submissions) instead of one submit and wait each
+		bool uploadBatching = true;
+		// Keep each primary command buffer recorded and only re-record it when what it draws (batches, buffers,
+		// descriptor sets, swap chain or pipeline) changed, the per-frame data itself is always rewritten
+		bool commandBufferCaching = true;
+		// Shader variant (specialization constants) the objects are drawn with: multiply in the models' vertex
+		// colours, sample the texture, and the debug output
+		bool vertexColours = false;
+		bool textured = true;
+		DebugView debugView = DebugView::None;
+		// Frame pacing. Throughput bound runs want a non-blocking present mode and no limit, latency sensitive
+		// ones a frame rate cap and --low-latency. The present mode falls back to FIFO when not supported.
+		PresentMode presentMode = PresentMode::Mailbox;
+		// Swap chain (or headless offscreen) images, 0 for the surface's minimum + 1
+		uint32_t swapChainImages = 0;
+		// Frames per second the main loop is capped at, 0 for no cap
+		double fpsLimit = 0.0;
+		// Wait for the previous frame to be presented before sampling input, so the CPU never runs a frame ahead
+		// of the display. That needs VK_KHR_present_wait; without it the wait ends when the previous frame has
+		// finished rendering and its present can go ahead.
+		bool lowLatency = false;
+		// Frames the CPU may prepare ahead of the GPU. More overlap helps throughput when the CPU and GPU times
+		// per frame vary, fewer frames keep latency (and per-frame memory) down.
+		uint32_t framesInFlight = 2;
+		// Track frames with a timeline semaphore when the GPU has them, otherwise (or when off) a fence per frame
+		bool timelineSemaphore = true;
+
+		static SandboxConfig fromCommandLine(int argc, char* argv[]);
+		static std::string usage();
+	};
+
+}
@@ -0,0 +1,268 @@
+#include "SandboxCullKernel.hpp"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SANDBOX_CULL_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+// MSVC allows AVX2 intrinsics anywhere, GCC/Clang need the function itself compiled for AVX2
+#if defined(SANDBOX_CULL_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SANDBOX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SANDBOX_TARGET_AVX2
+#endif
+
+namespace VulkanSandbox {
+
+	namespace CullKernel {
+
+		static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "Translations are read as interleaved x/y floats");
+		static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "Model extents are read as 4 packed floats");
+		static_assert(sizeof(glm::mat2) == 4 * sizeof(float), "Transforms are read as 4 packed floats (column major)");
+
+		// Objects [first, end), appending to outVisibleIndices + visibleCount. Also finishes off what the SIMD paths
+		// leave over at the end.
+		static uint32_t cullObjectsScalar(
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t first,
+			size_t end,
+			uint32_t visibleCount)
+		{
+			for (size_t i = first; i < end; i++)
+			{
+				const float* m = reinterpret_cast<const float*>(&transforms[i]);
+				const glm::vec4& extent = modelExtents[modelIndices[i]];
+
+				// The box's centre goes through the transform, its half size through the absolute transform
+				// (the smallest axis aligned box around the rotated/scaled box)
+				const float centreX = (m[0] * extent.x + m[2] * extent.y) + translations[i].x;
+				const float centreY = (m[1] * extent.x + m[3] * extent.y) + translations[i].y;
+				const float halfX = std::fabs(m[0]) * extent.z + std::fabs(m[2]) * extent.w;
+				const float halfY = std::fabs(m[1]) * extent.z + std::fabs(m[3]) * extent.w;
+
+				const bool visible =
+					centreX - halfX <= viewMax.x && centreX + halfX >= viewMin.x &&
+					centreY - halfY <= viewMax.y && centreY + halfY >= viewMin.y;
+
+				// Always written, only kept (by moving past it) when visible, so there's no branch to mispredict
+				outVisibleIndices[visibleCount] = static_cast<uint32_t>(i);
+				visibleCount += visible ? 1 : 0;
+			}
+			return visibleCount;
+		}
+
+#if defined(SANDBOX_CULL_KERNEL_X86)
+
+		static uint32_t cullObjectsSSE2(
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t count)
+		{
+			const float* transformFloats = reinterpret_cast<const float*>(transforms);
+			const float* translationFloats = reinterpret_cast<const float*>(translations);
+			const float* extentFloats = reinterpret_cast<const float*>(modelExtents);
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			const __m128 viewMinX = _mm_set1_ps(viewMin.x);
+			const __m128 viewMinY = _mm_set1_ps(viewMin.y);
+			const __m128 viewMaxX = _mm_set1_ps(viewMax.x);
+			const __m128 viewMaxY = _mm_set1_ps(viewMax.y);
+
+			uint32_t visibleCount = 0;
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				// One object's matrix per register, transposed into one register per matrix element
+				__m128 m00 = _mm_loadu_ps(transformFloats + i * 4);
+				__m128 m01 = _mm_loadu_ps(transformFloats + i * 4 + 4);
+				__m128 m10 = _mm_loadu_ps(transformFloats + i * 4 + 8);
+				__m128 m11 = _mm_loadu_ps(transformFloats + i * 4 + 12);
+				_MM_TRANSPOSE4_PS(m00, m01, m10, m11);
+
+				// Same for the (gathered) model extents
+				__m128 boundsX = _mm_loadu_ps(extentFloats + modelIndices[i] * 4);
+				__m128 boundsY = _mm_loadu_ps(extentFloats + modelIndices[i + 1] * 4);
+				__m128 extentX = _mm_loadu_ps(extentFloats + modelIndices[i + 2] * 4);
+				__m128 extentY = _mm_loadu_ps(extentFloats + modelIndices[i + 3] * 4);
+				_MM_TRANSPOSE4_PS(boundsX, boundsY, extentX, extentY);
+
+				const __m128 translations01 = _mm_loadu_ps(translationFloats + i * 2);
+				const __m128 translations23 = _mm_loadu_ps(translationFloats + i * 2 + 4);
+				const __m128 translationX = _mm_shuffle_ps(translations01, translations23, _MM_SHUFFLE(2, 0, 2, 0));
+				const __m128 translationY = _mm_shuffle_ps(translations01, translations23, _MM_SHUFFLE(3, 1, 3, 1));
+
+				// Same operations in the same order as cullObjectsScalar(..)
+				const __m128 centreX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, boundsX), _mm_mul_ps(m10, boundsY)), translationX);
+				const __m128 centreY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, boundsX), _mm_mul_ps(m11, boundsY)), translationY);
+				const __m128 halfX = _mm_add_ps(_mm_mul_ps(_mm_and_ps(m00, absMask), extentX), _mm_mul_ps(_mm_and_ps(m10, absMask), extentY));
+				const __m128 halfY = _mm_add_ps(_mm_mul_ps(_mm_and_ps(m01, absMask), extentX), _mm_mul_ps(_mm_and_ps(m11, absMask), extentY));
+
+				const __m128 visibleX = _mm_and_ps(
+					_mm_cmple_ps(_mm_sub_ps(centreX, halfX), viewMaxX),
+					_mm_cmpge_ps(_mm_add_ps(centreX, halfX), viewMinX));
+				const __m128 visibleY = _mm_and_ps(
+					_mm_cmple_ps(_mm_sub_ps(centreY, halfY), viewMaxY),
+					_mm_cmpge_ps(_mm_add_ps(centreY, halfY), viewMinY));
+				const int visibleMask = _mm_movemask_ps(_mm_and_ps(visibleX, visibleY));
+
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					outVisibleIndices[visibleCount] = static_cast<uint32_t>(i + lane);
+					visibleCount += (visibleMask >> lane) & 1;
+				}
+			}
+
+			return cullObjectsScalar(
+				transforms, translations, modelIndices, modelExtents, viewMin, viewMax, outVisibleIndices, i, count, visibleCount);
+		}
+
+		// Two 4x4 transposes side by side, one per 128 bit lane
+		SANDBOX_TARGET_AVX2
+		static inline void transposeLanes4x4(__m256& row0, __m256& row1, __m256& row2, __m256& row3)
+		{
+			const __m256 t0 = _mm256_unpacklo_ps(row0, row1);
+			const __m256 t1 = _mm256_unpackhi_ps(row0, row1);
+			const __m256 t2 = _mm256_unpacklo_ps(row2, row3);
+			const __m256 t3 = _mm256_unpackhi_ps(row2, row3);
+			row0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			row1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			row2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			row3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		// 4 floats from low into the low 128 bit lane and 4 from high into the high one
+		SANDBOX_TARGET_AVX2
+		static inline __m256 loadPair(const float* low, const float* high)
+		{
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+		}
+
+		SANDBOX_TARGET_AVX2
+		static uint32_t cullObjectsAVX2(
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t count)
+		{
+			const float* transformFloats = reinterpret_cast<const float*>(transforms);
+			const float* translationFloats = reinterpret_cast<const float*>(translations);
+			const float* extentFloats = reinterpret_cast<const float*>(modelExtents);
+			const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+			const __m256 viewMinX = _mm256_set1_ps(viewMin.x);
+			const __m256 viewMinY = _mm256_set1_ps(viewMin.y);
+			const __m256 viewMaxX = _mm256_set1_ps(viewMax.x);
+			const __m256 viewMaxY = _mm256_set1_ps(viewMax.y);
+
+			uint32_t visibleCount = 0;
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				// Objects k and k + 4 share a register (one per 128 bit lane), so after the per lane transpose
+				// the low lanes hold objects 0-3 and the high lanes objects 4-7
+				const float* objects = transformFloats + i * 4;
+				__m256 m00 = loadPair(objects, objects + 16);
+				__m256 m01 = loadPair(objects + 4, objects + 20);
+				__m256 m10 = loadPair(objects + 8, objects + 24);
+				__m256 m11 = loadPair(objects + 12, objects + 28);
+				transposeLanes4x4(m00, m01, m10, m11);
+
+				__m256 boundsX = loadPair(extentFloats + modelIndices[i] * 4, extentFloats + modelIndices[i + 4] * 4);
+				__m256 boundsY = loadPair(extentFloats + modelIndices[i + 1] * 4, extentFloats + modelIndices[i + 5] * 4);
+				__m256 extentX = loadPair(extentFloats + modelIndices[i + 2] * 4, extentFloats + modelIndices[i + 6] * 4);
+				__m256 extentY = loadPair(extentFloats + modelIndices[i + 3] * 4, extentFloats + modelIndices[i + 7] * 4);
+				transposeLanes4x4(boundsX, boundsY, extentX, extentY);
+
+				// Deinterleaved like TransformKernel's scales, the shuffle leaves the 64 bit pairs out of order
+				const __m256 translations0123 = _mm256_loadu_ps(translationFloats + i * 2);
+				const __m256 translations4567 = _mm256_loadu_ps(translationFloats + i * 2 + 8);
+				const __m256 translationX = _mm256_castpd_ps(_mm256_permute4x64_pd(
+					_mm256_castps_pd(_mm256_shuffle_ps(translations0123, translations4567, _MM_SHUFFLE(2, 0, 2, 0))),
+					_MM_SHUFFLE(3, 1, 2, 0)));
+				const __m256 translationY = _mm256_castpd_ps(_mm256_permute4x64_pd(
+					_mm256_castps_pd(_mm256_shuffle_ps(translations0123, translations4567, _MM_SHUFFLE(3, 1, 3, 1))),
+					_MM_SHUFFLE(3, 1, 2, 0)));
+
+				const __m256 centreX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, boundsX), _mm256_mul_ps(m10, boundsY)), translationX);
+				const __m256 centreY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m01, boundsX), _mm256_mul_ps(m11, boundsY)), translationY);
+				const __m256 halfX = _mm256_add_ps(
+					_mm256_mul_ps(_mm256_and_ps(m00, absMask), extentX),
+					_mm256_mul_ps(_mm256_and_ps(m10, absMask), extentY));
+				const __m256 halfY = _mm256_add_ps(
+					_mm256_mul_ps(_mm256_and_ps(m01, absMask), extentX),
+					_mm256_mul_ps(_mm256_and_ps(m11, absMask), extentY));
+
+				const __m256 visibleX = _mm256_and_ps(
+					_mm256_cmp_ps(_mm256_sub_ps(centreX, halfX), viewMaxX, _CMP_LE_OQ),
+					_mm256_cmp_ps(_mm256_add_ps(centreX, halfX), viewMinX, _CMP_GE_OQ));
+				const __m256 visibleY = _mm256_and_ps(
+					_mm256_cmp_ps(_mm256_sub_ps(centreY, halfY), viewMaxY, _CMP_LE_OQ),
+					_mm256_cmp_ps(_mm256_add_ps(centreY, halfY), viewMinY, _CMP_GE_OQ));
+				const int visibleMask = _mm256_movemask_ps(_mm256_and_ps(visibleX, visibleY));
+
+				for (uint32_t lane = 0; lane < 8; lane++)
+				{
+					outVisibleIndices[visibleCount] = static_cast<uint32_t>(i + lane);
+					visibleCount += (visibleMask >> lane) & 1;
+				}
+			}
+
+			return cullObjectsScalar(
+				transforms, translations, modelIndices, modelExtents, viewMin, viewMax, outVisibleIndices, i, count, visibleCount);
+		}
+
+#endif
+
+		uint32_t cullObjects(
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t count)
+		{
+			return cullObjects(
+				TransformKernel::detectSimdLevel(),
+				transforms, translations, modelIndices, modelExtents, viewMin, viewMax, outVisibleIndices, count);
+		}
+
+		uint32_t cullObjects(
+			SimdLevel level,
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t count)
+		{
+#if defined(SANDBOX_CULL_KERNEL_X86)
+			if (level == SimdLevel::AVX2 && TransformKernel::detectSimdLevel() == SimdLevel::AVX2)
+				return cullObjectsAVX2(transforms, translations, modelIndices, modelExtents, viewMin, viewMax, outVisibleIndices, count);
+			if (level != SimdLevel::Scalar)
+				return cullObjectsSSE2(transforms, translations, modelIndices, modelExtents, viewMin, viewMax, outVisibleIndices, count);
+#endif
+			return cullObjectsScalar(transforms, translations, modelIndices, modelExtents, viewMin, viewMax, outVisibleIndices, 0, count, 0);
+		}
+
+	}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "SandboxTransformKernel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanSandbox {
+
+	// Batch visibility test of every object's transformed bounding box against the view rectangle, over the
+	// contiguous arrays of a SandboxSimulation::Snapshot. Like TransformKernel, picks the widest instruction set
+	// the CPU supports at runtime, and every level gives identical results.
+	namespace CullKernel {
+
+		using TransformKernel::SimdLevel;
+
+		// An object is kept when the box around its model's bounds, after transform and translation, overlaps
+		// [viewMin, viewMax]. modelExtents holds each model's bounds as centre (xy) and half size (zw), indexed by
+		// modelIndices[i]. The dense indices of the kept objects are written to outVisibleIndices (room for count
+		// entries) in ascending order, returns how many there are.
+		uint32_t cullObjects(
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t count);
+		uint32_t cullObjects(
+			SimdLevel level,
+			const glm::mat2* transforms,
+			const glm::vec2* translations,
+			const uint32_t* modelIndices,
+			const glm::vec4* modelExtents,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax,
+			uint32_t* outVisibleIndices,
+			size_t count);
+
+	}
+
+}
@@ -0,0 +1,71 @@
+#include "SandboxFrameLimiter.hpp"
+
+#include <cmath>
+#include <thread>
+
+namespace VulkanSandbox {
+
+	SandboxFrameLimiter::SandboxFrameLimiter(double framesPerSecond)
+		: framePeriod{ framesPerSecond > 0.0 ?
+			std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond)) :
+			Clock::duration::zero() }
+	{
+	}
+
+	double SandboxFrameLimiter::waitForNextFrame()
+	{
+		if (!isEnabled())
+			return 0.0;
+
+		const auto waitStart = Clock::now();
+		if (!started)
+		{
+			// Nothing to wait for yet, the first frame just sets the cadence
+			started = true;
+			nextFrame = waitStart + framePeriod;
+			return 0.0;
+		}
+
+		sleepUntil(nextFrame);
+		const auto now = Clock::now();
+
+		// A frame that took longer than a whole period restarts the cadence from now, otherwise the
+		// following frames would run unlimited until they caught up with the missed deadlines
+		nextFrame += framePeriod;
+		if (nextFrame < now)
+			nextFrame = now + framePeriod;
+
+		return std::chrono::duration<double, std::milli>(now - waitStart).count();
+	}
+
+	void SandboxFrameLimiter::sleepUntil(Clock::time_point deadline)
+	{
+		using Milliseconds = std::chrono::duration<double, std::milli>;
+
+		for (;;)
+		{
+			const double remaining = Milliseconds(deadline - Clock::now()).count();
+			const double sleepEstimate = sleepMean + 2.0 * std::sqrt(sleepM2 / sleepCount);
+			if (remaining <= sleepEstimate)
+				break;
+
+			const auto sleepStart = Clock::now();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const double slept = Milliseconds(Clock::now() - sleepStart).count();
+
+			// Capped so the estimate keeps following the scheduler (eg. a changed timer resolution)
+			if (sleepCount < 1000)
+				sleepCount++;
+			else
+				sleepM2 *= (sleepCount - 1.0) / sleepCount;
+			const double delta = slept - sleepMean;
+			sleepMean += delta / sleepCount;
+			sleepM2 += delta * (slept - sleepMean);
+		}
+
+		// The last stretch is shorter than a sleep can be trusted with
+		while (Clock::now() < deadline)
+			std::this_thread::yield();
+	}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace VulkanSandbox {
+
+	// Caps the main loop at a target frame rate (--fps-limit). Sleeping alone overshoots by up to a scheduler
+	// tick (~1ms on Linux, up to ~15ms on Windows), spinning alone burns a core, so it sleeps in short steps
+	// while there is comfortably more time left than a sleep has been seen to take, then spins for the rest.
+	class SandboxFrameLimiter {
+
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// 0 frames per second disables the limiter, waitForNextFrame() then returns straight away
+		SandboxFrameLimiter(double framesPerSecond);
+
+		bool isEnabled() const { return framePeriod.count() > 0; }
+
+		// Blocks until one frame period after the previous frame was due. Frames are due on a fixed cadence
+		// rather than a period after the last call, so the rate doesn't drift with the loop's own overhead.
+		// Returns how long it waited in milliseconds.
+		double waitForNextFrame();
+
+	private:
+		void sleepUntil(Clock::time_point deadline);
+
+		Clock::duration framePeriod;
+		Clock::time_point nextFrame;
+		bool started = false;
+
+		// How long a 1ms sleep actually took, running mean and variance (Welford) of the observed durations.
+		// Sleeping stops once mean + 2 standard deviations of it no longer fits before the deadline.
+		double sleepMean = 1.0;
+		double sleepM2 = 0.0;
+		uint64_t sleepCount = 1;
+	};
+
+}
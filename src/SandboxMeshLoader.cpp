@@ -0,0 +1,436 @@
+#include "SandboxMeshLoader.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanSandbox {
+
+	namespace MeshLoader {
+
+		// Everything in the file is written in the host's byte order and layout, a cache is only meant to be
+		// read back by the build that wrote it (vertexStride and the version catch most mismatches)
+		struct CacheHeader {
+			char magic[4];
+			uint32_t version;
+			uint32_t vertexStride;		// sizeof(Model::Vertex)
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t indexSize;			// 2 or 4 bytes
+			glm::vec2 boundsMin;
+			glm::vec2 boundsMax;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			uint64_t vertexOffset;		// from the start of the file
+			uint64_t indexOffset;
+		};
+		static_assert(std::is_trivially_copyable<CacheHeader>::value, "The cache header is written as raw bytes");
+
+		static constexpr char CACHE_MAGIC[4] = { 'V', 'S', 'M', 'C' };
+		// Keeps the vertex and index arrays aligned in the mapping
+		static constexpr uint64_t CACHE_ALIGNMENT = 16;
+
+		static uint64_t alignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		// True if every index refers to one of the vertexCount vertices
+		template<typename IndexType>
+		static bool indicesInRange(const uint8_t* data, uint32_t indexCount, uint32_t vertexCount)
+		{
+			const IndexType* indices = reinterpret_cast<const IndexType*>(data);
+			for (uint32_t i = 0; i < indexCount; i++)
+			{
+				if (indices[i] >= vertexCount)
+					return false;
+			}
+			return true;
+		}
+
+		// Resolves a 1 based (or negative, counting back from the end) OBJ index into a 0 based one
+		static uint32_t resolveObjIndex(long index, size_t count, const std::string& filepath, size_t line)
+		{
+			long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+			if (index == 0 || resolved < 0 || resolved >= static_cast<long>(count))
+				throw std::runtime_error("Invalid index in " + filepath + " on line " + std::to_string(line));
+			return static_cast<uint32_t>(resolved);
+		}
+
+		Model::Builder parseObjFile(const std::string& filepath)
+		{
+			// One read and a pointer walk over it is a lot faster than line by line stream extraction
+			std::ifstream file{ filepath, std::ios::binary };
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open model file: " + filepath);
+			std::string text{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+			std::vector<glm::vec2> positions;
+			std::vector<glm::vec4> colours;
+			std::vector<glm::vec2> uvs;
+			Model::Builder builder;
+
+			// Each distinct (position, uv) pair becomes one vertex
+			std::unordered_map<uint64_t, uint32_t> vertexLookup;
+			std::vector<uint32_t> faceCorners;
+
+			const char* cursor = text.c_str();
+			const char* end = cursor + text.size();
+			size_t lineNumber = 0;
+			while (cursor < end)
+			{
+				lineNumber++;
+				const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+				if (lineEnd == nullptr)
+					lineEnd = end;
+
+				// strtof/strtol stop at the newline, which is never part of a number
+				auto skipSpaces = [&]() {
+					while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t'))
+						cursor++;
+				};
+				auto readFloats = [&](float* values, int maxCount) {
+					int count = 0;
+					while (count < maxCount)
+					{
+						char* numberEnd;
+						float value = std::strtof(cursor, &numberEnd);
+						if (numberEnd == cursor || numberEnd > lineEnd)
+							break;
+						values[count++] = value;
+						cursor = numberEnd;
+					}
+					return count;
+				};
+
+				skipSpaces();
+				if (cursor + 2 < lineEnd && cursor[0] == 'v' && cursor[1] == ' ')
+				{
+					cursor += 2;
+					float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+					int count = readFloats(values, 6);
+					if (count < 2)
+						throw std::runtime_error("Invalid vertex in " + filepath + " on line " + std::to_string(lineNumber));
+					positions.emplace_back(values[0], -values[1]);
+					colours.emplace_back(values[3], values[4], values[5], 1.0f);
+				}
+				else if (cursor + 3 < lineEnd && cursor[0] == 'v' && cursor[1] == 't' && cursor[2] == ' ')
+				{
+					cursor += 3;
+					float values[2] = { 0.0f, 0.0f };
+					readFloats(values, 2);
+					uvs.emplace_back(values[0], 1.0f - values[1]);
+				}
+				else if (cursor + 2 < lineEnd && cursor[0] == 'f' && cursor[1] == ' ')
+				{
+					cursor += 2;
+					faceCorners.clear();
+					while (true)
+					{
+						skipSpaces();
+						if (cursor >= lineEnd || *cursor == '\r')
+							break;
+
+						// v, v/vt, v//vn or v/vt/vn
+						char* numberEnd;
+						long positionIndex = std::strtol(cursor, &numberEnd, 10);
+						if (numberEnd == cursor)
+							throw std::runtime_error("Invalid face in " + filepath + " on line " + std::to_string(lineNumber));
+						cursor = numberEnd;
+						long uvIndex = 0;
+						if (cursor < lineEnd && *cursor == '/')
+						{
+							cursor++;
+							if (cursor < lineEnd && *cursor != '/')
+							{
+								uvIndex = std::strtol(cursor, &numberEnd, 10);
+								cursor = numberEnd;
+							}
+							if (cursor < lineEnd && *cursor == '/')
+							{
+								cursor++;
+								std::strtol(cursor, &numberEnd, 10); // normals aren't used in 2D
+								cursor = numberEnd;
+							}
+						}
+
+						uint32_t position = resolveObjIndex(positionIndex, positions.size(), filepath, lineNumber);
+						uint32_t uv = uvIndex != 0 ? resolveObjIndex(uvIndex, uvs.size(), filepath, lineNumber) + 1 : 0;
+						uint64_t key = (static_cast<uint64_t>(position) << 32) | uv;
+
+						auto inserted = vertexLookup.emplace(key, static_cast<uint32_t>(builder.vertices.size()));
+						if (inserted.second)
+						{
+							Model::Vertex vertex{};
+							vertex.position = positions[position];
+							vertex.colour = colours[position];
+							vertex.uv = uv != 0 ? uvs[uv - 1] : glm::vec2(0.0f);
+							builder.vertices.push_back(vertex);
+						}
+						faceCorners.push_back(inserted.first->second);
+					}
+
+					if (faceCorners.size() < 3)
+						throw std::runtime_error("Face with fewer than 3 corners in " + filepath + " on line " + std::to_string(lineNumber));
+					for (size_t corner = 1; corner + 1 < faceCorners.size(); corner++)
+					{
+						builder.indices.push_back(faceCorners[0]);
+						builder.indices.push_back(faceCorners[corner]);
+						builder.indices.push_back(faceCorners[corner + 1]);
+					}
+				}
+
+				cursor = lineEnd + 1;
+			}
+
+			if (builder.indices.empty())
+				throw std::runtime_error("Model file has no faces: " + filepath);
+
+			// Fit the unit square around the origin, keeping the aspect ratio
+			Model::Bounds bounds = Model::Bounds::fromVertices(builder.vertices.data(), builder.vertices.size());
+			const glm::vec2 centre = (bounds.min + bounds.max) * 0.5f;
+			const glm::vec2 extent = bounds.max - bounds.min;
+			const float largestExtent = std::max(extent.x, extent.y);
+			const float scale = largestExtent > 0.0f ? 1.0f / largestExtent : 1.0f;
+			for (Model::Vertex& vertex : builder.vertices)
+				vertex.position = (vertex.position - centre) * scale;
+
+			return builder;
+		}
+
+		SourceStamp getSourceStamp(const std::string& filepath)
+		{
+			std::error_code error;
+			SourceStamp stamp;
+			stamp.size = std::filesystem::file_size(filepath, error);
+			if (error)
+				throw std::runtime_error("Failed to open model file: " + filepath);
+			stamp.modifiedTime = static_cast<int64_t>(std::filesystem::last_write_time(filepath, error).time_since_epoch().count());
+			return stamp;
+		}
+
+		std::string cachePathFor(const std::string& sourcePath)
+		{
+			return sourcePath + CACHE_EXTENSION;
+		}
+
+		void writeCacheFile(const std::string& cachePath, const Model::Builder& builder, const SourceStamp& source)
+		{
+			const uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+			const bool shortIndices = Model::indexTypeFor(vertexCount) == VK_INDEX_TYPE_UINT16;
+
+			CacheHeader header{};
+			memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+			header.version = CACHE_VERSION;
+			header.vertexStride = sizeof(Model::Vertex);
+			header.vertexCount = vertexCount;
+			header.indexCount = static_cast<uint32_t>(builder.indices.size());
+			header.indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+			Model::Bounds bounds = Model::Bounds::fromVertices(builder.vertices.data(), builder.vertices.size());
+			header.boundsMin = bounds.min;
+			header.boundsMax = bounds.max;
+			header.sourceSize = source.size;
+			header.sourceTime = source.modifiedTime;
+			header.vertexOffset = alignUp(sizeof(CacheHeader), CACHE_ALIGNMENT);
+			header.indexOffset = alignUp(header.vertexOffset + uint64_t{ vertexCount } * sizeof(Model::Vertex), CACHE_ALIGNMENT);
+
+			std::vector<uint8_t> contents(header.indexOffset + uint64_t{ header.indexCount } * header.indexSize);
+			memcpy(contents.data(), &header, sizeof(header));
+			memcpy(contents.data() + header.vertexOffset, builder.vertices.data(), builder.vertices.size() * sizeof(Model::Vertex));
+			if (shortIndices)
+			{
+				uint16_t* indices = reinterpret_cast<uint16_t*>(contents.data() + header.indexOffset);
+				for (size_t i = 0; i < builder.indices.size(); i++)
+					indices[i] = static_cast<uint16_t>(builder.indices[i]);
+			}
+			else
+			{
+				memcpy(contents.data() + header.indexOffset, builder.indices.data(), builder.indices.size() * sizeof(uint32_t));
+			}
+
+			// Written to a temporary file first, so a crash midway never leaves a truncated cache behind
+			const std::string temporaryPath = cachePath + ".tmp";
+			{
+				std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+				if (!file.is_open())
+					throw std::runtime_error("Failed to write mesh cache: " + cachePath);
+				file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+				if (!file)
+					throw std::runtime_error("Failed to write mesh cache: " + cachePath);
+			}
+
+			std::error_code error;
+			std::filesystem::rename(temporaryPath, cachePath, error);
+			if (error)
+			{
+				std::filesystem::remove(temporaryPath, error);
+				throw std::runtime_error("Failed to write mesh cache: " + cachePath);
+			}
+		}
+
+		bool mapCacheFile(const std::string& cachePath, const SourceStamp& source, MappedMesh& mesh)
+		{
+			MappedFile& file = mesh.file;
+			if (!file.open(cachePath))
+				return false;
+
+			CacheHeader header;
+			if (file.size() < sizeof(CacheHeader))
+			{
+				file.close();
+				return false;
+			}
+			memcpy(&header, file.data(), sizeof(header));
+
+			// The offsets come straight from the file, so the ranges are checked by subtracting from their end
+			// rather than adding to their start, which a huge offset could wrap around
+			const uint64_t fileSize = file.size();
+			const uint64_t vertexBytes = uint64_t{ header.vertexCount } * sizeof(Model::Vertex);
+			const uint64_t indexBytes = uint64_t{ header.indexCount } * header.indexSize;
+			bool valid =
+				memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+				header.version == CACHE_VERSION &&
+				header.vertexStride == sizeof(Model::Vertex) &&
+				header.sourceSize == source.size &&
+				header.sourceTime == source.modifiedTime &&
+				header.vertexCount >= 3 &&
+				header.indexCount >= 3 && header.indexCount % 3 == 0 &&
+				(header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t)) &&
+				header.vertexOffset % CACHE_ALIGNMENT == 0 && header.indexOffset % CACHE_ALIGNMENT == 0 &&
+				header.vertexOffset >= sizeof(CacheHeader) &&
+				header.vertexOffset <= header.indexOffset && vertexBytes <= header.indexOffset - header.vertexOffset &&
+				header.indexOffset <= fileSize && indexBytes <= fileSize - header.indexOffset;
+
+			// An index past the last vertex would have the GPU read outside the vertex buffer, so such a cache
+			// is thrown away like any other corrupt one and the source parsed again
+			if (valid)
+			{
+				const uint8_t* indexData = file.data() + header.indexOffset;
+				valid = header.indexSize == sizeof(uint16_t) ?
+					indicesInRange<uint16_t>(indexData, header.indexCount, header.vertexCount) :
+					indicesInRange<uint32_t>(indexData, header.indexCount, header.vertexCount);
+			}
+			if (!valid)
+			{
+				file.close();
+				return false;
+			}
+
+			mesh.vertices = reinterpret_cast<const Model::Vertex*>(file.data() + header.vertexOffset);
+			mesh.vertexCount = header.vertexCount;
+			mesh.indices = file.data() + header.indexOffset;
+			mesh.indexCount = header.indexCount;
+			mesh.indexType = header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+			mesh.bounds.min = header.boundsMin;
+			mesh.bounds.max = header.boundsMax;
+			return true;
+		}
+
+		MappedFile::~MappedFile()
+		{
+			close();
+		}
+
+#ifdef _WIN32
+		bool MappedFile::open(const std::string& filepath)
+		{
+			close();
+
+			HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				CloseHandle(file);
+				return false;
+			}
+
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (view == nullptr)
+			{
+				if (mapping != nullptr)
+					CloseHandle(mapping);
+				CloseHandle(file);
+				return false;
+			}
+
+			fileHandle = file;
+			mappingHandle = mapping;
+			mappedData = static_cast<const uint8_t*>(view);
+			mappedSize = static_cast<uint64_t>(fileSize.QuadPart);
+			return true;
+		}
+
+		void MappedFile::close()
+		{
+			if (mappedData != nullptr)
+				UnmapViewOfFile(mappedData);
+			if (mappingHandle != nullptr)
+				CloseHandle(mappingHandle);
+			if (fileHandle != nullptr)
+				CloseHandle(fileHandle);
+			mappedData = nullptr;
+			mappedSize = 0;
+			mappingHandle = nullptr;
+			fileHandle = nullptr;
+		}
+#else
+		bool MappedFile::open(const std::string& filepath)
+		{
+			close();
+
+			int file = ::open(filepath.c_str(), O_RDONLY);
+			if (file < 0)
+				return false;
+
+			struct stat fileInfo;
+			if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0)
+			{
+				::close(file);
+				return false;
+			}
+
+			// The mapping keeps its own reference to the file, the descriptor isn't needed afterwards
+			void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			::close(file);
+			if (view == MAP_FAILED)
+				return false;
+
+			mappedData = static_cast<const uint8_t*>(view);
+			mappedSize = static_cast<uint64_t>(fileInfo.st_size);
+			return true;
+		}
+
+		void MappedFile::close()
+		{
+			if (mappedData != nullptr)
+				munmap(const_cast<uint8_t*>(mappedData), static_cast<size_t>(mappedSize));
+			mappedData = nullptr;
+			mappedSize = 0;
+		}
+#endif
+
+	}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace VulkanSandbox {
+
+	// Loads meshes into Model::Builders and keeps a preprocessed binary copy of them next to the source file.
+	// Parsing text formats is slow, the cache holds the welded vertices and (already narrowed) indices exactly as
+	// they get uploaded, so later runs map it into memory and copy straight from the mapping into staging.
+	// CPU only, so it can be built and benchmarked without a GPU (see benchmarks/MeshLoaderBenchmark.cpp).
+	namespace MeshLoader {
+
+		// Appended to the source path, ie. "models/ship.obj" is cached as "models/ship.obj.vsmesh"
+		constexpr const char* CACHE_EXTENSION = ".vsmesh";
+		// Bump whenever the file layout or the preprocessing changes, older caches are then rebuilt
+		constexpr uint32_t CACHE_VERSION = 1;
+
+		// Size and modification time of the source file, a cache written for a different stamp is stale
+		struct SourceStamp {
+			uint64_t size = 0;
+			int64_t modifiedTime = 0;
+		};
+
+		// Wavefront OBJ: "v x y [z [r g b]]", "vt u v" and "f" with any number of corners (fanned into triangles),
+		// everything else is ignored. The sandbox is 2D, so z is dropped and y flipped (OBJ's y points up,
+		// Vulkan's down), as is v for the same reason. Corners sharing a position and UV index are welded into
+		// one vertex. Positions are then recentred and scaled to fit the unit square around the origin, like
+		// the built-in shapes, so any mesh can be dropped in.
+		Model::Builder parseObjFile(const std::string& filepath);
+
+		SourceStamp getSourceStamp(const std::string& filepath);
+		std::string cachePathFor(const std::string& sourcePath);
+		void writeCacheFile(const std::string& cachePath, const Model::Builder& builder, const SourceStamp& source);
+
+		// Read only memory mapping of a whole file, unmapped when destroyed
+		class MappedFile {
+
+		public:
+			MappedFile() = default;
+			~MappedFile();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			// Returns false if the file can't be opened or is empty
+			bool open(const std::string& filepath);
+			void close();
+
+			const uint8_t* data() const { return mappedData; }
+			uint64_t size() const { return mappedSize; }
+
+		private:
+			const uint8_t* mappedData = nullptr;
+			uint64_t mappedSize = 0;
+#ifdef _WIN32
+			void* fileHandle = nullptr;
+			void* mappingHandle = nullptr;
+#endif
+		};
+
+		// A cache file's contents, pointing straight into its mapping
+		struct MappedMesh {
+			MappedFile file;
+			const Model::Vertex* vertices = nullptr;
+			uint32_t vertexCount = 0;
+			const void* indices = nullptr;
+			uint32_t indexCount = 0;
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+			Model::Bounds bounds;
+		};
+
+		// Returns false (leaving mesh unmapped) when the cache is missing, corrupt (including indices past the
+		// last vertex), from another version or Vertex layout, or written for a different source stamp
+		bool mapCacheFile(const std::string& cachePath, const SourceStamp& source, MappedMesh& mesh);
+
+	}
+
+}
@@ -0,0 +1,92 @@
+#include "SandboxScene.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cassert>
+#include <cmath>
+
+namespace VulkanSandbox {
+
+	SandboxScene::ModelHandle SandboxScene::addModel(const std::shared_ptr<Model>& model)
+	{
+		assert(model != nullptr && "Cannot add a null model to the scene!");
+
+		auto handle = modelHandlesByPointer.try_emplace(model.get(), static_cast<ModelHandle>(models.size()));
+		if (handle.second)
+			models.push_back(model);
+		return handle.first->second;
+	}
+
+	SandboxObject::id_t SandboxScene::addObject(SandboxObject&& object)
+	{
+		const SandboxObject::id_t id = object.getId();
+		assert(!contains(id) && "Object is already in the scene!");
+
+		if (id >= denseIndices.size())
+			denseIndices.resize(static_cast<size_t>(id) + 1, INVALID_INDEX);
+		denseIndices[id] = static_cast<uint32_t>(ids.size());
+
+		ids.push_back(id);
+		translations.push_back(object.transform2D.translation);
+		rotations.push_back(object.transform2D.rotation);
+		scales.push_back(object.transform2D.scale);
+		colours.push_back(object.colour);
+		modelHandles.push_back(addModel(object.model));
+
+		// The scene holds the only model reference it needs, drop the object's one
+		object.model.reset();
+		version++;
+		return id;
+	}
+
+	void SandboxScene::removeObject(SandboxObject::id_t id)
+	{
+		const uint32_t index = indexOf(id);
+		assert(index != INVALID_INDEX && "Cannot remove an object that isn't in the scene!");
+
+		const uint32_t lastIndex = static_cast<uint32_t>(ids.size() - 1);
+		if (index != lastIndex)
+		{
+			ids[index] = ids[lastIndex];
+			translations[index] = translations[lastIndex];
+			rotations[index] = rotations[lastIndex];
+			scales[index] = scales[lastIndex];
+			colours[index] = colours[lastIndex];
+			modelHandles[index] = modelHandles[lastIndex];
+			denseIndices[ids[index]] = index;
+		}
+
+		ids.pop_back();
+		translations.pop_back();
+		rotations.pop_back();
+		scales.pop_back();
+		colours.pop_back();
+		modelHandles.pop_back();
+		denseIndices[id] = INVALID_INDEX;
+		version++;
+	}
+
+	uint32_t SandboxScene::indexOf(SandboxObject::id_t id) const
+	{
+		return id < denseIndices.size() ? denseIndices[id] : INVALID_INDEX;
+	}
+
+	void SandboxScene::reserve(size_t objectCount)
+	{
+		ids.reserve(objectCount);
+		translations.reserve(objectCount);
+		rotations.reserve(objectCount);
+		scales.reserve(objectCount);
+		colours.reserve(objectCount);
+		modelHandles.reserve(objectCount);
+	}
+
+	void SandboxScene::addRotation(float radians)
+	{
+		// Kept in [-pi, pi), left to grow the angles would soon be past what the transform kernel's sin/cos is
+		// accurate for (and past where a float can still tell one tick's step apart)
+		for (float& rotation : rotations)
+			rotation = std::remainder(rotation + radians, glm::two_pi<float>());
+	}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SandboxObject.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// Structure-of-arrays storage for every object in the sandbox. Each component lives in its own contiguous
+	// array (all indexed the same way), so per-frame passes over one or two components stream through memory
+	// instead of hopping between SandboxObjects and their shared_ptr<Model>s.
+	//
+	// Objects are referred to by their SandboxObject::id_t, which stays valid until the object is removed.
+	// Dense indices are not stable: removal swaps the last object into the removed slot.
+	class SandboxScene {
+
+	public:
+		// Index into the scene's model list, objects store this rather than a shared_ptr<Model>
+		using ModelHandle = uint32_t;
+
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		SandboxScene() = default;
+
+		SandboxScene(const SandboxScene&) = delete;
+		SandboxScene& operator=(const SandboxScene&) = delete;
+
+		// Registers a model with the scene (or returns its existing handle), the scene keeps it alive
+		ModelHandle addModel(const std::shared_ptr<Model>& model);
+		Model* getModel(ModelHandle handle) const { return models[handle].get(); }
+		size_t modelCount() const { return models.size(); }
+
+		// Takes over the object's components, the object's id becomes its handle in the scene
+		SandboxObject::id_t addObject(SandboxObject&& object);
+		// Swap-and-pop, the last object moves into the removed one's slot
+		void removeObject(SandboxObject::id_t id);
+		bool contains(SandboxObject::id_t id) const { return indexOf(id) != INVALID_INDEX; }
+		// Dense index of the object, only valid until the next removal
+		uint32_t indexOf(SandboxObject::id_t id) const;
+
+		// Bumped whenever objects are added or removed, ie. whenever anything but the per-tick components changes
+		uint64_t getVersion() const { return version; }
+
+		size_t size() const { return ids.size(); }
+		bool empty() const { return ids.empty(); }
+		void reserve(size_t objectCount);
+
+		// Linear pass over every object's rotation, which stays wrapped into [-pi, pi)
+		void addRotation(float radians);
+
+		// Component arrays, all indexed by dense index [0, size())
+		std::vector<SandboxObject::id_t> ids;
+		std::vector<glm::vec2> translations;
+		std::vector<float> rotations;
+		std::vector<glm::vec2> scales;
+		std::vector<glm::vec4> colours;
+		std::vector<ModelHandle> modelHandles;
+
+	private:
+		std::vector<std::shared_ptr<Model>> models;
+		std::unordered_map<Model*, ModelHandle> modelHandlesByPointer;
+
+		// Sparse id -> dense index lookup, INVALID_INDEX for ids that aren't (or are no longer) in the scene
+		std::vector<uint32_t> denseIndices;
+		uint64_t version = 0;
+	};
+
+}
@@ -0,0 +1,146 @@
+#include "SandboxSimulation.hpp"
+#include "SandboxTransformKernel.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace VulkanSandbox {
+
+	SandboxSimulation::SandboxSimulation(SandboxScene& scene, double tickRate, bool useWorkerThread)
+		: scene(scene), tickRate(tickRate)
+	{
+		previousRotations = scene.rotations;
+		previousRotationsVersion = scene.getVersion();
+
+		if (useWorkerThread)
+			worker = std::thread(&SandboxSimulation::workerLoop, this);
+	}
+
+	SandboxSimulation::~SandboxSimulation()
+	{
+		if (!worker.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		updateRequested.notify_one();
+		worker.join();
+	}
+
+	void SandboxSimulation::beginUpdate(double seconds)
+	{
+		if (!worker.joinable())
+		{
+			update(seconds, snapshots[writeSnapshot]);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		pendingSeconds = seconds;
+		updatePending = true;
+		updateRequested.notify_one();
+	}
+
+	const SandboxSimulation::Snapshot& SandboxSimulation::waitForSnapshot()
+	{
+		if (worker.joinable())
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			updateFinished.wait(lock, [this]() { return !updatePending; });
+		}
+
+		// The next update writes into the other snapshot, leaving this one alone while it's being recorded
+		const Snapshot& snapshot = snapshots[writeSnapshot];
+		writeSnapshot = 1 - writeSnapshot;
+		return snapshot;
+	}
+
+	void SandboxSimulation::workerLoop()
+	{
+		std::unique_lock<std::mutex> lock{ mutex };
+		while (true)
+		{
+			updateRequested.wait(lock, [this]() { return stopping || updatePending; });
+			if (stopping)
+				return;
+
+			double seconds = pendingSeconds;
+			Snapshot& snapshot = snapshots[writeSnapshot];
+			lock.unlock();
+
+			update(seconds, snapshot);
+
+			lock.lock();
+			updatePending = false;
+			updateFinished.notify_one();
+		}
+	}
+
+	void SandboxSimulation::update(double seconds, Snapshot& snapshot)
+	{
+		const double tickSeconds = 1.0 / tickRate;
+
+		// Objects may have been added/removed since the last update, interpolate those from where they are now.
+		// Going by the scene's version rather than its size also catches a removal followed by an add, which
+		// leaves the size as it was but moves objects into other slots.
+		if (previousRotationsVersion != scene.getVersion())
+		{
+			previousRotations = scene.rotations;
+			previousRotationsVersion = scene.getVersion();
+		}
+
+		// Too far behind to catch up within one update, give up on the missed time instead
+		const double maxCatchUpSeconds = MAX_TICKS_PER_UPDATE * tickSeconds;
+		if (seconds - simulatedSeconds > maxCatchUpSeconds)
+			simulatedSeconds = seconds - maxCatchUpSeconds;
+
+		while (simulatedSeconds + tickSeconds <= seconds)
+		{
+			previousRotations = scene.rotations;
+			tick(static_cast<float>(tickSeconds));
+			simulatedSeconds += tickSeconds;
+			tickCount++;
+		}
+
+		// How far past the last tick the requested time is. Blending the last two ticks by that keeps motion
+		// smooth at any frame rate, at the cost of showing the scene one tick behind.
+		const float alpha = static_cast<float>(std::clamp((seconds - simulatedSeconds) / tickSeconds, 0.0, 1.0));
+		interpolatedRotations.resize(scene.size());
+		for (size_t i = 0; i < scene.size(); i++)
+		{
+			// The rotations are wrapped, so a tick that crossed the seam looks like almost a full turn back.
+			// Blending the shortest way round keeps those objects turning forwards.
+			const float delta = std::remainder(scene.rotations[i] - previousRotations[i], glm::two_pi<float>());
+			interpolatedRotations[i] = previousRotations[i] + delta * alpha;
+		}
+
+		snapshot.transforms.resize(scene.size());
+		TransformKernel::computeTransforms(
+			interpolatedRotations.data(), 
+			scene.scales.data(), 
+			snapshot.transforms.data(), 
+			scene.size());
+
+		// Nothing changes these per tick, each snapshot buffer only needs a fresh copy after the scene changed
+		if (snapshot.sceneVersion != scene.getVersion())
+		{
+			snapshot.translations = scene.translations;
+			snapshot.colours = scene.colours;
+			snapshot.modelHandles = scene.modelHandles;
+			snapshot.sceneVersion = scene.getVersion();
+		}
+
+		snapshot.tick = tickCount;
+		snapshot.alpha = alpha;
+	}
+
+	void SandboxSimulation::tick(float deltaSeconds)
+	{
+		scene.addRotation(ROTATION_SPEED * deltaSeconds);
+	}
+
+}
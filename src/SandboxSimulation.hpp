@@ -0,0 +1,83 @@
+#pragma once
+
+#include "SandboxScene.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// Runs the scene's simulation in fixed timesteps, separately from rendering. Each update advances the scene
+	// to a point in time and publishes an immutable Snapshot (interpolated between the last two ticks), which is
+	// all that recording reads. Snapshots are double buffered, so with a worker thread the update for frame N+1
+	// runs while frame N is being recorded and submitted.
+	//
+	// The scene belongs to the simulation while an update is in flight, only modify it after waitForSnapshot().
+	class SandboxSimulation {
+
+	public:
+		static constexpr double DEFAULT_TICK_RATE = 120.0;
+		// Radians per second every object spins at
+		static constexpr float ROTATION_SPEED = 0.1f;
+		// Falling further behind than this (eg. after a breakpoint) drops time rather than ticking to catch up
+		static constexpr uint32_t MAX_TICKS_PER_UPDATE = 8;
+
+		// Everything recording needs for one frame, in scene (dense index) order
+		struct Snapshot {
+			std::vector<glm::mat2> transforms;
+			std::vector<glm::vec2> translations;
+			std::vector<glm::vec4> colours;
+			std::vector<SandboxScene::ModelHandle> modelHandles;
+
+			uint64_t tick = 0;			// last completed tick
+			float alpha = 0.0f;			// interpolation factor between the previous tick and tick
+			uint64_t sceneVersion = ~0ull;	// static components are only re-copied when the scene changed
+		};
+
+		SandboxSimulation(SandboxScene& scene, double tickRate, bool useWorkerThread);
+		~SandboxSimulation();
+
+		SandboxSimulation(const SandboxSimulation&) = delete;
+		SandboxSimulation& operator=(const SandboxSimulation&) = delete;
+
+		// Starts advancing the simulation to the given time (seconds since it started), then writes a snapshot.
+		// Runs on the worker thread if there is one, otherwise right away.
+		void beginUpdate(double seconds);
+		// Blocks until the update started by beginUpdate(..) has finished. The returned snapshot stays unchanged
+		// until the next-but-one beginUpdate(..), so it can be read while the next update runs.
+		const Snapshot& waitForSnapshot();
+
+		uint64_t getTickCount() const { return tickCount; }
+		double getTickRate() const { return tickRate; }
+
+	private:
+		void update(double seconds, Snapshot& snapshot);
+		void tick(float deltaSeconds);
+		void workerLoop();
+
+		SandboxScene& scene;
+		const double tickRate;
+
+		// Only touched by whichever thread runs update(..)
+		uint64_t tickCount = 0;
+		double simulatedSeconds = 0.0;
+		std::vector<float> previousRotations;
+		uint64_t previousRotationsVersion = 0;	// scene version previousRotations lines up with
+		std::vector<float> interpolatedRotations;
+
+		Snapshot snapshots[2];
+		uint32_t writeSnapshot = 0;
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable updateRequested;
+		std::condition_variable updateFinished;
+		bool updatePending = false;
+		double pendingSeconds = 0.0;
+		bool stopping = false;
+	};
+
+}
@@ -0,0 +1,81 @@
+#include "SandboxThreadPool.hpp"
+
+#include <cassert>
+
+namespace VulkanSandbox {
+
+	SandboxThreadPool::SandboxThreadPool(uint32_t threadCount)
+	{
+		assert(threadCount > 0 && "Thread pool needs at least one worker!");
+
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+			workers.emplace_back(&SandboxThreadPool::workerLoop, this, i);
+	}
+
+	SandboxThreadPool::~SandboxThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		workAvailable.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	void SandboxThreadPool::parallelFor(uint32_t count, const Task& task)
+	{
+		if (count == 0)
+			return;
+
+		std::unique_lock<std::mutex> lock{ mutex };
+		currentTask = &task;
+		taskCount = count;
+		nextTask = 0;
+		tasksRemaining = count;
+		taskError = nullptr;
+		workAvailable.notify_all();
+
+		workDone.wait(lock, [this]() { return tasksRemaining == 0; });
+		currentTask = nullptr;
+		taskCount = 0;
+
+		if (taskError)
+			std::rethrow_exception(taskError);
+	}
+
+	void SandboxThreadPool::workerLoop(uint32_t threadIndex)
+	{
+		std::unique_lock<std::mutex> lock{ mutex };
+		while (true)
+		{
+			workAvailable.wait(lock, [this]() { return stopping || nextTask < taskCount; });
+			if (stopping)
+				return;
+
+			// Tasks are handed out under the lock, they're coarse (a handful per frame) so it's never contended
+			uint32_t taskIndex = nextTask++;
+			const Task* task = currentTask;
+			lock.unlock();
+
+			std::exception_ptr error;
+			try
+			{
+				(*task)(taskIndex, threadIndex);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			if (error && !taskError)
+				taskError = error;
+			if (--tasksRemaining == 0)
+				workDone.notify_one();
+		}
+	}
+
+}
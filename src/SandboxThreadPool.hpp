@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// A fixed set of worker threads that run batches of tasks. parallelFor(..) hands each task the index of
+	// the worker running it, so per-thread resources (eg. command pools) can be used without locking.
+	class SandboxThreadPool {
+
+	public:
+		using Task = std::function<void(uint32_t taskIndex, uint32_t threadIndex)>;
+
+		SandboxThreadPool(uint32_t threadCount);
+		~SandboxThreadPool();
+
+		SandboxThreadPool(const SandboxThreadPool&) = delete;
+		SandboxThreadPool& operator=(const SandboxThreadPool&) = delete;
+
+		uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+		// Runs task(i, threadIndex) for every i in [0, taskCount) on the workers and blocks until all of them
+		// have finished. The first exception thrown by a task is rethrown here.
+		void parallelFor(uint32_t taskCount, const Task& task);
+
+	private:
+		void workerLoop(uint32_t threadIndex);
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workDone;
+
+		const Task* currentTask = nullptr;
+		uint32_t taskCount = 0;
+		uint32_t nextTask = 0;
+		uint32_t tasksRemaining = 0;
+		std::exception_ptr taskError;
+		bool stopping = false;
+	};
+
+}
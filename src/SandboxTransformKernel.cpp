@@ -0,0 +1,330 @@
+#include "SandboxTransformKernel.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SANDBOX_TRANSFORM_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows AVX2 intrinsics anywhere, GCC/Clang need the function itself compiled for AVX2
+#if defined(SANDBOX_TRANSFORM_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SANDBOX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SANDBOX_TARGET_AVX2
+#endif
+
+namespace VulkanSandbox {
+
+	namespace TransformKernel {
+
+		static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "Scales are read as interleaved x/y floats");
+		static_assert(sizeof(glm::mat2) == 4 * sizeof(float), "Transforms are written as 4 packed floats (column major)");
+
+		// pi/2 split into three parts (Cephes' DP1..DP3 doubled), the first two have few enough mantissa bits
+		// that k * part is exact for the quadrant counts we care about
+		static constexpr float TWO_OVER_PI = 0.636619772367581343f;
+		static constexpr float PI_OVER_2_PART1 = 1.5703125f;
+		static constexpr float PI_OVER_2_PART2 = 4.837512969970703125e-4f;
+		static constexpr float PI_OVER_2_PART3 = 7.54978995489188216e-8f;
+
+		// Minimax polynomials for sin/cos on [-pi/4, pi/4]
+		static constexpr float SIN_C1 = -1.6666654611e-1f;
+		static constexpr float SIN_C2 = 8.3321608736e-3f;
+		static constexpr float SIN_C3 = -1.9515295891e-4f;
+		static constexpr float COS_C1 = 4.166664568298827e-2f;
+		static constexpr float COS_C2 = -1.388731625493765e-3f;
+		static constexpr float COS_C3 = 2.443315711809948e-5f;
+
+		void sinCos(float radians, float& outSin, float& outCos)
+		{
+			// Nearest quadrant, rounding half to even like the SIMD paths (std::nearbyint is a slow library call)
+#if defined(SANDBOX_TRANSFORM_KERNEL_X86)
+			const int32_t quadrant = _mm_cvtss_si32(_mm_set_ss(radians * TWO_OVER_PI));
+#else
+			const int32_t quadrant = static_cast<int32_t>(std::nearbyint(radians * TWO_OVER_PI));
+#endif
+			const float k = static_cast<float>(quadrant);
+
+			float r = radians - k * PI_OVER_2_PART1;
+			r = r - k * PI_OVER_2_PART2;
+			r = r - k * PI_OVER_2_PART3;
+			const float r2 = r * r;
+
+			const float sinR = r + r * r2 * (SIN_C1 + r2 * (SIN_C2 + r2 * SIN_C3));
+			const float cosR = (1.0f - 0.5f * r2) + r2 * r2 * (COS_C1 + r2 * (COS_C2 + r2 * COS_C3));
+
+			// Odd quadrants swap sin and cos, then quadrants 2,3 negate sin and 1,2 negate cos
+			const bool swap = (quadrant & 1) != 0;
+			float s = swap ? cosR : sinR;
+			float c = swap ? sinR : cosR;
+			outSin = (quadrant & 2) ? -s : s;
+			outCos = ((quadrant + 1) & 2) ? -c : c;
+		}
+
+		static void computeTransformsScalar(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				float s, c;
+				sinCos(rotations[i], s, c);
+
+				float* out = reinterpret_cast<float*>(&outTransforms[i]);
+				out[0] = c * scales[i].x;
+				out[1] = s * scales[i].x;
+				out[2] = -s * scales[i].y;
+				out[3] = c * scales[i].y;
+			}
+		}
+
+#if defined(SANDBOX_TRANSFORM_KERNEL_X86)
+
+		static void computeTransformsSSE2(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count)
+		{
+			const float* scaleFloats = reinterpret_cast<const float*>(scales);
+			float* outFloats = reinterpret_cast<float*>(outTransforms);
+			const __m128i one = _mm_set1_epi32(1);
+			const __m128i two = _mm_set1_epi32(2);
+
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 x = _mm_loadu_ps(rotations + i);
+
+				// Same reduction/polynomials as sinCos(..), 4 objects at a time
+				const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+				const __m128 k = _mm_cvtepi32_ps(quadrant);
+				__m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(PI_OVER_2_PART1)));
+				r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PI_OVER_2_PART2)));
+				r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PI_OVER_2_PART3)));
+				const __m128 r2 = _mm_mul_ps(r, r);
+
+				__m128 sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C2), _mm_mul_ps(r2, _mm_set1_ps(SIN_C3)));
+				sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C1), _mm_mul_ps(r2, sinPoly));
+				const __m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+
+				__m128 cosPoly = _mm_add_ps(_mm_set1_ps(COS_C2), _mm_mul_ps(r2, _mm_set1_ps(COS_C3)));
+				cosPoly = _mm_add_ps(_mm_set1_ps(COS_C1), _mm_mul_ps(r2, cosPoly));
+				const __m128 cosR = _mm_add_ps(
+					_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+					_mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+				// No blendv in SSE2, select with and/andnot/or
+				const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+				__m128 s = _mm_or_ps(_mm_and_ps(swap, cosR), _mm_andnot_ps(swap, sinR));
+				__m128 c = _mm_or_ps(_mm_and_ps(swap, sinR), _mm_andnot_ps(swap, cosR));
+				// (quadrant & 2) << 30 lands exactly on the sign bit
+				s = _mm_xor_ps(s, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30)));
+				c = _mm_xor_ps(c, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30)));
+
+				// Deinterleave the x/y scales of the 4 objects
+				const __m128 scales01 = _mm_loadu_ps(scaleFloats + i * 2);
+				const __m128 scales23 = _mm_loadu_ps(scaleFloats + i * 2 + 4);
+				const __m128 scaleX = _mm_shuffle_ps(scales01, scales23, _MM_SHUFFLE(2, 0, 2, 0));
+				const __m128 scaleY = _mm_shuffle_ps(scales01, scales23, _MM_SHUFFLE(3, 1, 3, 1));
+
+				// One register per matrix element, then transpose so each register holds one object's matrix
+				__m128 m00 = _mm_mul_ps(c, scaleX);
+				__m128 m01 = _mm_mul_ps(s, scaleX);
+				__m128 m10 = _mm_mul_ps(_mm_xor_ps(s, _mm_set1_ps(-0.0f)), scaleY);
+				__m128 m11 = _mm_mul_ps(c, scaleY);
+				_MM_TRANSPOSE4_PS(m00, m01, m10, m11);
+
+				_mm_storeu_ps(outFloats + i * 4, m00);
+				_mm_storeu_ps(outFloats + i * 4 + 4, m01);
+				_mm_storeu_ps(outFloats + i * 4 + 8, m10);
+				_mm_storeu_ps(outFloats + i * 4 + 12, m11);
+			}
+
+			computeTransformsScalar(rotations + i, scales + i, outTransforms + i, count - i);
+		}
+
+		SANDBOX_TARGET_AVX2
+		static void computeTransformsAVX2(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count)
+		{
+			const float* scaleFloats = reinterpret_cast<const float*>(scales);
+			float* outFloats = reinterpret_cast<float*>(outTransforms);
+			const __m256i one = _mm256_set1_epi32(1);
+			const __m256i two = _mm256_set1_epi32(2);
+
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m256 x = _mm256_loadu_ps(rotations + i);
+
+				// Same reduction/polynomials as sinCos(..), 8 objects at a time
+				const __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+				const __m256 k = _mm256_cvtepi32_ps(quadrant);
+				__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(PI_OVER_2_PART1)));
+				r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(PI_OVER_2_PART2)));
+				r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(PI_OVER_2_PART3)));
+				const __m256 r2 = _mm256_mul_ps(r, r);
+
+				__m256 sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SIN_C3)));
+				sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C1), _mm256_mul_ps(r2, sinPoly));
+				const __m256 sinR = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sinPoly));
+
+				__m256 cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C2), _mm256_mul_ps(r2, _mm256_set1_ps(COS_C3)));
+				cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C1), _mm256_mul_ps(r2, cosPoly));
+				const __m256 cosR = _mm256_add_ps(
+					_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)),
+					_mm256_mul_ps(_mm256_mul_ps(r2, r2), cosPoly));
+
+				const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+				__m256 s = _mm256_blendv_ps(sinR, cosR, swap);
+				__m256 c = _mm256_blendv_ps(cosR, sinR, swap);
+				s = _mm256_xor_ps(s, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30)));
+				c = _mm256_xor_ps(c, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30)));
+
+				// Deinterleave the x/y scales of the 8 objects, the shuffle works per 128 bit lane so
+				// the 64 bit pairs come out as 0,1 | 4,5 | 2,3 | 6,7 and need putting back in order
+				const __m256 scales0123 = _mm256_loadu_ps(scaleFloats + i * 2);
+				const __m256 scales4567 = _mm256_loadu_ps(scaleFloats + i * 2 + 8);
+				const __m256 scaleX = _mm256_castpd_ps(_mm256_permute4x64_pd(
+					_mm256_castps_pd(_mm256_shuffle_ps(scales0123, scales4567, _MM_SHUFFLE(2, 0, 2, 0))),
+					_MM_SHUFFLE(3, 1, 2, 0)));
+				const __m256 scaleY = _mm256_castpd_ps(_mm256_permute4x64_pd(
+					_mm256_castps_pd(_mm256_shuffle_ps(scales0123, scales4567, _MM_SHUFFLE(3, 1, 3, 1))),
+					_MM_SHUFFLE(3, 1, 2, 0)));
+
+				const __m256 m00 = _mm256_mul_ps(c, scaleX);
+				const __m256 m01 = _mm256_mul_ps(s, scaleX);
+				const __m256 m10 = _mm256_mul_ps(_mm256_xor_ps(s, _mm256_set1_ps(-0.0f)), scaleY);
+				const __m256 m11 = _mm256_mul_ps(c, scaleY);
+
+				// 4x8 -> 8x4 transpose, each 128 bit half of the results holds one object's matrix
+				const __m256 t0 = _mm256_unpacklo_ps(m00, m01); // 0 1 | 4 5 (m00, m01 pairs)
+				const __m256 t1 = _mm256_unpackhi_ps(m00, m01); // 2 3 | 6 7
+				const __m256 t2 = _mm256_unpacklo_ps(m10, m11);
+				const __m256 t3 = _mm256_unpackhi_ps(m10, m11);
+				const __m256 object04 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+				const __m256 object15 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+				const __m256 object26 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+				const __m256 object37 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+				_mm256_storeu_ps(outFloats + i * 4, _mm256_permute2f128_ps(object04, object15, 0x20));
+				_mm256_storeu_ps(outFloats + i * 4 + 8, _mm256_permute2f128_ps(object26, object37, 0x20));
+				_mm256_storeu_ps(outFloats + i * 4 + 16, _mm256_permute2f128_ps(object04, object15, 0x31));
+				_mm256_storeu_ps(outFloats + i * 4 + 24, _mm256_permute2f128_ps(object26, object37, 0x31));
+			}
+
+			computeTransformsSSE2(rotations + i, scales + i, outTransforms + i, count - i);
+		}
+
+		static bool cpuSupportsAVX2()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+
+			// The OS also has to save the YMM registers on context switches (OSXSAVE + XCR0 bits 1 and 2)
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+				return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			// Also checks that the OS has enabled the YMM state
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+
+#endif
+
+		SimdLevel detectSimdLevel()
+		{
+#if defined(SANDBOX_TRANSFORM_KERNEL_X86)
+			static const SimdLevel level = cpuSupportsAVX2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+			return level;
+#else
+			return SimdLevel::Scalar;
+#endif
+		}
+
+		const char* simdLevelName(SimdLevel level)
+		{
+			switch (level)
+			{
+			case SimdLevel::AVX2:
+				return "AVX2";
+			case SimdLevel::SSE2:
+				return "SSE2";
+			default:
+				return "scalar";
+			}
+		}
+
+		void computeTransforms(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count)
+		{
+			computeTransforms(detectSimdLevel(), rotations, scales, outTransforms, count);
+		}
+
+		void computeTransforms(
+			SimdLevel level,
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count)
+		{
+#if defined(SANDBOX_TRANSFORM_KERNEL_X86)
+			if (level == SimdLevel::AVX2 && detectSimdLevel() == SimdLevel::AVX2)
+			{
+				computeTransformsAVX2(rotations, scales, outTransforms, count);
+				return;
+			}
+			if (level != SimdLevel::Scalar)
+			{
+				computeTransformsSSE2(rotations, scales, outTransforms, count);
+				return;
+			}
+#endif
+			computeTransformsReference(rotations, scales, outTransforms, count);
+		}
+
+		void computeTransformsReference(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const float s = std::sin(rotations[i]);
+				const float c = std::cos(rotations[i]);
+
+				float* out = reinterpret_cast<float*>(&outTransforms[i]);
+				out[0] = c * scales[i].x;
+				out[1] = s * scales[i].x;
+				out[2] = -s * scales[i].y;
+				out[3] = c * scales[i].y;
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace VulkanSandbox {
+
+	// Batch evaluation of Transform2DComponent::mat2() (rotation * scale) over contiguous component arrays,
+	// as stored by SandboxScene. Picks the widest instruction set the CPU supports at runtime.
+	namespace TransformKernel {
+
+		enum class SimdLevel {
+			Scalar,
+			SSE2,
+			AVX2
+		};
+
+		// Widest level supported by both this build and the CPU/OS it's running on
+		SimdLevel detectSimdLevel();
+		const char* simdLevelName(SimdLevel level);
+
+		// outTransforms[i] = rotate(rotations[i]) * scale(scales[i]). SSE2 and AVX2 use the sinCos(..) approximation
+		// below and produce bit-identical results (same operations in the same order, no FMA). Scalar goes through
+		// computeTransformsReference(..) instead: one object at a time the polynomial is slower than std::sin/cos
+		// (about 0.8x in the benchmark), it only pays off several lanes wide.
+		void computeTransforms(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count);
+		void computeTransforms(
+			SimdLevel level,
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count);
+
+		// The original per-object path (std::sin/std::cos), kept as the accuracy/speed reference
+		void computeTransformsReference(
+			const float* rotations,
+			const glm::vec2* scales,
+			glm::mat2* outTransforms,
+			size_t count);
+
+		// Polynomial sin/cos: the angle is reduced to [-pi/4, pi/4] by a multiple of pi/2 (three part Cody-Waite
+		// reduction), then evaluated with Cephes' minimax polynomials. Measured absolute error against double
+		// precision sin/cos (see benchmarks/TransformKernelBenchmark.cpp): below 1e-7 for |radians| <= 8192 and
+		// 1e-6 for |radians| <= 65536, past that the reduction runs out of precision, so keep angles reasonable.
+		void sinCos(float radians, float& outSin, float& outCos);
+
+	}
+
+}
@@ -4,20 +4,40 @@
 
 namespace VulkanSandbox
 {
-	SandboxWindow::SandboxWindow(int windowWidth, int windowHeight, std::string name)
-		: width(windowWidth), height(windowHeight), windowName(name)
+	SandboxWindow::SandboxWindow(int windowWidth, int windowHeight, std::string name, bool headless)
+		: width(windowWidth), height(windowHeight), windowName(name), headless(headless)
 	{ 
-		InitWindow();
+		// No display (or GLFW at all) is required when rendering headless
+		if (!headless)
+			InitWindow();
 	}
 
 	SandboxWindow::~SandboxWindow()
 	{
+		if (headless)
+			return;
+
 		glfwDestroyWindow(window);
 		glfwTerminate();
 	}
 
+	void SandboxWindow::pollEvents()
+	{
+		if (!headless)
+			glfwPollEvents();
+	}
+
+	void SandboxWindow::waitEvents()
+	{
+		if (!headless)
+			glfwWaitEvents();
+	}
+
 	void SandboxWindow::createWindowSurface(VkInstance vulkanInstance, VkSurfaceKHR* vulkanSurface)
 	{
+		if (headless)
+			throw std::runtime_error("Cannot create a window surface for a headless window!");
+
 		if (glfwCreateWindowSurface(vulkanInstance, window, nullptr, vulkanSurface) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create a window surface!");
 	}
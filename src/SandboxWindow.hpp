@@ -9,7 +9,7 @@ namespace VulkanSandbox {
 	class SandboxWindow {
 
 	public:
-		SandboxWindow(int windowWidth, int windowHeight, std::string name);
+		SandboxWindow(int windowWidth, int windowHeight, std::string name, bool headless = false);
 		~SandboxWindow();
 
 		// To maintain RAII, don't want to be able to copy a SandboxWindow, since then we will have two pointers to the  
@@ -18,9 +18,13 @@ namespace VulkanSandbox {
 		SandboxWindow& operator=(const SandboxWindow&) = delete;
 
 		VkExtent2D getExtent() { return VkExtent2D{ static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
-		bool shouldClose() { return glfwWindowShouldClose(window); }
+		bool shouldClose() { return !headless && glfwWindowShouldClose(window); }
 		bool wasResized() { return framebufferSizeChanged; }
 		void resetSizeChangedFlag() { framebufferSizeChanged = false; }
+		// Headless windows never open a GLFW window, they only carry the extent to render offscreen at
+		bool isHeadless() { return headless; }
+		void pollEvents();
+		void waitEvents();
 
 		void createWindowSurface(VkInstance vulkanInstance, VkSurfaceKHR* vulkanSurface);
 
@@ -29,8 +33,9 @@ namespace VulkanSandbox {
 		int height;
 		std::string windowName;
 		bool framebufferSizeChanged = false;
+		bool headless;
 
-		GLFWwindow* window; 
+		GLFWwindow* window = nullptr;
 
 		void InitWindow();
 		static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
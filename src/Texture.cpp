@@ -0,0 +1,393 @@
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	static constexpr VkFormatFeatureFlags MIPMAP_BLIT_FEATURES =
+		VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	// Skips whitespace and # comments between PPM header fields
+	static uint32_t readPpmHeaderValue(const std::vector<uint8_t>& data, size_t& position)
+	{
+		while (position < data.size())
+		{
+			if (data[position] == '#')
+			{
+				while (position < data.size() && data[position] != '\n')
+					position++;
+			}
+			else if (std::isspace(data[position]))
+				position++;
+			else
+				break;
+		}
+
+		uint32_t value = 0;
+		bool hasDigits = false;
+		while (position < data.size() && data[position] >= '0' && data[position] <= '9')
+		{
+			value = value * 10 + (data[position++] - '0');
+			hasDigits = true;
+		}
+		if (!hasDigits)
+			throw std::runtime_error("Malformed PPM header!");
+		return value;
+	}
+
+	static Texture::ImageData decodePpm(const std::vector<uint8_t>& data)
+	{
+		size_t position = 2; // past "P6"
+		Texture::ImageData image;
+		image.width = readPpmHeaderValue(data, position);
+		image.height = readPpmHeaderValue(data, position);
+		uint32_t maxValue = readPpmHeaderValue(data, position);
+		position++; // the single whitespace character before the pixel data
+
+		if (maxValue != 255)
+			throw std::runtime_error("Only 8 bit PPM images are supported!");
+		if (data.size() < position + size_t{ image.width } * image.height * 3)
+			throw std::runtime_error("PPM image is truncated!");
+
+		image.pixels.resize(size_t{ image.width } * image.height * 4);
+		for (size_t i = 0; i < size_t{ image.width } * image.height; i++)
+		{
+			image.pixels[i * 4 + 0] = data[position + i * 3 + 0];
+			image.pixels[i * 4 + 1] = data[position + i * 3 + 1];
+			image.pixels[i * 4 + 2] = data[position + i * 3 + 2];
+			image.pixels[i * 4 + 3] = 255;
+		}
+		return image;
+	}
+
+	static Texture::ImageData decodeTga(const std::vector<uint8_t>& data)
+	{
+		constexpr size_t HEADER_SIZE = 18;
+		if (data.size() < HEADER_SIZE)
+			throw std::runtime_error("TGA image is truncated!");
+
+		const uint8_t idLength = data[0];
+		const uint8_t colourMapType = data[1];
+		const uint8_t imageType = data[2];
+		const uint8_t bitsPerPixel = data[16];
+		const bool topToBottom = (data[17] & 0x20) != 0;
+
+		// Type 2 is uncompressed true colour, RLE/colour mapped images aren't worth the decoder here
+		if (imageType != 2 || colourMapType != 0 || (bitsPerPixel != 24 && bitsPerPixel != 32))
+			throw std::runtime_error("Only uncompressed 24/32 bit TGA images are supported!");
+
+		Texture::ImageData image;
+		image.width = data[12] | (data[13] << 8);
+		image.height = data[14] | (data[15] << 8);
+
+		const size_t bytesPerPixel = bitsPerPixel / 8;
+		const size_t position = HEADER_SIZE + idLength;
+		if (data.size() < position + size_t{ image.width } * image.height * bytesPerPixel)
+			throw std::runtime_error("TGA image is truncated!");
+
+		// Pixels are stored BGR(A), bottom row first unless the descriptor says otherwise
+		image.pixels.resize(size_t{ image.width } * image.height * 4);
+		for (uint32_t y = 0; y < image.height; y++)
+		{
+			const uint32_t sourceRow = topToBottom ? y : image.height - 1 - y;
+			for (uint32_t x = 0; x < image.width; x++)
+			{
+				const uint8_t* source = &data[position + (size_t{ sourceRow } * image.width + x) * bytesPerPixel];
+				uint8_t* destination = &image.pixels[(size_t{ y } * image.width + x) * 4];
+				destination[0] = source[2];
+				destination[1] = source[1];
+				destination[2] = source[0];
+				destination[3] = bytesPerPixel == 4 ? source[3] : 255;
+			}
+		}
+		return image;
+	}
+
+	Texture::ImageData Texture::loadImageFile(const std::string& filepath)
+	{
+		std::ifstream file{ filepath, std::ios::binary };
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open image file: " + filepath);
+
+		std::vector<uint8_t> data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+		ImageData image;
+		if (data.size() >= 2 && data[0] == 'P' && data[1] == '6')
+			image = decodePpm(data);
+		else if (filepath.size() >= 4 && filepath.compare(filepath.size() - 4, 4, ".tga") == 0)
+			image = decodeTga(data);
+		else
+			throw std::runtime_error("Unsupported image format (expected binary .ppm or .tga): " + filepath);
+
+		if (image.width == 0 || image.height == 0)
+			throw std::runtime_error("Image has no pixels: " + filepath);
+		return image;
+	}
+
+	Texture::ImageData Texture::createCheckerboard(uint32_t size, uint32_t squares, glm::vec4 colourA, glm::vec4 colourB)
+	{
+		assert(size > 0 && squares > 0 && "Checkerboard needs at least one pixel and one square!");
+
+		auto toBytes = [](glm::vec4 colour, uint8_t* destination) {
+			destination[0] = static_cast<uint8_t>(std::clamp(colour.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+			destination[1] = static_cast<uint8_t>(std::clamp(colour.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+			destination[2] = static_cast<uint8_t>(std::clamp(colour.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+			destination[3] = static_cast<uint8_t>(std::clamp(colour.w, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+
+		ImageData image;
+		image.width = size;
+		image.height = size;
+		image.pixels.resize(size_t{ size } * size * 4);
+
+		const uint32_t squareSize = std::max(size / squares, 1u);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				bool useA = ((x / squareSize) + (y / squareSize)) % 2 == 0;
+				toBytes(useA ? colourA : colourB, &image.pixels[(size_t{ y } * size + x) * 4]);
+			}
+		}
+		return image;
+	}
+
+	Texture::UploadedImage Texture::createImage(
+		VulkanDevice& device,
+		uint32_t width,
+		uint32_t height,
+		bool generateMipmaps,
+		bool srgb)
+	{
+		UploadedImage uploaded{};
+		uploaded.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		uploaded.width = width;
+		uploaded.height = height;
+		uploaded.mipLevels = 1;
+
+		// A full chain halves down to 1x1, but only if the format can be blitted with linear filtering. 
+		// The spec requires that for RGBA8, this only guards against unusual drivers.
+		if (generateMipmaps && device.formatSupports(uploaded.format, VK_IMAGE_TILING_OPTIMAL, MIPMAP_BLIT_FEATURES))
+		{
+			uint32_t largestSide = std::max(width, height);
+			while (largestSide > 1)
+			{
+				largestSide /= 2;
+				uploaded.mipLevels++;
+			}
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = uploaded.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = uploaded.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Every mip level is both a blit destination (from the level above) and source (for the level below)
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		// Exclusive even when streamed through a transfer queue, ownership is handed over with barriers instead
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, uploaded.image, uploaded.allocation);
+		return uploaded;
+	}
+
+	Texture::Texture(
+		VulkanDevice& device,
+		VulkanSamplerCache& samplerCache,
+		const ImageData& imageData,
+		bool generateMipmaps,
+		bool srgb)
+		: vulkanDevice(device), width(imageData.width), height(imageData.height)
+	{
+		assert(imageData.pixels.size() == size_t{ width } * height * 4 && "Texture image data must be tightly packed RGBA8!");
+
+		UploadedImage uploaded = createImage(vulkanDevice, width, height, generateMipmaps, srgb);
+		uploadAndGenerateMipmaps(uploaded, imageData);
+		adopt(uploaded, samplerCache);
+	}
+
+	Texture::Texture(VulkanDevice& device, VulkanSamplerCache& samplerCache, const UploadedImage& uploaded)
+		: vulkanDevice(device), width(uploaded.width), height(uploaded.height)
+	{
+		adopt(uploaded, samplerCache);
+	}
+
+	Texture::~Texture()
+	{
+		vkDestroyImageView(vulkanDevice.device(), imageView, nullptr);
+		vulkanDevice.destroyImage(image, imageAllocation);
+	}
+
+	VkDescriptorImageInfo Texture::getDescriptorInfo() const
+	{
+		return VkDescriptorImageInfo{ sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	}
+
+	void Texture::adopt(const UploadedImage& uploaded, VulkanSamplerCache& samplerCache)
+	{
+		image = uploaded.image;
+		imageAllocation = uploaded.allocation;
+		mipLevels = uploaded.mipLevels;
+		createImageView(uploaded.format);
+		sampler = samplerCache.getSampler(samplerCache.defaultSamplerInfo(mipLevels));
+	}
+
+	void Texture::uploadAndGenerateMipmaps(const UploadedImage& uploaded, const ImageData& imageData)
+	{
+		const VkDeviceSize imageSize = imageData.pixels.size();
+
+		VkBuffer stagingBuffer;
+		VulkanAllocation stagingAllocation;
+		vulkanDevice.createBuffer(
+			imageSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			stagingAllocation);
+		memcpy(stagingAllocation.mapped, imageData.pixels.data(), static_cast<size_t>(imageSize));
+
+		// Copy, blits and layout transitions all go in one submission
+		VkCommandBuffer commandBuffer = vulkanDevice.beginSingleTimeCommands();
+		recordUpload(commandBuffer, stagingBuffer, 0, uploaded);
+		recordMipmapGeneration(commandBuffer, uploaded);
+		vulkanDevice.endSingleTimeCommands(commandBuffer);
+
+		vulkanDevice.destroyBuffer(stagingBuffer, stagingAllocation);
+	}
+
+	void Texture::recordUpload(
+		VkCommandBuffer commandBuffer,
+		VkBuffer stagingBuffer,
+		VkDeviceSize stagingOffset,
+		const UploadedImage& uploaded)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = uploaded.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		// Whole chain: undefined -> transfer dst, ready for the copy into level 0 and the blits into the rest
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = uploaded.mipLevels;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { uploaded.width, uploaded.height, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, uploaded.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	void Texture::recordMipmapGeneration(VkCommandBuffer commandBuffer, const UploadedImage& uploaded)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = uploaded.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		// Each level is blitted down from the previous one, which first has to finish being written and
+		// move to transfer src. Once a level has been read from it's done, so it goes straight to shader read.
+		barrier.subresourceRange.levelCount = 1;
+		int32_t mipWidth = static_cast<int32_t>(uploaded.width);
+		int32_t mipHeight = static_cast<int32_t>(uploaded.height);
+		for (uint32_t level = 1; level < uploaded.mipLevels; level++)
+		{
+			barrier.subresourceRange.baseMipLevel = level - 1;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+
+			const int32_t nextWidth = std::max(mipWidth / 2, 1);
+			const int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+			VkImageBlit blit{};
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = level - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.srcOffsets[0] = { 0, 0, 0 };
+			blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+			blit.dstSubresource = blit.srcSubresource;
+			blit.dstSubresource.mipLevel = level;
+			blit.dstOffsets[0] = { 0, 0, 0 };
+			blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+			vkCmdBlitImage(commandBuffer,
+				uploaded.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				uploaded.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+
+		// The last level was only ever written to
+		barrier.subresourceRange.baseMipLevel = uploaded.mipLevels - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void Texture::createImageView(VkFormat format)
+	{
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(vulkanDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create texture image view!");
+	}
+
+}
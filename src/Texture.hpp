@@ -0,0 +1,94 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+#include "VulkanSamplerCache.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// A sampled 2D RGBA8 texture. The pixels are uploaded through a staging buffer and the rest of the mip chain
+	// is generated on the GPU by blitting each level down from the one above it, so distant/small objects sample
+	// small mips (far less memory bandwidth, no shimmering) instead of the full size image.
+	class Texture {
+
+	public:
+		// Tightly packed 8 bit RGBA, top row first
+		struct ImageData {
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<uint8_t> pixels;
+		};
+
+		// Binary PPM (P6) and uncompressed 24/32 bit TGA, neither needs an image library to decode
+		static ImageData loadImageFile(const std::string& filepath);
+		static ImageData createCheckerboard(uint32_t size, uint32_t squares, glm::vec4 colourA, glm::vec4 colourB);
+
+		// An image created by createImage(..) whose pixels are uploaded by recording recordUpload(..) and then
+		// recordMipmapGeneration(..), possibly on different queues (see VulkanAssetStreamer)
+		struct UploadedImage {
+			VkImage image = VK_NULL_HANDLE;
+			VulkanAllocation allocation;
+			VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 1;
+		};
+
+		// Device local image with room for the full mip chain (if generateMipmaps and the format can be blitted)
+		static UploadedImage createImage(VulkanDevice& device, uint32_t width, uint32_t height, bool generateMipmaps, bool srgb);
+		// Moves every level to transfer dst and copies the pixels at stagingOffset into level 0. Only needs a
+		// queue with transfer support.
+		static void recordUpload(
+			VkCommandBuffer commandBuffer,
+			VkBuffer stagingBuffer,
+			VkDeviceSize stagingOffset,
+			const UploadedImage& uploaded);
+		// Blits the rest of the chain down from level 0 and leaves every level in shader read layout. Blits need
+		// a graphics queue, all levels must be in transfer dst layout (ie. after recordUpload(..)).
+		static void recordMipmapGeneration(VkCommandBuffer commandBuffer, const UploadedImage& uploaded);
+
+		// The sampler comes from samplerCache, covering the whole mip chain. sRGB data is linearised when sampled.
+		Texture(
+			VulkanDevice& device,
+			VulkanSamplerCache& samplerCache,
+			const ImageData& image,
+			bool generateMipmaps = true,
+			bool srgb = true);
+		// Takes ownership of an image that has finished uploading (and is in shader read layout)
+		Texture(VulkanDevice& device, VulkanSamplerCache& samplerCache, const UploadedImage& uploaded);
+		~Texture();
+
+		Texture(const Texture&) = delete;
+		Texture& operator=(const Texture&) = delete;
+
+		VkImageView getImageView() const { return imageView; }
+		VkSampler getSampler() const { return sampler; }
+		uint32_t getMipLevels() const { return mipLevels; }
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+		VkDescriptorImageInfo getDescriptorInfo() const;
+
+	private:
+		void adopt(const UploadedImage& uploaded, VulkanSamplerCache& samplerCache);
+		void uploadAndGenerateMipmaps(const UploadedImage& uploaded, const ImageData& image);
+		void createImageView(VkFormat format);
+
+		VulkanDevice& vulkanDevice;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels = 1;
+
+		VkImage image = VK_NULL_HANDLE;
+		VulkanAllocation imageAllocation;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE; // owned by the sampler cache
+	};
+
+}
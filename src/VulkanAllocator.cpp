@@ -0,0 +1,289 @@
+#include "VulkanAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	VulkanAllocator::VulkanAllocator(
+		VkDevice device,
+		const VkPhysicalDeviceMemoryProperties& memoryProperties,
+		VkDeviceSize bufferImageGranularity,
+		VkDeviceSize blockSize)
+		: device{ device },
+		memoryProperties{ memoryProperties },
+		bufferImageGranularity{ bufferImageGranularity },
+		blockSize{ blockSize } {}
+
+	VulkanAllocator::~VulkanAllocator() {
+		// Every resource should have handed its allocation back by now, but the blocks
+		// themselves are only released here
+		for (auto& pool : pools) {
+			for (auto& block : pool.blocks) {
+				if (block.memory == VK_NULL_HANDLE) {
+					continue;
+				}
+				assert(block.allocationCount == 0 && "Device memory still in use when destroying the allocator");
+				if (block.mapped != nullptr) {
+					vkUnmapMemory(device, block.memory);
+				}
+				vkFreeMemory(device, block.memory, nullptr);
+			}
+		}
+	}
+
+	VulkanAllocation VulkanAllocator::allocate(
+		const VkMemoryRequirements& requirements,
+		VkMemoryPropertyFlags properties,
+		ResourceKind kind) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+		uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+		// Don't reserve huge blocks out of small heaps (e.g. the 256MB device local + host visible heap)
+		VkDeviceSize poolBlockSize = std::min(blockSize, memoryProperties.memoryHeaps[heapIndex].size / 8);
+
+		VulkanAllocation allocation{};
+		allocation.size = requirements.size;
+
+		// Big resources get their own VkDeviceMemory, they would only waste most of a block anyway
+		if (requirements.size > poolBlockSize / 2) {
+			void* mapped = nullptr;
+			allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &mapped);
+			allocation.mapped = mapped;
+			allocation.dedicated = true;
+			dedicatedAllocationCount++;
+			dedicatedBytes += requirements.size;
+			return allocation;
+		}
+
+		// Whenever linear and optimal resources are split into separate pools they can never end up on the
+		// same granularity page, so the resource's own alignment is all that is needed inside a block
+		uint32_t poolIndex = getPoolIndex(memoryTypeIndex, kind);
+		Pool& pool = pools[poolIndex];
+
+		for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+			Block& block = pool.blocks[i];
+			if (block.memory == VK_NULL_HANDLE) {
+				continue;
+			}
+
+			VkDeviceSize offset;
+			if (allocateFromBlock(block, requirements.size, requirements.alignment, offset)) {
+				allocation.memory = block.memory;
+				allocation.offset = offset;
+				allocation.mapped = block.mapped != nullptr ? block.mapped + offset : nullptr;
+				allocation.poolIndex = poolIndex;
+				allocation.blockIndex = i;
+				return allocation;
+			}
+		}
+
+		// No room in the existing blocks, reuse a released slot or add a new one
+		uint32_t blockIndex = 0;
+		while (blockIndex < pool.blocks.size() && pool.blocks[blockIndex].memory != VK_NULL_HANDLE) {
+			blockIndex++;
+		}
+		if (blockIndex == pool.blocks.size()) {
+			pool.blocks.emplace_back();
+		}
+
+		Block& block = pool.blocks[blockIndex];
+		void* mapped = nullptr;
+		block.memory = allocateDeviceMemory(poolBlockSize, memoryTypeIndex, &mapped);
+		block.mapped = static_cast<char*>(mapped);
+		block.size = poolBlockSize;
+		block.used = 0;
+		block.allocationCount = 0;
+		block.freeRanges.clear();
+		block.freeRanges[0] = poolBlockSize;
+
+		VkDeviceSize offset;
+		bool fits = allocateFromBlock(block, requirements.size, requirements.alignment, offset);
+		assert(fits && "Fresh block too small for a non-dedicated allocation");
+
+		allocation.memory = block.memory;
+		allocation.offset = offset;
+		allocation.mapped = block.mapped != nullptr ? block.mapped + offset : nullptr;
+		allocation.poolIndex = poolIndex;
+		allocation.blockIndex = blockIndex;
+		return allocation;
+	}
+
+	void VulkanAllocator::free(VulkanAllocation& allocation) {
+		if (allocation.memory == VK_NULL_HANDLE) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (allocation.dedicated) {
+			if (allocation.mapped != nullptr) {
+				vkUnmapMemory(device, allocation.memory);
+			}
+			vkFreeMemory(device, allocation.memory, nullptr);
+			dedicatedAllocationCount--;
+			dedicatedBytes -= allocation.size;
+		}
+		else {
+			Pool& pool = pools[allocation.poolIndex];
+			Block& block = pool.blocks[allocation.blockIndex];
+			assert(block.memory == allocation.memory && "Allocation freed to the wrong block");
+
+			freeToBlock(block, allocation.offset, allocation.size);
+
+			// Keep the first block of every pool around so a resize doesn't free and reallocate it,
+			// any other block goes back to the driver once it's empty
+			if (block.allocationCount == 0 && allocation.blockIndex != 0) {
+				if (block.mapped != nullptr) {
+					vkUnmapMemory(device, block.memory);
+				}
+				vkFreeMemory(device, block.memory, nullptr);
+				block = Block{};
+			}
+		}
+
+		allocation = VulkanAllocation{};
+	}
+
+	VulkanAllocator::Stats VulkanAllocator::getStats() {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		Stats stats{};
+		stats.bytesReserved = dedicatedBytes;
+		stats.bytesUsed = dedicatedBytes;
+		stats.deviceMemoryCount = dedicatedAllocationCount;
+		stats.allocationCount = dedicatedAllocationCount;
+
+		VkDeviceSize totalFree = 0;
+		VkDeviceSize largestFree = 0;
+		for (auto& pool : pools) {
+			for (auto& block : pool.blocks) {
+				if (block.memory == VK_NULL_HANDLE) {
+					continue;
+				}
+				stats.bytesReserved += block.size;
+				stats.bytesUsed += block.used;
+				stats.deviceMemoryCount++;
+				stats.allocationCount += block.allocationCount;
+
+				for (auto& range : block.freeRanges) {
+					totalFree += range.second;
+					largestFree = std::max(largestFree, range.second);
+				}
+			}
+		}
+
+		if (totalFree > 0) {
+			stats.fragmentation = 1.0 - static_cast<double>(largestFree) / static_cast<double>(totalFree);
+		}
+		return stats;
+	}
+
+	uint32_t VulkanAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("Failed to find suitable memory type!");
+	}
+
+	uint32_t VulkanAllocator::getPoolIndex(uint32_t memoryTypeIndex, ResourceKind kind) {
+		// With a granularity of 1 (most desktop AMD/Intel) there is nothing to separate
+		if (bufferImageGranularity <= 1) {
+			kind = ResourceKind::Linear;
+		}
+
+		for (uint32_t i = 0; i < pools.size(); i++) {
+			if (pools[i].memoryTypeIndex == memoryTypeIndex && pools[i].kind == kind) {
+				return i;
+			}
+		}
+
+		pools.push_back(Pool{ memoryTypeIndex, kind, {} });
+		return static_cast<uint32_t>(pools.size() - 1);
+	}
+
+	VkDeviceMemory VulkanAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped) {
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate device memory!");
+		}
+
+		// Host visible memory stays mapped for its whole lifetime, mapping is not free and
+		// sub-allocations can't map their own range of a shared block anyway
+		*mapped = nullptr;
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+				vkFreeMemory(device, memory, nullptr);
+				throw std::runtime_error("Failed to map device memory!");
+			}
+		}
+		return memory;
+	}
+
+	bool VulkanAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+		for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+			VkDeviceSize rangeStart = it->first;
+			VkDeviceSize rangeEnd = it->first + it->second;
+			VkDeviceSize alignedStart = alignUp(rangeStart, alignment);
+
+			if (alignedStart + size > rangeEnd) {
+				continue;
+			}
+
+			// Split the free range around the allocation, the alignment padding in front stays free
+			block.freeRanges.erase(it);
+			if (alignedStart > rangeStart) {
+				block.freeRanges[rangeStart] = alignedStart - rangeStart;
+			}
+			if (alignedStart + size < rangeEnd) {
+				block.freeRanges[alignedStart + size] = rangeEnd - (alignedStart + size);
+			}
+
+			block.used += size;
+			block.allocationCount++;
+			offset = alignedStart;
+			return true;
+		}
+		return false;
+	}
+
+	void VulkanAllocator::freeToBlock(Block& block, VkDeviceSize offset, VkDeviceSize size) {
+		auto it = block.freeRanges.emplace(offset, size).first;
+
+		// Merge with the free range after this one...
+		auto next = std::next(it);
+		if (next != block.freeRanges.end() && it->first + it->second == next->first) {
+			it->second += next->second;
+			block.freeRanges.erase(next);
+		}
+
+		// ...and the one before it
+		if (it != block.freeRanges.begin()) {
+			auto prev = std::prev(it);
+			if (prev->first + prev->second == it->first) {
+				prev->second += it->second;
+				block.freeRanges.erase(it);
+			}
+		}
+
+		block.used -= size;
+		block.allocationCount--;
+	}
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// A range of device memory handed out by VulkanAllocator. Bind resources with memory + offset,
+	// and write through mapped (non-null for host visible memory types, which are kept persistently mapped).
+	struct VulkanAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+
+		// Where the allocation came from, used by VulkanAllocator::free(..)
+		uint32_t poolIndex = ~0u;
+		uint32_t blockIndex = ~0u;
+		bool dedicated = false;
+	};
+
+	// Grabs large VkDeviceMemory blocks per memory type and sub-allocates resources out of them with a
+	// free-list (first fit, neighbouring free ranges are merged back together on free), instead of calling
+	// vkAllocateMemory per resource and running into maxMemoryAllocationCount.
+	class VulkanAllocator {
+
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+		// Linear resources (buffers, linear images) and optimal tiling images may not share a
+		// bufferImageGranularity sized page, so when the device's granularity is bigger than the usual
+		// alignments they are sub-allocated from separate blocks instead
+		enum class ResourceKind {
+			Linear,
+			Optimal
+		};
+
+		struct Stats {
+			VkDeviceSize bytesReserved = 0;		// total size of all VkDeviceMemory objects
+			VkDeviceSize bytesUsed = 0;			// sum of live allocation sizes
+			uint32_t deviceMemoryCount = 0;		// number of vkAllocateMemory calls currently live
+			uint32_t allocationCount = 0;
+			double fragmentation = 0.0;			// 1 - largest free range / total free bytes, 0 is best
+		};
+
+		VulkanAllocator(
+			VkDevice device,
+			const VkPhysicalDeviceMemoryProperties& memoryProperties,
+			VkDeviceSize bufferImageGranularity,
+			VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+		~VulkanAllocator();
+
+		VulkanAllocator(const VulkanAllocator&) = delete;
+		VulkanAllocator& operator=(const VulkanAllocator&) = delete;
+
+		VulkanAllocation allocate(
+			const VkMemoryRequirements& requirements,
+			VkMemoryPropertyFlags properties,
+			ResourceKind kind);
+		void free(VulkanAllocation& allocation);
+
+		Stats getStats();
+
+	private:
+		struct Block {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			VkDeviceSize used = 0;
+			char* mapped = nullptr;
+			uint32_t allocationCount = 0;
+			std::map<VkDeviceSize, VkDeviceSize> freeRanges; // offset -> size, sorted so neighbours can be merged
+		};
+
+		struct Pool {
+			uint32_t memoryTypeIndex;
+			ResourceKind kind;
+			std::vector<Block> blocks;
+		};
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		uint32_t getPoolIndex(uint32_t memoryTypeIndex, ResourceKind kind);
+		VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+		bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		void freeToBlock(Block& block, VkDeviceSize offset, VkDeviceSize size);
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize bufferImageGranularity;
+		VkDeviceSize blockSize;
+
+		std::vector<Pool> pools;
+		uint32_t dedicatedAllocationCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		std::mutex mutex;
+	};
+
+}
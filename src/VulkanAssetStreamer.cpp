@@ -0,0 +1,488 @@
+#include "VulkanAssetStreamer.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	VulkanAssetStreamer::VulkanAssetStreamer(VulkanDevice& device, VulkanSamplerCache& samplerCache)
+		: vulkanDevice(device), samplerCache(samplerCache)
+	{
+		QueueFamilyIndices queueFamilyIndices = vulkanDevice.findPhysicalQueueFamilies();
+		dedicatedTransfer = queueFamilyIndices.transferFamilyHasValue;
+		graphicsFamily = queueFamilyIndices.graphicsFamily;
+		transferFamily = dedicatedTransfer ? queueFamilyIndices.transferFamily : graphicsFamily;
+
+		graphicsCommandPool = createCommandPool(graphicsFamily);
+		graphicsCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+		if (dedicatedTransfer)
+		{
+			transferCommandPool = createCommandPool(transferFamily);
+			transferCommandBuffer = allocateCommandBuffer(transferCommandPool);
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(vulkanDevice.device(), &semaphoreInfo, nullptr, &transferFinished) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create asset streamer semaphore!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(vulkanDevice.device(), &fenceInfo, nullptr, &uploadFinished) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create asset streamer fence!");
+
+		worker = std::thread(&VulkanAssetStreamer::workerLoop, this);
+	}
+
+	VulkanAssetStreamer::~VulkanAssetStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		requestAvailable.notify_one();
+		worker.join();
+
+		// The worker always waits for its own fence, so nothing submitted from here is still running
+		vkDestroyFence(vulkanDevice.device(), uploadFinished, nullptr);
+		if (transferFinished != VK_NULL_HANDLE)
+			vkDestroySemaphore(vulkanDevice.device(), transferFinished, nullptr);
+		if (transferCommandPool != VK_NULL_HANDLE)
+			vkDestroyCommandPool(vulkanDevice.device(), transferCommandPool, nullptr);
+		vkDestroyCommandPool(vulkanDevice.device(), graphicsCommandPool, nullptr);
+	}
+
+	void VulkanAssetStreamer::streamModel(Model::Builder builder, ModelCallback onReady)
+	{
+		Request request;
+		request.builder = std::move(builder);
+		request.onModelReady = std::move(onReady);
+		queueRequest(std::move(request));
+	}
+
+	void VulkanAssetStreamer::streamTexture(
+		Texture::ImageData image,
+		TextureCallback onReady,
+		bool generateMipmaps,
+		bool srgb)
+	{
+		if (image.pixels.size() != size_t{ image.width } * image.height * 4)
+			throw std::runtime_error("Streamed texture image data must be tightly packed RGBA8!");
+
+		Request request;
+		request.image = std::move(image);
+		request.generateMipmaps = generateMipmaps;
+		request.srgb = srgb;
+		request.onTextureReady = std::move(onReady);
+		queueRequest(std::move(request));
+	}
+
+	void VulkanAssetStreamer::streamTextureFile(
+		const std::string& filepath,
+		TextureCallback onReady,
+		bool generateMipmaps,
+		bool srgb)
+	{
+		Request request;
+		request.imageFile = filepath;
+		request.generateMipmaps = generateMipmaps;
+		request.srgb = srgb;
+		request.onTextureReady = std::move(onReady);
+		queueRequest(std::move(request));
+	}
+
+	void VulkanAssetStreamer::queueRequest(Request request)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		requests.push_back(std::move(request));
+		pending++;
+		requestAvailable.notify_one();
+	}
+
+	uint32_t VulkanAssetStreamer::pollCompleted()
+	{
+		std::deque<Completion> ready;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			ready.swap(completed);
+			pending -= static_cast<uint32_t>(ready.size());
+		}
+
+		// Callbacks run without the lock held, so they're free to queue more uploads. A failed upload doesn't
+		// stop the ones after it from being handed over, the first error is only rethrown once they all have.
+		std::exception_ptr firstError;
+		for (Completion& completion : ready)
+		{
+			if (completion.error)
+			{
+				if (!firstError)
+					firstError = completion.error;
+				continue;
+			}
+
+			if (completion.onModelReady)
+				completion.onModelReady(std::move(completion.model));
+			else
+				completion.onTextureReady(std::move(completion.texture));
+		}
+
+		if (firstError)
+			std::rethrow_exception(firstError);
+		return static_cast<uint32_t>(ready.size());
+	}
+
+	uint32_t VulkanAssetStreamer::pendingCount()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return pending;
+	}
+
+	VulkanAssetStreamer::Stats VulkanAssetStreamer::getStats()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return stats;
+	}
+
+	void VulkanAssetStreamer::workerLoop()
+	{
+		std::unique_lock<std::mutex> lock{ mutex };
+		while (true)
+		{
+			requestAvailable.wait(lock, [this]() { return stopping || !requests.empty(); });
+			if (stopping)
+				return;
+
+			Request request = std::move(requests.front());
+			requests.pop_front();
+			lock.unlock();
+
+			Completion completion;
+			try
+			{
+				completion = upload(request);
+			}
+			catch (...)
+			{
+				completion.error = std::current_exception();
+			}
+
+			lock.lock();
+			completed.push_back(std::move(completion));
+		}
+	}
+
+	VulkanAssetStreamer::Completion VulkanAssetStreamer::upload(Request& request)
+	{
+		auto uploadStart = std::chrono::steady_clock::now();
+		const bool isTexture = static_cast<bool>(request.onTextureReady);
+
+		// Everything the request needs goes through one staging buffer: the pixels, or the vertices followed
+		// by the indices (narrowed to 16 bits when the vertex count allows it, same as Model does)
+		UploadResources resources{ vulkanDevice };
+		Model::UploadedBuffers& buffers = resources.buffers;
+		Texture::UploadedImage& image = resources.image;
+		std::vector<uint16_t> shortIndices;
+		VkDeviceSize vertexBytes = 0;
+		VkDeviceSize indexBytes = 0;
+		const void* indexData = nullptr;
+		if (isTexture)
+		{
+			if (!request.imageFile.empty())
+				request.image = Texture::loadImageFile(request.imageFile);
+			image = Texture::createImage(vulkanDevice, request.image.width, request.image.height, request.generateMipmaps, request.srgb);
+		}
+		else
+		{
+			const std::vector<Model::Vertex>& vertices = request.builder.vertices;
+			const std::vector<uint32_t>& indices = request.builder.indices;
+			if (vertices.size() < 3)
+				throw std::runtime_error("Streamed model needs at least one triangle!");
+
+			buffers.vertexCount = static_cast<uint32_t>(vertices.size());
+			buffers.indexCount = static_cast<uint32_t>(indices.size());
+			buffers.indexType = Model::indexTypeFor(buffers.vertexCount);
+			buffers.bounds = Model::Bounds::fromVertices(vertices.data(), vertices.size());
+			vertexBytes = vertices.size() * sizeof(Model::Vertex);
+			indexData = indices.data();
+			indexBytes = indices.size() * sizeof(uint32_t);
+			if (buffers.indexType == VK_INDEX_TYPE_UINT16)
+			{
+				shortIndices.assign(indices.begin(), indices.end());
+				indexData = shortIndices.data();
+				indexBytes = shortIndices.size() * sizeof(uint16_t);
+			}
+
+			vulkanDevice.createBuffer(
+				vertexBytes,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				buffers.vertexBuffer,
+				buffers.vertexAllocation);
+			if (indexBytes > 0)
+			{
+				vulkanDevice.createBuffer(
+					indexBytes,
+					VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					buffers.indexBuffer,
+					buffers.indexAllocation);
+			}
+		}
+
+		const VkDeviceSize stagingSize = isTexture ? request.image.pixels.size() : vertexBytes + indexBytes;
+		VkBuffer& stagingBuffer = resources.stagingBuffer;
+		VulkanAllocation& stagingAllocation = resources.stagingAllocation;
+		vulkanDevice.createBuffer(
+			stagingSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			stagingAllocation);
+
+		char* staging = static_cast<char*>(stagingAllocation.mapped);
+		if (isTexture)
+		{
+			memcpy(staging, request.image.pixels.data(), static_cast<size_t>(stagingSize));
+		}
+		else
+		{
+			memcpy(staging, request.builder.vertices.data(), static_cast<size_t>(vertexBytes));
+			if (indexBytes > 0)
+				memcpy(staging + vertexBytes, indexData, static_cast<size_t>(indexBytes));
+		}
+
+		// The previous upload's fence has been waited on, so both buffers can simply be recorded again
+		vkResetCommandPool(vulkanDevice.device(), graphicsCommandPool, 0);
+		if (dedicatedTransfer)
+			vkResetCommandPool(vulkanDevice.device(), transferCommandPool, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VkCommandBuffer graphicsCommands = graphicsCommandBuffer;
+		VkCommandBuffer transferCommands = dedicatedTransfer ? transferCommandBuffer : graphicsCommandBuffer;
+		vkBeginCommandBuffer(graphicsCommands, &beginInfo);
+		if (dedicatedTransfer)
+			vkBeginCommandBuffer(transferCommands, &beginInfo);
+
+		if (isTexture)
+			recordTextureUpload(transferCommands, graphicsCommands, stagingBuffer, image);
+		else
+			recordModelUpload(transferCommands, graphicsCommands, stagingBuffer, buffers);
+
+		if (dedicatedTransfer)
+			vkEndCommandBuffer(transferCommands);
+		vkEndCommandBuffer(graphicsCommands);
+
+		submitAndWait(transferCommands, graphicsCommands);
+		vulkanDevice.destroyBuffer(stagingBuffer, stagingAllocation);
+
+		Completion completion;
+		if (isTexture)
+		{
+			completion.texture = std::make_unique<Texture>(vulkanDevice, samplerCache, image);
+			image = Texture::UploadedImage{};	// the texture owns it now
+			completion.onTextureReady = std::move(request.onTextureReady);
+		}
+		else
+		{
+			completion.model = std::make_unique<Model>(vulkanDevice, buffers);
+			buffers = Model::UploadedBuffers{};	// the model owns them now
+			completion.onModelReady = std::move(request.onModelReady);
+		}
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (isTexture)
+			stats.texturesStreamed++;
+		else
+			stats.modelsStreamed++;
+		stats.bytesUploaded += stagingSize;
+		stats.uploadMilliseconds += milliseconds;
+		return completion;
+	}
+
+	VulkanAssetStreamer::UploadResources::~UploadResources()
+	{
+		// Only reached with something left over when the upload threw, in which case it was either never
+		// submitted or submitAndWait(..) has made sure the GPU is done with it
+		if (buffers.vertexBuffer != VK_NULL_HANDLE)
+			device.destroyBuffer(buffers.vertexBuffer, buffers.vertexAllocation);
+		if (buffers.indexBuffer != VK_NULL_HANDLE)
+			device.destroyBuffer(buffers.indexBuffer, buffers.indexAllocation);
+		if (image.image != VK_NULL_HANDLE)
+			device.destroyImage(image.image, image.allocation);
+		if (stagingBuffer != VK_NULL_HANDLE)
+			device.destroyBuffer(stagingBuffer, stagingAllocation);
+	}
+
+	void VulkanAssetStreamer::recordModelUpload(
+		VkCommandBuffer transferCommands,
+		VkCommandBuffer graphicsCommands,
+		VkBuffer stagingBuffer,
+		const Model::UploadedBuffers& buffers)
+	{
+		const VkDeviceSize vertexBytes = buffers.vertexCount * sizeof(Model::Vertex);
+		const VkDeviceSize indexBytes = buffers.indexCount * (buffers.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+
+		VkBufferCopy vertexCopy{ 0, 0, vertexBytes };
+		vkCmdCopyBuffer(transferCommands, stagingBuffer, buffers.vertexBuffer, 1, &vertexCopy);
+		if (buffers.indexBuffer != VK_NULL_HANDLE)
+		{
+			VkBufferCopy indexCopy{ vertexBytes, 0, indexBytes };
+			vkCmdCopyBuffer(transferCommands, stagingBuffer, buffers.indexBuffer, 1, &indexCopy);
+		}
+
+		std::vector<VkBufferMemoryBarrier> barriers;
+		auto addBarrier = [&](VkBuffer buffer, VkAccessFlags dstAccess) {
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = dedicatedTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = dedicatedTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			barriers.push_back(barrier);
+		};
+		addBarrier(buffers.vertexBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		if (buffers.indexBuffer != VK_NULL_HANDLE)
+			addBarrier(buffers.indexBuffer, VK_ACCESS_INDEX_READ_BIT);
+
+		if (!dedicatedTransfer)
+		{
+			vkCmdPipelineBarrier(graphicsCommands,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+				0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+			return;
+		}
+
+		// Release on the transfer queue then acquire on the graphics queue: the same barrier recorded on both
+		// sides, the release only keeps the source access and the acquire only the destination access
+		std::vector<VkBufferMemoryBarrier> acquireBarriers = barriers;
+		for (VkBufferMemoryBarrier& barrier : barriers)
+			barrier.dstAccessMask = 0;
+		for (VkBufferMemoryBarrier& barrier : acquireBarriers)
+			barrier.srcAccessMask = 0;
+
+		vkCmdPipelineBarrier(transferCommands,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+		vkCmdPipelineBarrier(graphicsCommands,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(acquireBarriers.size()), acquireBarriers.data(), 0, nullptr);
+	}
+
+	void VulkanAssetStreamer::recordTextureUpload(
+		VkCommandBuffer transferCommands,
+		VkCommandBuffer graphicsCommands,
+		VkBuffer stagingBuffer,
+		const Texture::UploadedImage& image)
+	{
+		Texture::recordUpload(transferCommands, stagingBuffer, 0, image);
+
+		if (dedicatedTransfer)
+		{
+			// Every level changes queue family but stays in transfer dst, ready for the blits
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			barrier.image = image.image;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = image.mipLevels;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier(transferCommands,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(graphicsCommands,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		Texture::recordMipmapGeneration(graphicsCommands, image);
+	}
+
+	void VulkanAssetStreamer::submitAndWait(VkCommandBuffer transferCommands, VkCommandBuffer graphicsCommands)
+	{
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo transferSubmit{};
+		transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmit.commandBufferCount = 1;
+		transferSubmit.pCommandBuffers = &transferCommands;
+		transferSubmit.signalSemaphoreCount = 1;
+		transferSubmit.pSignalSemaphores = &transferFinished;
+
+		VkSubmitInfo graphicsSubmit{};
+		graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		graphicsSubmit.commandBufferCount = 1;
+		graphicsSubmit.pCommandBuffers = &graphicsCommands;
+		if (dedicatedTransfer)
+		{
+			// The acquire barriers (and blits) must not start before the copies on the other queue are done
+			graphicsSubmit.waitSemaphoreCount = 1;
+			graphicsSubmit.pWaitSemaphores = &transferFinished;
+			graphicsSubmit.pWaitDstStageMask = &waitStage;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ vulkanDevice.queueMutex() };
+			if (dedicatedTransfer && vkQueueSubmit(vulkanDevice.transferQueue(), 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit asset upload to the transfer queue!");
+			if (vkQueueSubmit(vulkanDevice.graphicsQueue(), 1, &graphicsSubmit, uploadFinished) != VK_SUCCESS)
+			{
+				// The copies may already be running on the transfer queue, let them finish before the caller
+				// destroys the buffers they read from and write to
+				if (dedicatedTransfer)
+					vkQueueWaitIdle(vulkanDevice.transferQueue());
+				throw std::runtime_error("Failed to submit asset upload to the graphics queue!");
+			}
+		}
+
+		// Waiting on a fence doesn't touch the queues, so rendering carries on submitting meanwhile
+		vkWaitForFences(vulkanDevice.device(), 1, &uploadFinished, VK_TRUE, UINT64_MAX);
+		vkResetFences(vulkanDevice.device(), 1, &uploadFinished);
+	}
+
+	VkCommandPool VulkanAssetStreamer::createCommandPool(uint32_t queueFamily)
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // re-recorded for every upload, reset as a whole
+
+		VkCommandPool commandPool;
+		if (vkCreateCommandPool(vulkanDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create asset streamer command pool!");
+		return commandPool;
+	}
+
+	VkCommandBuffer VulkanAssetStreamer::allocateCommandBuffer(VkCommandPool commandPool)
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate asset streamer command buffer!");
+		return commandBuffer;
+	}
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Model.hpp"
+#include "Texture.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanSamplerCache.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace VulkanSandbox {
+
+	// Uploads models and textures on a worker thread so loading never stalls the frame loop. Copies go through
+	// the GPU's dedicated transfer queue when it has one (the copy engine runs alongside rendering), with queue
+	// family ownership handed over to the graphics queue afterwards, since mip generation needs blits and
+	// the renderer reads the resources there. Without one everything is submitted to the graphics queue.
+	// Finished assets are handed to their callbacks by pollCompleted(), on whichever thread calls it.
+	class VulkanAssetStreamer {
+
+	public:
+		using ModelCallback = std::function<void(std::unique_ptr<Model> model)>;
+		using TextureCallback = std::function<void(std::unique_ptr<Texture> texture)>;
+
+		struct Stats {
+			uint64_t modelsStreamed = 0;
+			uint64_t texturesStreamed = 0;
+			uint64_t bytesUploaded = 0;
+			double uploadMilliseconds = 0.0;	// worker time from picking up a request to its fence signalling
+		};
+
+		VulkanAssetStreamer(VulkanDevice& device, VulkanSamplerCache& samplerCache);
+		// Finishes the upload in progress, requests that haven't started yet are dropped
+		~VulkanAssetStreamer();
+
+		VulkanAssetStreamer(const VulkanAssetStreamer&) = delete;
+		VulkanAssetStreamer& operator=(const VulkanAssetStreamer&) = delete;
+
+		// Queues an upload, onReady is called from pollCompleted() once the GPU copy has finished
+		void streamModel(Model::Builder builder, ModelCallback onReady);
+		void streamTexture(
+			Texture::ImageData image,
+			TextureCallback onReady,
+			bool generateMipmaps = true,
+			bool srgb = true);
+		// Same as streamTexture(..), but the file is also read and decoded on the worker thread
+		void streamTextureFile(
+			const std::string& filepath,
+			TextureCallback onReady,
+			bool generateMipmaps = true,
+			bool srgb = true);
+
+		// Hands finished assets to their callbacks and returns how many there were. If an upload failed its
+		// exception is rethrown here instead of being lost on the worker thread.
+		uint32_t pollCompleted();
+		// Requests whose callback hasn't been called yet
+		uint32_t pendingCount();
+		bool usesDedicatedTransferQueue() const { return dedicatedTransfer; }
+		Stats getStats();
+
+	private:
+		struct Request {
+			Model::Builder builder;
+			ModelCallback onModelReady;
+			Texture::ImageData image;
+			std::string imageFile;	// decoded into image first when set
+			bool generateMipmaps = true;
+			bool srgb = true;
+			TextureCallback onTextureReady;
+		};
+
+		struct Completion {
+			std::unique_ptr<Model> model;
+			ModelCallback onModelReady;
+			std::unique_ptr<Texture> texture;
+			TextureCallback onTextureReady;
+			std::exception_ptr error;
+		};
+
+		// What upload(..) has created so far. Whatever hasn't been handed over to a Model or Texture (or, for
+		// the staging buffer, destroyed) by the time it goes out of scope is destroyed with it, so an upload
+		// that throws part way through doesn't leak its buffers or image.
+		struct UploadResources {
+			explicit UploadResources(VulkanDevice& device) : device(device) {}
+			~UploadResources();
+
+			UploadResources(const UploadResources&) = delete;
+			UploadResources& operator=(const UploadResources&) = delete;
+
+			VulkanDevice& device;
+			Model::UploadedBuffers buffers{};
+			Texture::UploadedImage image{};
+			VkBuffer stagingBuffer = VK_NULL_HANDLE;
+			VulkanAllocation stagingAllocation;
+		};
+
+		void queueRequest(Request request);
+		void workerLoop();
+		Completion upload(Request& request);
+		// Records the copies into transferCommands and everything after them into graphicsCommands (the same
+		// buffer without a dedicated transfer queue)
+		void recordModelUpload(
+			VkCommandBuffer transferCommands,
+			VkCommandBuffer graphicsCommands,
+			VkBuffer stagingBuffer,
+			const Model::UploadedBuffers& buffers);
+		void recordTextureUpload(
+			VkCommandBuffer transferCommands,
+			VkCommandBuffer graphicsCommands,
+			VkBuffer stagingBuffer,
+			const Texture::UploadedImage& image);
+		void submitAndWait(VkCommandBuffer transferCommands, VkCommandBuffer graphicsCommands);
+
+		VkCommandPool createCommandPool(uint32_t queueFamily);
+		VkCommandBuffer allocateCommandBuffer(VkCommandPool commandPool);
+
+		VulkanDevice& vulkanDevice;
+		VulkanSamplerCache& samplerCache;
+		bool dedicatedTransfer = false;
+		uint32_t graphicsFamily = 0;
+		uint32_t transferFamily = 0;
+
+		// Only the worker records and submits, so one buffer per queue family is reused for every upload
+		VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+		VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkSemaphore transferFinished = VK_NULL_HANDLE;	// transfer queue -> graphics queue, dedicated path only
+		VkFence uploadFinished = VK_NULL_HANDLE;
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable requestAvailable;
+		std::deque<Request> requests;
+		std::deque<Completion> completed;
+		uint32_t pending = 0;
+		Stats stats;
+		bool stopping = false;
+	};
+
+}
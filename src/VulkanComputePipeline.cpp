@@ -0,0 +1,53 @@
+#include "VulkanComputePipeline.hpp"
+#include "VulkanPipeline.hpp"
+
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	VulkanComputePipeline::VulkanComputePipeline(
+		VulkanDevice& vulkanDevice, 
+		const std::string& computeShaderFilepath, 
+		VkPipelineLayout pipelineLayout)
+		: vulkanDeviceRef(vulkanDevice)
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline -- missing pipelineLayout!");
+
+		std::vector<char> computeShaderSourceCode = VulkanPipeline::readFile(computeShaderFilepath);
+
+		VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+		shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shaderModuleCreateInfo.codeSize = computeShaderSourceCode.size();
+		shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(computeShaderSourceCode.data());
+		if (vkCreateShaderModule(vulkanDeviceRef.device(), &shaderModuleCreateInfo, nullptr, &computeShaderModule) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create shader module!");
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = computeShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		// Goes through the same pipeline cache as the graphics pipelines
+		if (vkCreateComputePipelines(vulkanDeviceRef.device(), vulkanDeviceRef.pipelineCache(), 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create a compute pipeline!");
+	}
+
+	VulkanComputePipeline::~VulkanComputePipeline()
+	{
+		vkDestroyShaderModule(vulkanDeviceRef.device(), computeShaderModule, nullptr);
+		vkDestroyPipeline(vulkanDeviceRef.device(), computePipeline, nullptr);
+	}
+
+	void VulkanComputePipeline::bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <string>
+
+namespace VulkanSandbox {
+
+	// The compute counterpart of VulkanPipeline: one compute shader stage plus the pipeline layout it runs with.
+	// The layout belongs to the caller, as it's also needed to bind descriptor sets and push constants.
+	class VulkanComputePipeline {
+
+	public:
+		VulkanComputePipeline(
+			VulkanDevice& vulkanDevice,
+			const std::string& computeShaderFilepath,
+			VkPipelineLayout pipelineLayout);
+		~VulkanComputePipeline();
+
+		VulkanComputePipeline(const VulkanComputePipeline&) = delete;
+		VulkanComputePipeline& operator=(const VulkanComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+		// Enough workgroups of groupSize invocations to cover invocationCount, the shader skips the excess
+		static uint32_t groupCount(uint32_t invocationCount, uint32_t groupSize) { return (invocationCount + groupSize - 1) / groupSize; }
+
+	private:
+		VulkanDevice& vulkanDeviceRef;
+		VkPipeline computePipeline = VK_NULL_HANDLE;
+		VkShaderModule computeShaderModule = VK_NULL_HANDLE;
+	};
+
+}
@@ -0,0 +1,355 @@
+#include "VulkanDescriptors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace VulkanSandbox {
+
+	////////////////////////////////////////////////////////////////////////////////////////
+	// VulkanDescriptorLayoutCache
+
+	VulkanDescriptorLayoutCache::VulkanDescriptorLayoutCache(VulkanDevice& device)
+		: vulkanDevice(device) {}
+
+	VulkanDescriptorLayoutCache::~VulkanDescriptorLayoutCache()
+	{
+		for (auto& layout : layouts)
+			vkDestroyDescriptorSetLayout(vulkanDevice.device(), layout.second, nullptr);
+	}
+
+	VkDescriptorSetLayout VulkanDescriptorLayoutCache::getLayout(
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<VkDescriptorBindingFlags>& bindingFlags,
+		VkDescriptorSetLayoutCreateFlags flags)
+	{
+		assert((bindingFlags.empty() || bindingFlags.size() == bindings.size()) && "One binding flag per binding!");
+
+		LayoutKey key{ flags, {} };
+		key.bindings.reserve(bindings.size());
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			assert(bindings[i].pImmutableSamplers == nullptr && "Immutable samplers aren't supported by the layout cache!");
+			key.bindings.push_back({
+				bindings[i].binding,
+				bindings[i].descriptorType,
+				bindings[i].descriptorCount,
+				bindings[i].stageFlags,
+				bindingFlags.empty() ? 0 : bindingFlags[i] });
+		}
+		std::sort(key.bindings.begin(), key.bindings.end(), 
+			[](const LayoutBinding& a, const LayoutBinding& b) { return a.binding < b.binding; });
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto cached = layouts.find(key);
+		if (cached != layouts.end())
+			return cached->second;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+		layoutInfo.flags = flags;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(vulkanDevice.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create descriptor set layout!");
+
+		layouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	size_t VulkanDescriptorLayoutCache::size() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return layouts.size();
+	}
+
+	size_t VulkanDescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+	{
+		size_t seed = 0;
+		auto combine = [&seed](size_t value) {
+			seed ^= std::hash<size_t>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		};
+		combine(key.flags);
+		for (const LayoutBinding& binding : key.bindings)
+		{
+			combine(binding.binding);
+			combine(static_cast<size_t>(binding.type));
+			combine(binding.count);
+			combine(binding.stages);
+			combine(binding.flags);
+		}
+		return seed;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////
+	// VulkanDescriptorAllocator
+
+	// Rough mix of descriptors per set in a pool, running out of any one type just moves on to the next pool
+	static constexpr std::array<std::pair<VkDescriptorType, float>, 5> POOL_DESCRIPTORS_PER_SET{ {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f }
+	} };
+
+	VulkanDescriptorAllocator::VulkanDescriptorAllocator(VulkanDevice& device, uint32_t setsPerPool)
+		: vulkanDevice(device), setsPerPool(setsPerPool) {}
+
+	VulkanDescriptorAllocator::~VulkanDescriptorAllocator()
+	{
+		for (VkDescriptorPool pool : usedPools)
+			vkDestroyDescriptorPool(vulkanDevice.device(), pool, nullptr);
+		for (VkDescriptorPool pool : freePools)
+			vkDestroyDescriptorPool(vulkanDevice.device(), pool, nullptr);
+	}
+
+	VkDescriptorSet VulkanDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		if (currentPool == VK_NULL_HANDLE)
+			currentPool = grabPool();
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = currentPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(vulkanDevice.device(), &allocInfo, &set);
+
+		// The current pool is full (or too fragmented), retry once with a fresh one
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			currentPool = grabPool();
+			allocInfo.descriptorPool = currentPool;
+			result = vkAllocateDescriptorSets(vulkanDevice.device(), &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate descriptor set!");
+
+		allocatedSetCount++;
+		return set;
+	}
+
+	void VulkanDescriptorAllocator::reset()
+	{
+		for (VkDescriptorPool pool : usedPools)
+		{
+			vkResetDescriptorPool(vulkanDevice.device(), pool, 0);
+			freePools.push_back(pool);
+		}
+		usedPools.clear();
+		currentPool = VK_NULL_HANDLE;
+		allocatedSetCount = 0;
+	}
+
+	VkDescriptorPool VulkanDescriptorAllocator::grabPool()
+	{
+		VkDescriptorPool pool;
+		if (!freePools.empty())
+		{
+			pool = freePools.back();
+			freePools.pop_back();
+		}
+		else
+		{
+			// Every new pool is bigger than the last, a frame that needs many sets only creates a few pools
+			pool = createPool(setsPerPool);
+			setsPerPool = std::min(setsPerPool + setsPerPool / 2, MAX_SETS_PER_POOL);
+		}
+
+		usedPools.push_back(pool);
+		return pool;
+	}
+
+	VkDescriptorPool VulkanDescriptorAllocator::createPool(uint32_t setCount)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const auto& descriptorsPerSet : POOL_DESCRIPTORS_PER_SET)
+			poolSizes.push_back({ descriptorsPerSet.first, static_cast<uint32_t>(descriptorsPerSet.second * setCount) });
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = 0; // sets are never freed individually, only the whole pool is reset
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(vulkanDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create descriptor pool!");
+		return pool;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////
+	// VulkanBindlessTable
+
+	VulkanBindlessTable::VulkanBindlessTable(
+		VulkanDevice& device,
+		VulkanDescriptorLayoutCache& layoutCache,
+		uint32_t maxBuffers,
+		uint32_t maxTextures)
+		: vulkanDevice(device)
+	{
+		if (!vulkanDevice.supportsDescriptorIndexing())
+			throw std::runtime_error("Bindless descriptors need VK_EXT_descriptor_indexing!");
+
+		buffers.capacity = maxBuffers;
+		textures.capacity = maxTextures;
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+		bindings[0].binding = STORAGE_BUFFER_BINDING;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = maxBuffers;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+		bindings[1].binding = TEXTURE_BINDING;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = maxTextures;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+		// Slots that were never written are fine as long as shaders don't read them (partially bound), and slots
+		// can be written while the set is bound and in use elsewhere (update after bind/unused while pending).
+		// Only the last binding may be variable sized, it's allocated at its full size anyway.
+		const VkDescriptorBindingFlags bindlessFlags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		std::vector<VkDescriptorBindingFlags> bindingFlags{
+			bindlessFlags,
+			bindlessFlags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+
+		layout = layoutCache.getLayout(bindings, bindingFlags, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{ {
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBuffers },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures }
+		} };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(vulkanDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create bindless descriptor pool!");
+
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+		variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+		variableCountInfo.descriptorSetCount = 1;
+		variableCountInfo.pDescriptorCounts = &maxTextures;
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = &variableCountInfo;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		if (vkAllocateDescriptorSets(vulkanDevice.device(), &allocInfo, &set) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate bindless descriptor set!");
+	}
+
+	VulkanBindlessTable::~VulkanBindlessTable()
+	{
+		// The layout belongs to the layout cache, destroying the pool frees the set
+		vkDestroyDescriptorPool(vulkanDevice.device(), pool, nullptr);
+	}
+
+	uint32_t VulkanBindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		uint32_t slot = buffers.acquire("buffer");
+		updateBuffer(slot, buffer, offset, range);
+		return slot;
+	}
+
+	uint32_t VulkanBindlessTable::addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		uint32_t slot = textures.acquire("texture");
+
+		VkDescriptorImageInfo imageInfo{ sampler, imageView, layout };
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = TEXTURE_BINDING;
+		write.dstArrayElement = slot;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(vulkanDevice.device(), 1, &write, 0, nullptr);
+		return slot;
+	}
+
+	void VulkanBindlessTable::updateBuffer(uint32_t slot, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		assert(slot < buffers.used && "Bindless buffer slot out of range!");
+
+		VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = STORAGE_BUFFER_BINDING;
+		write.dstArrayElement = slot;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(vulkanDevice.device(), 1, &write, 0, nullptr);
+	}
+
+	void VulkanBindlessTable::updateTexture(uint32_t slot, VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		assert(slot < textures.used && "Bindless texture slot out of range!");
+
+		VkDescriptorImageInfo imageInfo{ sampler, imageView, layout };
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = TEXTURE_BINDING;
+		write.dstArrayElement = slot;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(vulkanDevice.device(), 1, &write, 0, nullptr);
+	}
+
+	// Removed slots keep their old descriptor, which is fine since partially bound slots are never read
+	void VulkanBindlessTable::removeBuffer(uint32_t slot)
+	{
+		buffers.freeSlots.push_back(slot);
+	}
+
+	void VulkanBindlessTable::removeTexture(uint32_t slot)
+	{
+		textures.freeSlots.push_back(slot);
+	}
+
+	uint32_t VulkanBindlessTable::SlotList::acquire(const char* tableName)
+	{
+		if (!freeSlots.empty())
+		{
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+
+		if (used == capacity)
+			throw std::runtime_error(std::string("Bindless ") + tableName + " table is full!");
+		return used++;
+	}
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// Creates each distinct descriptor set layout once, keyed by a hash of its bindings, so that pipeline layouts
+	// and set allocations asking for "the same" layout get the same VkDescriptorSetLayout handle back
+	class VulkanDescriptorLayoutCache {
+
+	public:
+		explicit VulkanDescriptorLayoutCache(VulkanDevice& device);
+		~VulkanDescriptorLayoutCache();
+
+		VulkanDescriptorLayoutCache(const VulkanDescriptorLayoutCache&) = delete;
+		VulkanDescriptorLayoutCache& operator=(const VulkanDescriptorLayoutCache&) = delete;
+
+		// bindingFlags is either empty or has one entry per binding (VK_EXT_descriptor_indexing flags).
+		// Immutable samplers aren't supported, pImmutableSamplers must be null.
+		VkDescriptorSetLayout getLayout(
+			const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+			const std::vector<VkDescriptorBindingFlags>& bindingFlags = {},
+			VkDescriptorSetLayoutCreateFlags flags = 0);
+
+		size_t size() const;
+
+	private:
+		struct LayoutBinding {
+			uint32_t binding;
+			VkDescriptorType type;
+			uint32_t count;
+			VkShaderStageFlags stages;
+			VkDescriptorBindingFlags flags;
+
+			bool operator==(const LayoutBinding& other) const {
+				return binding == other.binding && type == other.type && count == other.count &&
+					stages == other.stages && flags == other.flags;
+			}
+		};
+
+		// Bindings sorted by binding number, so the order they were listed in doesn't matter
+		struct LayoutKey {
+			VkDescriptorSetLayoutCreateFlags flags;
+			std::vector<LayoutBinding> bindings;
+
+			bool operator==(const LayoutKey& other) const { return flags == other.flags && bindings == other.bindings; }
+		};
+
+		struct LayoutKeyHash {
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+		VulkanDevice& vulkanDevice;
+		std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+		mutable std::mutex mutex;
+	};
+
+	// Hands out descriptor sets from a list of pools, creating a bigger pool whenever the current one runs out,
+	// and frees them all at once with reset(). Give each frame in flight its own allocator and reset it once the
+	// frame's fence has signalled, then allocating a set is just a pool bump with no per-set bookkeeping.
+	class VulkanDescriptorAllocator {
+
+	public:
+		static constexpr uint32_t DEFAULT_SETS_PER_POOL = 64;
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		explicit VulkanDescriptorAllocator(VulkanDevice& device, uint32_t setsPerPool = DEFAULT_SETS_PER_POOL);
+		~VulkanDescriptorAllocator();
+
+		VulkanDescriptorAllocator(const VulkanDescriptorAllocator&) = delete;
+		VulkanDescriptorAllocator& operator=(const VulkanDescriptorAllocator&) = delete;
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+		// Returns every set to its pool, none of them may still be in use by the GPU
+		void reset();
+
+		uint32_t getPoolCount() const { return static_cast<uint32_t>(usedPools.size() + freePools.size()); }
+		// Sets handed out since the last reset()
+		uint32_t getAllocatedSetCount() const { return allocatedSetCount; }
+
+	private:
+		VkDescriptorPool grabPool();
+		VkDescriptorPool createPool(uint32_t setCount);
+
+		VulkanDevice& vulkanDevice;
+		uint32_t setsPerPool;
+		VkDescriptorPool currentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> usedPools;	// includes currentPool
+		std::vector<VkDescriptorPool> freePools;	// reset and ready for reuse
+		uint32_t allocatedSetCount = 0;
+	};
+
+	// Bindless mode: a single descriptor set holding runtime sized arrays of every storage buffer and texture,
+	// which shaders index into (eg. with an index from instance data or push constants). It's bound once per
+	// command buffer, so per-draw descriptor cost stays zero no matter how many resources exist.
+	// Needs VulkanDevice::supportsDescriptorIndexing(). Slots are written with update-after-bind, so resources can
+	// be added while earlier frames using the set are still in flight, as long as their own slots aren't touched.
+	class VulkanBindlessTable {
+
+	public:
+		static constexpr uint32_t STORAGE_BUFFER_BINDING = 0;
+		static constexpr uint32_t TEXTURE_BINDING = 1;
+		static constexpr uint32_t DEFAULT_MAX_BUFFERS = 1024;
+		static constexpr uint32_t DEFAULT_MAX_TEXTURES = 1024;
+		static constexpr uint32_t INVALID_SLOT = ~0u;
+
+		VulkanBindlessTable(
+			VulkanDevice& device,
+			VulkanDescriptorLayoutCache& layoutCache,
+			uint32_t maxBuffers = DEFAULT_MAX_BUFFERS,
+			uint32_t maxTextures = DEFAULT_MAX_TEXTURES);
+		~VulkanBindlessTable();
+
+		VulkanBindlessTable(const VulkanBindlessTable&) = delete;
+		VulkanBindlessTable& operator=(const VulkanBindlessTable&) = delete;
+
+		// Returns the array index shaders use to reach the resource
+		uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+		uint32_t addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+		// Points an existing slot at a different resource, no frame in flight may still be reading that slot
+		void updateBuffer(uint32_t slot, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+		void updateTexture(uint32_t slot, VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+		// The slot is reused by a later add, no frame in flight may still be reading it
+		void removeBuffer(uint32_t slot);
+		void removeTexture(uint32_t slot);
+
+		VkDescriptorSetLayout getLayout() const { return layout; }
+		VkDescriptorSet getSet() const { return set; }
+		uint32_t getBufferCount() const { return buffers.used - static_cast<uint32_t>(buffers.freeSlots.size()); }
+		uint32_t getTextureCount() const { return textures.used - static_cast<uint32_t>(textures.freeSlots.size()); }
+
+	private:
+		struct SlotList {
+			uint32_t capacity = 0;
+			uint32_t used = 0;	// high water mark
+			std::vector<uint32_t> freeSlots;
+
+			uint32_t acquire(const char* tableName);
+		};
+
+		VulkanDevice& vulkanDevice;
+		VkDescriptorSetLayout layout;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		SlotList buffers;
+		SlotList textures;
+	};
+
+}
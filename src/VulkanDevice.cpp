@@ -1,6 +1,8 @@
 #include "VulkanDevice.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -52,16 +54,30 @@ namespace VulkanSandbox {
 
 	// Class member functions below
 	
-	VulkanDevice::VulkanDevice(SandboxWindow& window) : window{ window } {
+	VulkanDevice::VulkanDevice(SandboxWindow& window, const std::string& pipelineCacheFilepath) 
+		: window{ window }, pipelineCacheFilepath{ pipelineCacheFilepath } {
+		// Presenting is the only reason we need the swap chain extension
+		if (!window.isHeadless()) {
+			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		}
+
 		createInstance();		// Initialize vulkan
 		setupDebugMessenger();	// Debug mode (TODO: turn off when running in release mode)
 		createSurface();		// Create GLFW window surface to bind to vulkan framebuffer
 		pickPhysicalDevice();	// Selects graphics device to be used for rendering
+		queryOptionalFeatures();	// Enables extras like descriptor indexing when the GPU has them
 		createLogicalDevice();	// Describes used features of physical device ^
+		createAllocator();		// Sub-allocates buffer and image memory out of large blocks
+		createPipelineCache();	// Reuses compiled pipelines from previous runs
 		createCommandPool();	// Command buffer allocation
 	}
 
 	VulkanDevice::~VulkanDevice() {
+		if (pipelineCache_ != VK_NULL_HANDLE) {
+			savePipelineCache();
+			vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+		}
+		allocator_.reset();
 		vkDestroyCommandPool(device_, commandPool, nullptr);
 		vkDestroyDevice(device_, nullptr);
 
@@ -69,7 +85,9 @@ namespace VulkanSandbox {
 			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 		}
 
-		vkDestroySurfaceKHR(instance, surface_, nullptr);
+		if (surface_ != VK_NULL_HANDLE) {
+			vkDestroySurfaceKHR(instance, surface_, nullptr);
+		}
 		vkDestroyInstance(instance, nullptr);
 	}
 
@@ -84,7 +102,8 @@ namespace VulkanSandbox {
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "TODO: engine name";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		// 1.1 for vkGetPhysicalDeviceFeatures2, everything past 1.0 is still optional (see queryOptionalFeatures)
+		appInfo.apiVersion = VK_API_VERSION_1_1;
 
 		VkInstanceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -139,11 +158,194 @@ namespace VulkanSandbox {
 		std::cout << "Physical device: " << properties.deviceName << std::endl;
 	}
 
+	void VulkanDevice::createAllocator() {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		allocator_ = std::make_unique<VulkanAllocator>(
+			device_,
+			memProperties,
+			properties.limits.bufferImageGranularity);
+	}
+
+	void VulkanDevice::createPipelineCache() {
+		if (pipelineCacheFilepath.empty()) {
+			return;
+		}
+
+		std::vector<char> cacheData;
+		std::ifstream file{ pipelineCacheFilepath, std::ios::ate | std::ios::binary };
+		if (file.is_open()) {
+			cacheData.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(cacheData.data(), cacheData.size());
+			file.close();
+
+			// Data from another GPU/driver would just be ignored (or worse) by the driver, so start empty instead
+			if (!isPipelineCacheDataValid(cacheData)) {
+				std::cout << "Pipeline cache: " << pipelineCacheFilepath << " is for a different device or driver, ignoring it" << std::endl;
+				cacheData.clear();
+			}
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = cacheData.size();
+		cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+		if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+		pipelineCacheLoaded_ = !cacheData.empty();
+	}
+
+	bool VulkanDevice::isPipelineCacheDataValid(const std::vector<char>& cacheData) {
+		// Every pipeline cache starts with this header, see "Pipeline Cache" in the Vulkan spec
+		VkPipelineCacheHeaderVersionOne header;
+		if (cacheData.size() < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, cacheData.data(), sizeof(header));
+
+		return header.headerSize >= sizeof(header) &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	void VulkanDevice::savePipelineCache() {
+		// Called from the destructor, so failing to save is only reported rather than thrown
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+			return;
+		}
+
+		std::vector<char> cacheData(dataSize);
+		if (vkGetPipelineCacheData(device_, pipelineCache_, &dataSize, cacheData.data()) != VK_SUCCESS) {
+			return;
+		}
+
+		std::ofstream file{ pipelineCacheFilepath, std::ios::binary | std::ios::trunc };
+		file.write(cacheData.data(), dataSize);
+		if (!file) {
+			std::cerr << "Pipeline cache: failed to write " << pipelineCacheFilepath << std::endl;
+		}
+	}
+
+	void VulkanDevice::queryOptionalFeatures() {
+		// No feature struct for this one, the device only has to be able to read its timestamp clock on the CPU
+		if (hasDeviceExtension(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) && graphicsQueueTimestampValidBits() != 0) {
+			auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(
+				instance,
+				"vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+			uint32_t timeDomainCount = 0;
+			if (getTimeDomains != nullptr) {
+				getTimeDomains(physicalDevice, &timeDomainCount, nullptr);
+			}
+			std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+			if (timeDomainCount > 0) {
+				getTimeDomains(physicalDevice, &timeDomainCount, timeDomains.data());
+			}
+			calibratedTimestampsSupported =
+				std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != timeDomains.end();
+			if (calibratedTimestampsSupported) {
+				deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+			}
+		}
+
+		// Extension structs can only be queried through vkGetPhysicalDeviceFeatures2, which needs a 1.1 device
+		if (properties.apiVersion < VK_API_VERSION_1_1) {
+			return;
+		}
+
+		// Only chain the structs of extensions the device has
+		VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+		supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		VkPhysicalDeviceTimelineSemaphoreFeatures supportedTimeline{};
+		supportedTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		VkPhysicalDevicePresentIdFeaturesKHR supportedPresentId{};
+		supportedPresentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWait{};
+		supportedPresentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+		const bool hasIndexing = hasDeviceExtension(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		const bool hasTimeline = hasDeviceExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		// Both build on VK_KHR_swapchain, which a headless device doesn't enable
+		const bool hasPresentWait =
+			!window.isHeadless() &&
+			hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+			hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		if (hasIndexing) {
+			supportedIndexing.pNext = features2.pNext;
+			features2.pNext = &supportedIndexing;
+		}
+		if (hasTimeline) {
+			supportedTimeline.pNext = features2.pNext;
+			features2.pNext = &supportedTimeline;
+		}
+		if (hasPresentWait) {
+			supportedPresentId.pNext = features2.pNext;
+			supportedPresentWait.pNext = &supportedPresentId;
+			features2.pNext = &supportedPresentWait;
+		}
+		if (features2.pNext == nullptr) {
+			return;
+		}
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+		timelineSemaphoreSupported = hasTimeline && supportedTimeline.timelineSemaphore;
+		if (timelineSemaphoreSupported) {
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		}
+
+		presentWaitSupported = hasPresentWait && supportedPresentId.presentId && supportedPresentWait.presentWait;
+		if (presentWaitSupported) {
+			presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+			presentIdFeatures.presentId = VK_TRUE;
+			presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+			presentWaitFeatures.presentWait = VK_TRUE;
+			deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		}
+
+		descriptorIndexingSupported =
+			hasIndexing &&
+			supportedIndexing.runtimeDescriptorArray &&
+			supportedIndexing.descriptorBindingPartiallyBound &&
+			supportedIndexing.descriptorBindingVariableDescriptorCount &&
+			supportedIndexing.descriptorBindingUpdateUnusedWhilePending &&
+			supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind &&
+			supportedIndexing.descriptorBindingSampledImageUpdateAfterBind &&
+			supportedIndexing.shaderSampledImageArrayNonUniformIndexing;
+		if (!descriptorIndexingSupported) {
+			return;
+		}
+
+		// Only turn on what the bindless table uses
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	}
+
 	void VulkanDevice::createLogicalDevice() {
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+		if (indices.transferFamilyHasValue) {
+			uniqueQueueFamilies.insert(indices.transferFamily);
+		}
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -165,6 +367,19 @@ namespace VulkanSandbox {
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
+		if (timelineSemaphoreSupported) {
+			timelineSemaphoreFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &timelineSemaphoreFeatures;
+		}
+		if (descriptorIndexingSupported) {
+			descriptorIndexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &descriptorIndexingFeatures;
+		}
+		if (presentWaitSupported) {
+			presentIdFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			presentWaitFeatures.pNext = &presentIdFeatures;
+			createInfo.pNext = &presentWaitFeatures;
+		}
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
 		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -182,8 +397,30 @@ namespace VulkanSandbox {
 			throw std::runtime_error("Failed to create logical device!");
 		}
 
+		// The instance is 1.1, so the timeline semaphore entry points are the extension's, loaded by hand
+		if (timelineSemaphoreSupported) {
+			waitSemaphores_ = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device_, "vkWaitSemaphoresKHR");
+			getSemaphoreCounterValue_ = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device_, "vkGetSemaphoreCounterValueKHR");
+			if (waitSemaphores_ == nullptr || getSemaphoreCounterValue_ == nullptr) {
+				timelineSemaphoreSupported = false;
+			}
+		}
+		if (calibratedTimestampsSupported) {
+			getCalibratedTimestamps_ = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(device_, "vkGetCalibratedTimestampsEXT");
+			calibratedTimestampsSupported = getCalibratedTimestamps_ != nullptr;
+		}
+		if (presentWaitSupported) {
+			waitForPresent_ = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR");
+			presentWaitSupported = waitForPresent_ != nullptr;
+		}
+
 		vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 		vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+		transferQueue_ = graphicsQueue_;
+		if (indices.transferFamilyHasValue) {
+			vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+		}
+		std::cout << "Transfer queue: " << (indices.transferFamilyHasValue ? "dedicated" : "shared with graphics") << std::endl;
 	}
 
 	void VulkanDevice::createCommandPool() {
@@ -200,15 +437,20 @@ namespace VulkanSandbox {
 		}
 	}
 
-	void VulkanDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+	void VulkanDevice::createSurface() {
+		if (window.isHeadless()) {
+			return;
+		}
+		window.createWindowSurface(instance, &surface_);
+	}
 
 	bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice device) {
 		QueueFamilyIndices indices = findQueueFamilies(device);
 
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported) {
+		bool swapChainAdequate = window.isHeadless();
+		if (extensionsSupported && !window.isHeadless()) {
 			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
@@ -271,11 +513,15 @@ namespace VulkanSandbox {
 	}
 
 	std::vector<const char*> VulkanDevice::getRequiredExtensions() {
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char*> extensions;
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		// Headless mode never initializes GLFW, and doesn't need any surface extensions anyway
+		if (!window.isHeadless()) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (enableValidationLayers) {
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -327,6 +573,21 @@ namespace VulkanSandbox {
 		return requiredExtensions.empty();
 	}
 
+	bool VulkanDevice::hasDeviceExtension(VkPhysicalDevice device, const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (std::strcmp(extension.extensionName, extensionName) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device) {
 		QueueFamilyIndices indices;
 
@@ -343,7 +604,13 @@ namespace VulkanSandbox {
 				indices.graphicsFamilyHasValue = true;
 			}
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			if (window.isHeadless()) {
+				// Nothing is presented, so the "present" queue is simply the graphics queue
+				presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+			}
+			else {
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			}
 			if (queueFamily.queueCount > 0 && presentSupport) {
 				indices.presentFamily = i;
 				indices.presentFamilyHasValue = true;
@@ -355,9 +622,43 @@ namespace VulkanSandbox {
 			i++;
 		}
 
+		// Prefer a transfer only family (the copy engine on discrete GPUs), then any family without graphics
+		for (int pass = 0; pass < 2 && !indices.transferFamilyHasValue; pass++) {
+			for (uint32_t family = 0; family < queueFamilyCount; family++) {
+				VkQueueFlags flags = queueFamilies[family].queueFlags;
+				bool transferOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+				if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+					!(flags & VK_QUEUE_GRAPHICS_BIT) && (transferOnly || pass == 1)) {
+					indices.transferFamily = family;
+					indices.transferFamilyHasValue = true;
+					break;
+				}
+			}
+		}
+
 		return indices;
 	}
 
+	uint32_t VulkanDevice::graphicsQueueTimestampValidBits() {
+		QueueFamilyIndices indices = findPhysicalQueueFamilies();
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		return queueFamilies[indices.graphicsFamily].timestampValidBits;
+	}
+
+	VkResult VulkanDevice::getDeviceTimestamp(uint64_t* timestamp) {
+		VkCalibratedTimestampInfoEXT timestampInfo{};
+		timestampInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		timestampInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+
+		uint64_t maxDeviation = 0;
+		return getCalibratedTimestamps_(device_, 1, &timestampInfo, timestamp, &maxDeviation);
+	}
+
 	SwapChainSupportDetails VulkanDevice::querySwapChainSupport(VkPhysicalDevice device) {
 		SwapChainSupportDetails details;
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface_, &details.capabilities);
@@ -401,6 +702,15 @@ namespace VulkanSandbox {
 		throw std::runtime_error("Failed to find supported format!");
 	}
 
+	bool VulkanDevice::formatSupports(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+		VkFormatFeatureFlags supported =
+			tiling == VK_IMAGE_TILING_LINEAR ? props.linearTilingFeatures : props.optimalTilingFeatures;
+		return (supported & features) == features;
+	}
+
 	uint32_t VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
 		VkPhysicalDeviceMemoryProperties memProperties;
 		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -419,7 +729,7 @@ namespace VulkanSandbox {
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory) {
+		VulkanAllocation& bufferAllocation) {
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -433,16 +743,15 @@ namespace VulkanSandbox {
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		bufferAllocation = allocator_->allocate(memRequirements, properties, VulkanAllocator::ResourceKind::Linear);
 
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate vertex buffer memory!");
-		}
+		vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset);
+	}
 
-		vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+	void VulkanDevice::destroyBuffer(VkBuffer& buffer, VulkanAllocation& bufferAllocation) {
+		vkDestroyBuffer(device_, buffer, nullptr);
+		allocator_->free(bufferAllocation);
+		buffer = VK_NULL_HANDLE;
 	}
 
 	VkCommandBuffer VulkanDevice::beginSingleTimeCommands() {
@@ -471,12 +780,20 @@ namespace VulkanSandbox {
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue_);
+		{
+			std::lock_guard<std::mutex> lock{ queueMutex_ };
+			vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
+			vkQueueWaitIdle(graphicsQueue_);
+		}
 
 		vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 	}
 
+	void VulkanDevice::waitIdle() {
+		std::lock_guard<std::mutex> lock{ queueMutex_ };
+		vkDeviceWaitIdle(device_);
+	}
+
 	void VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -520,7 +837,7 @@ namespace VulkanSandbox {
 		const VkImageCreateInfo& imageInfo,
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
-		VkDeviceMemory& imageMemory) {
+		VulkanAllocation& imageAllocation) {
 		if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create image!");
 		}
@@ -528,18 +845,20 @@ namespace VulkanSandbox {
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate image memory!");
-		}
+		VulkanAllocator::ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL
+			? VulkanAllocator::ResourceKind::Optimal
+			: VulkanAllocator::ResourceKind::Linear;
+		imageAllocation = allocator_->allocate(memRequirements, properties, kind);
 
-		if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+		if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to bind image memory!");
 		}
 	}
 
+	void VulkanDevice::destroyImage(VkImage& image, VulkanAllocation& imageAllocation) {
+		vkDestroyImage(device_, image, nullptr);
+		allocator_->free(imageAllocation);
+		image = VK_NULL_HANDLE;
+	}
+
 }  
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "SandboxWindow.hpp"
+#include "VulkanAllocator.hpp"
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -16,8 +19,11 @@ namespace VulkanSandbox {
 	struct QueueFamilyIndices {
 		uint32_t graphicsFamily;
 		uint32_t presentFamily;
+		// A family with transfer but no graphics support (usually the GPU's copy/DMA engine), optional
+		uint32_t transferFamily;
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
+		bool transferFamilyHasValue = false;
 		bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 	};
 
@@ -29,7 +35,9 @@ namespace VulkanSandbox {
 		const bool enableValidationLayers = true;
 #endif
 
-		VulkanDevice(SandboxWindow& window);
+		// Pipeline cache data is loaded from/saved to pipelineCacheFilepath when it's non-empty. 
+		// Without one no VkPipelineCache is created at all, so every pipeline compiles from scratch.
+		VulkanDevice(SandboxWindow& window, const std::string& pipelineCacheFilepath = "");
 		~VulkanDevice();
 
 		// Not copyable or movable
@@ -43,12 +51,51 @@ namespace VulkanSandbox {
 		VkSurfaceKHR surface() { return surface_; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
+		// The dedicated transfer queue, or the graphics queue when the GPU has no separate transfer family
+		VkQueue transferQueue() { return transferQueue_; }
+		bool hasDedicatedTransferQueue() { return transferQueue_ != graphicsQueue_; }
+		// Queues must be externally synchronized, so every submit/present/queue wait (and vkDeviceWaitIdle,
+		// which touches every queue) locks this, as work is submitted from more than one thread
+		std::mutex& queueMutex() { return queueMutex_; }
+		void waitIdle();
+		// Headless devices have no surface or swap chain support, frames are rendered to offscreen images
+		bool isHeadless() { return window.isHeadless(); }
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 		QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+		// Zero if the graphics queue doesn't support timestamp queries
+		uint32_t graphicsQueueTimestampValidBits();
 		VkFormat findSupportedFormat(
 			const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+		bool formatSupports(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
+
+		// All buffer and image memory is sub-allocated from the device's allocator
+		VulkanAllocator& allocator() { return *allocator_; }
+
+		// Shared by every pipeline creation, VK_NULL_HANDLE when caching is disabled
+		VkPipelineCache pipelineCache() { return pipelineCache_; }
+		// True if valid cache data for this device was found on disk at startup (ie. pipelines start warm)
+		bool pipelineCacheLoaded() { return pipelineCacheLoaded_; }
+
+		// VK_EXT_descriptor_indexing with everything a bindless descriptor table needs (runtime sized, partially
+		// bound and update-after-bind arrays), enabled on the device whenever the GPU supports it
+		bool supportsDescriptorIndexing() { return descriptorIndexingSupported; }
+		// VK_KHR_timeline_semaphore (core in 1.2), enabled on the device whenever the GPU supports it. The
+		// functions below may only be called when it is.
+		bool supportsTimelineSemaphores() { return timelineSemaphoreSupported; }
+		VkResult waitSemaphores(const VkSemaphoreWaitInfo& waitInfo, uint64_t timeout) { return waitSemaphores_(device_, &waitInfo, timeout); }
+		VkResult getSemaphoreCounterValue(VkSemaphore semaphore, uint64_t* value) { return getSemaphoreCounterValue_(device_, semaphore, value); }
+		// VK_EXT_calibrated_timestamps with the GPU's own timestamp clock readable on the CPU, enabled whenever
+		// the GPU supports it. getDeviceTimestamp(..) may only be called when it is, the value is in the same
+		// ticks as vkCmdWriteTimestamp on the graphics queue.
+		bool supportsCalibratedTimestamps() { return calibratedTimestampsSupported; }
+		VkResult getDeviceTimestamp(uint64_t* timestamp);
+		// VK_KHR_present_id and VK_KHR_present_wait together, enabled whenever the GPU supports both (never when
+		// headless). Presents can then carry an id, and waitForPresent(..) blocks until the present with that
+		// id, or a later one, has been shown. It may only be called when they are.
+		bool supportsPresentWait() { return presentWaitSupported; }
+		VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout) { return waitForPresent_(device_, swapChain, presentId, timeout); }
 
 		// Buffer Helper Functions
 		void createBuffer(
@@ -56,7 +103,8 @@ namespace VulkanSandbox {
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer& buffer,
-			VkDeviceMemory& bufferMemory);
+			VulkanAllocation& bufferAllocation);
+		void destroyBuffer(VkBuffer& buffer, VulkanAllocation& bufferAllocation);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -67,7 +115,8 @@ namespace VulkanSandbox {
 			const VkImageCreateInfo& imageInfo,
 			VkMemoryPropertyFlags properties,
 			VkImage& image,
-			VkDeviceMemory& imageMemory);
+			VulkanAllocation& imageAllocation);
+		void destroyImage(VkImage& image, VulkanAllocation& imageAllocation);
 
 		VkPhysicalDeviceProperties properties;
 
@@ -76,7 +125,12 @@ namespace VulkanSandbox {
 		void setupDebugMessenger();
 		void createSurface();
 		void pickPhysicalDevice();
+		void queryOptionalFeatures();
 		void createLogicalDevice();
+		void createAllocator();
+		void createPipelineCache();
+		void savePipelineCache();
+		bool isPipelineCacheDataValid(const std::vector<char>& cacheData);
 		void createCommandPool();
 
 		// helper functions
@@ -87,6 +141,7 @@ namespace VulkanSandbox {
 		void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 		void hasGflwRequiredInstanceExtensions();
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool hasDeviceExtension(VkPhysicalDevice device, const char* extensionName);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
 		VkInstance instance;
@@ -96,12 +151,32 @@ namespace VulkanSandbox {
 		VkCommandPool commandPool;
 
 		VkDevice device_;
-		VkSurfaceKHR surface_;
+		VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		VkQueue transferQueue_;
+		std::mutex queueMutex_;
+		std::unique_ptr<VulkanAllocator> allocator_;
+
+		std::string pipelineCacheFilepath;
+		VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+		bool pipelineCacheLoaded_ = false;
+
+		bool descriptorIndexingSupported = false;
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+		bool timelineSemaphoreSupported = false;
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+		PFN_vkWaitSemaphores waitSemaphores_ = nullptr;
+		PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue_ = nullptr;
+		bool calibratedTimestampsSupported = false;
+		PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps_ = nullptr;
+		bool presentWaitSupported = false;
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+		PFN_vkWaitForPresentKHR waitForPresent_ = nullptr;
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<const char*> deviceExtensions;
 	};
 
 } 
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "VulkanFrameRingBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace VulkanSandbox {
+
+	// Region sizes are kept a multiple of this, so every region starts at an offset that satisfies any
+	// alignment the spec allows for uniform/storage buffer offsets (at most 256 bytes)
+	static constexpr VkDeviceSize REGION_ALIGNMENT = 256;
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	VulkanFrameRingBuffer::VulkanFrameRingBuffer(VulkanDevice& device, uint32_t framesInFlight, VkDeviceSize frameSize)
+		: vulkanDevice(device), framesInFlight(framesInFlight), frameSize(alignUp(frameSize, REGION_ALIGNMENT))
+	{
+		frameOffsets.assign(framesInFlight, 0);
+		createBuffer();
+	}
+
+	VulkanFrameRingBuffer::~VulkanFrameRingBuffer()
+	{
+		for (RetiredBuffer& retired : retiredBuffers)
+			vulkanDevice.destroyBuffer(retired.buffer, retired.allocation);
+		vulkanDevice.destroyBuffer(buffer, allocation);
+	}
+
+	void VulkanFrameRingBuffer::resetFrame(uint32_t frameIndex)
+	{
+		frameOffsets[frameIndex] = 0;
+
+		for (size_t i = 0; i < retiredBuffers.size();)
+		{
+			if (--retiredBuffers[i].resetsRemaining == 0)
+			{
+				vulkanDevice.destroyBuffer(retiredBuffers[i].buffer, retiredBuffers[i].allocation);
+				retiredBuffers[i] = retiredBuffers.back();
+				retiredBuffers.pop_back();
+			}
+			else
+				i++;
+		}
+	}
+
+	VulkanFrameRingBuffer::Slice VulkanFrameRingBuffer::allocate(uint32_t frameIndex, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		assert(alignment <= REGION_ALIGNMENT && "Ring buffer alignment larger than the region alignment!");
+
+		VkDeviceSize offset = alignUp(frameOffsets[frameIndex], alignment);
+		if (offset + size > frameSize)
+		{
+			grow(size);
+			offset = 0;
+		}
+
+		frameOffsets[frameIndex] = offset + size;
+		peakFrameBytes = std::max(peakFrameBytes, frameOffsets[frameIndex]);
+
+		Slice slice{};
+		slice.buffer = buffer;
+		slice.offset = frameIndex * frameSize + offset;
+		slice.size = size;
+		slice.mapped = static_cast<char*>(allocation.mapped) + slice.offset;
+		return slice;
+	}
+
+	VulkanFrameRingBuffer::Slice VulkanFrameRingBuffer::allocateUniform(uint32_t frameIndex, VkDeviceSize size)
+	{
+		return allocate(frameIndex, size, vulkanDevice.properties.limits.minUniformBufferOffsetAlignment);
+	}
+
+	VulkanFrameRingBuffer::Slice VulkanFrameRingBuffer::allocateStorage(uint32_t frameIndex, VkDeviceSize size)
+	{
+		return allocate(frameIndex, size, vulkanDevice.properties.limits.minStorageBufferOffsetAlignment);
+	}
+
+	void VulkanFrameRingBuffer::createBuffer()
+	{
+		// Host coherent, so writes through the mapping need no vkFlushMappedMemoryRanges
+		vulkanDevice.createBuffer(
+			frameSize * framesInFlight,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer,
+			allocation);
+	}
+
+	void VulkanFrameRingBuffer::grow(VkDeviceSize minFrameSize)
+	{
+		// Other frames in flight (and this frame's earlier slices) may still be reading the old buffer,
+		// keep it alive until every slot has come around again
+		retiredBuffers.push_back({ buffer, allocation, framesInFlight });
+		buffer = VK_NULL_HANDLE;
+		allocation = VulkanAllocation{};
+
+		frameSize = alignUp(std::max(frameSize * 2, minFrameSize), REGION_ALIGNMENT);
+		createBuffer();
+		growCount++;
+	}
+
+}
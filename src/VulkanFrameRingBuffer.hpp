@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// One persistently mapped, host coherent buffer split into a region per frame in flight, for data that is
+	// rewritten every frame (instance data, dynamic uniform/storage buffer contents, ...). Allocations just bump
+	// an offset through the frame's region and the whole region is recycled at once when the frame slot comes
+	// around again, so streaming per-frame data never allocates memory or maps/unmaps anything.
+	class VulkanFrameRingBuffer {
+
+	public:
+		static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 1024 * 1024;
+
+		// A sub-range of the buffer, only valid until the same frame slot is reset
+		struct Slice {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+		};
+
+		VulkanFrameRingBuffer(VulkanDevice& device, uint32_t framesInFlight, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+		~VulkanFrameRingBuffer();
+
+		VulkanFrameRingBuffer(const VulkanFrameRingBuffer&) = delete;
+		VulkanFrameRingBuffer& operator=(const VulkanFrameRingBuffer&) = delete;
+
+		// Recycles the frame slot's region, the slot's last frame must have been waited on
+		void resetFrame(uint32_t frameIndex);
+
+		// Bump allocates from the frame's region. If it's full the whole buffer is replaced by one twice the size,
+		// earlier slices stay valid (the old buffer is only destroyed once every frame in flight is done with it).
+		Slice allocate(uint32_t frameIndex, VkDeviceSize size, VkDeviceSize alignment);
+		// Offsets suitable for VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER(_DYNAMIC) and STORAGE_BUFFER(_DYNAMIC) descriptors
+		Slice allocateUniform(uint32_t frameIndex, VkDeviceSize size);
+		Slice allocateStorage(uint32_t frameIndex, VkDeviceSize size);
+
+		// Changes whenever the buffer grows, slices carry the buffer they were allocated from
+		VkBuffer getBuffer() const { return buffer; }
+		VkDeviceSize getFrameSize() const { return frameSize; }
+		// Most bytes any single frame has allocated so far, including alignment padding
+		VkDeviceSize getPeakFrameBytes() const { return peakFrameBytes; }
+		uint32_t getGrowCount() const { return growCount; }
+
+	private:
+		struct RetiredBuffer {
+			VkBuffer buffer;
+			VulkanAllocation allocation;
+			uint32_t resetsRemaining; // destroyed once every frame slot has been reset after it was retired
+		};
+
+		void createBuffer();
+		void grow(VkDeviceSize minFrameSize);
+
+		VulkanDevice& vulkanDevice;
+		uint32_t framesInFlight;
+		VkDeviceSize frameSize;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VulkanAllocation allocation;
+		std::vector<VkDeviceSize> frameOffsets; // bump pointer per frame slot, relative to the slot's region
+		std::vector<RetiredBuffer> retiredBuffers;
+
+		VkDeviceSize peakFrameBytes = 0;
+		uint32_t growCount = 0;
+	};
+
+}
@@ -0,0 +1,165 @@
+#include "VulkanFrameSync.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	VulkanFrameSync::VulkanFrameSync(VulkanDevice& device, uint32_t framesInFlight, bool useTimelineSemaphore)
+		: vulkanDevice(device), framesInFlight(framesInFlight)
+	{
+		if (framesInFlight == 0)
+			throw std::runtime_error("At least one frame has to be in flight!");
+
+		if (useTimelineSemaphore && vulkanDevice.supportsTimelineSemaphores())
+		{
+			VkSemaphoreTypeCreateInfo typeInfo{};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			typeInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreInfo.pNext = &typeInfo;
+
+			if (vkCreateSemaphore(vulkanDevice.device(), &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create the frame timeline semaphore!");
+			return;
+		}
+
+		// Signalled to begin with, so waiting on a slot that was never submitted returns straight away
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		slotFences.resize(framesInFlight);
+		slotValues.assign(framesInFlight, 0);
+		for (VkFence& fence : slotFences)
+		{
+			if (vkCreateFence(vulkanDevice.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create a frame fence!");
+		}
+	}
+
+	VulkanFrameSync::~VulkanFrameSync()
+	{
+		if (timelineSemaphore != VK_NULL_HANDLE)
+			vkDestroySemaphore(vulkanDevice.device(), timelineSemaphore, nullptr);
+		for (VkFence fence : slotFences)
+			vkDestroyFence(vulkanDevice.device(), fence, nullptr);
+	}
+
+	void VulkanFrameSync::waitForValue(uint64_t value)
+	{
+		if (value <= completedValue)
+			return;
+		assert(value < frameValue && "Waiting for a frame that was never submitted!");
+
+		if (timelineSemaphore != VK_NULL_HANDLE)
+		{
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timelineSemaphore;
+			waitInfo.pValues = &value;
+			if (vulkanDevice.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS)
+				throw std::runtime_error("Failed to wait for the frame timeline semaphore!");
+			completedValue = value;
+			return;
+		}
+
+		// The slot's fence belongs to value or, if the slot has been reused since, a later frame
+		const uint32_t slot = static_cast<uint32_t>((value - 1) % framesInFlight);
+		vkWaitForFences(vulkanDevice.device(), 1, &slotFences[slot], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		completedValue = std::max(completedValue, slotValues[slot]);
+	}
+
+	bool VulkanFrameSync::isComplete(uint64_t value)
+	{
+		if (value <= completedValue)
+			return true;
+
+		if (timelineSemaphore != VK_NULL_HANDLE)
+		{
+			uint64_t counterValue = 0;
+			if (vulkanDevice.getSemaphoreCounterValue(timelineSemaphore, &counterValue) != VK_SUCCESS)
+				throw std::runtime_error("Failed to read the frame timeline semaphore!");
+			completedValue = std::max(completedValue, counterValue);
+		}
+		else
+		{
+			const uint32_t slot = static_cast<uint32_t>((value - 1) % framesInFlight);
+			if (vkGetFenceStatus(vulkanDevice.device(), slotFences[slot]) == VK_SUCCESS)
+				completedValue = std::max(completedValue, slotValues[slot]);
+		}
+		return value <= completedValue;
+	}
+
+	void VulkanFrameSync::submitFrame(
+		const VkCommandBuffer* commandBuffers,
+		uint32_t commandBufferCount,
+		VkSemaphore waitSemaphore,
+		VkPipelineStageFlags waitStage,
+		VkSemaphore signalSemaphore)
+	{
+		// The slot's previous frame must be done before its fence is reset (and usually already is)
+		waitForFrameSlot();
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = commandBufferCount;
+		submitInfo.pCommandBuffers = commandBuffers;
+
+		if (waitSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+
+		// The binary present semaphore (if any) first, then the timeline semaphore. Values of binary
+		// semaphores are ignored but the value arrays still have to cover every semaphore.
+		VkSemaphore signalSemaphores[2];
+		uint64_t signalValues[2] = { 0, 0 };
+		uint64_t waitValue = 0;
+		uint32_t signalCount = 0;
+		if (signalSemaphore != VK_NULL_HANDLE)
+			signalSemaphores[signalCount++] = signalSemaphore;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		VkFence fence = VK_NULL_HANDLE;
+		if (timelineSemaphore != VK_NULL_HANDLE)
+		{
+			signalValues[signalCount] = frameValue;
+			signalSemaphores[signalCount++] = timelineSemaphore;
+
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+			timelineInfo.pWaitSemaphoreValues = &waitValue;
+			timelineInfo.signalSemaphoreValueCount = signalCount;
+			timelineInfo.pSignalSemaphoreValues = signalValues;
+			submitInfo.pNext = &timelineInfo;
+		}
+		else
+		{
+			const uint32_t slot = getFrameIndex();
+			fence = slotFences[slot];
+			slotValues[slot] = frameValue;
+			vkResetFences(vulkanDevice.device(), 1, &fence);
+		}
+		submitInfo.signalSemaphoreCount = signalCount;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+
+		{
+			std::lock_guard<std::mutex> lock{ vulkanDevice.queueMutex() };
+			if (vkQueueSubmit(vulkanDevice.graphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit draw command buffer!");
+		}
+
+		frameValue++;
+	}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// CPU/GPU synchronization of the frames in flight. Every submitted frame gets the next value of a single
+	// timeline semaphore, which it signals once the GPU is done with it, so "is frame N done" is one counter
+	// read, and anything a frame used can be tagged with the frame's value and reused or destroyed once that
+	// value is reached, no matter which slot it belongs to. The number of frames in flight is picked at
+	// runtime (--frames-in-flight). Without VK_KHR_timeline_semaphore (or with --no-timeline-semaphore) it
+	// falls back to a fence per frame slot behind the same interface.
+	class VulkanFrameSync {
+
+	public:
+		static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+		VulkanFrameSync(VulkanDevice& device, uint32_t framesInFlight, bool useTimelineSemaphore = true);
+		~VulkanFrameSync();
+
+		VulkanFrameSync(const VulkanFrameSync&) = delete;
+		VulkanFrameSync& operator=(const VulkanFrameSync&) = delete;
+
+		uint32_t getFramesInFlight() const { return framesInFlight; }
+		bool usesTimelineSemaphore() const { return timelineSemaphore != VK_NULL_HANDLE; }
+
+		// Value the frame being prepared will signal, values start at 1 so 0 counts as "already done"
+		uint64_t getFrameValue() const { return frameValue; }
+		// Slot of the frame being prepared, for per-frame resources that exist framesInFlight times
+		uint32_t getFrameIndex() const { return static_cast<uint32_t>((frameValue - 1) % framesInFlight); }
+		// 0 before the first submit
+		uint64_t getLastSubmittedValue() const { return frameValue - 1; }
+
+		// Blocks until the frame framesInFlight before the one being prepared is done, after which everything
+		// in its slot can be reused
+		void waitForFrameSlot() { waitForValue(frameValue > framesInFlight ? frameValue - framesInFlight : 0); }
+		// Blocks until every frame up to and including value is done, value must have been submitted
+		void waitForValue(uint64_t value);
+		// Whether every frame up to and including value is done, without blocking
+		bool isComplete(uint64_t value);
+
+		// Submits the frame being prepared to the graphics queue, signalling its value once the GPU is done,
+		// then moves on to the next frame. waitSemaphore and signalSemaphore are the swap chain's binary acquire
+		// and present semaphores, VK_NULL_HANDLE when there are none (headless).
+		void submitFrame(
+			const VkCommandBuffer* commandBuffers,
+			uint32_t commandBufferCount,
+			VkSemaphore waitSemaphore,
+			VkPipelineStageFlags waitStage,
+			VkSemaphore signalSemaphore);
+
+	private:
+		VulkanDevice& vulkanDevice;
+		uint32_t framesInFlight;
+
+		uint64_t frameValue = 1;
+		// Highest value known to be done, saves asking the GPU again
+		uint64_t completedValue = 0;
+
+		VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+
+		// Fallback only, the fence of each slot and the value it was last submitted with. Fences signal once
+		// everything submitted before them is done too, so a signalled fence completes every earlier value.
+		std::vector<VkFence> slotFences;
+		std::vector<uint64_t> slotValues;
+	};
+
+}
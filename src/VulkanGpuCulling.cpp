@@ -0,0 +1,279 @@
+#include "VulkanGpuCulling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	// Buffer bindings of CullInstances.comp
+	static constexpr uint32_t TRANSFORM_BINDING = 0;
+	static constexpr uint32_t OBJECT_BINDING = 1;
+	static constexpr uint32_t MODEL_BINDING = 2;
+	static constexpr uint32_t COMMAND_BINDING = 3;
+	static constexpr uint32_t INSTANCE_BINDING = 4;
+
+	// instanceCount is the second member of both kinds of indirect command
+	static constexpr size_t INSTANCE_COUNT_OFFSET = sizeof(uint32_t);
+
+	VulkanGpuCulling::VulkanGpuCulling(VulkanDevice& device, VulkanDescriptorLayoutCache& layoutCache, uint32_t framesInFlight)
+		: vulkanDevice(device)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(BINDING_COUNT);
+		for (uint32_t i = 0; i < BINDING_COUNT; i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		setLayout = layoutCache.getLayout(bindings);
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create GPU culling pipeline layout!");
+
+		pipeline = std::make_unique<VulkanComputePipeline>(vulkanDevice, "src/shaders/CullInstances.comp.spv", pipelineLayout);
+
+		frames.resize(framesInFlight);
+		for (FrameResources& frame : frames)
+			frame.descriptorAllocator = std::make_unique<VulkanDescriptorAllocator>(vulkanDevice);
+	}
+
+	VulkanGpuCulling::~VulkanGpuCulling()
+	{
+		for (FrameResources& frame : frames)
+		{
+			if (frame.objectBuffer != VK_NULL_HANDLE)
+				vulkanDevice.destroyBuffer(frame.objectBuffer, frame.objectAllocation);
+			if (frame.indirectBuffer != VK_NULL_HANDLE)
+				vulkanDevice.destroyBuffer(frame.indirectBuffer, frame.indirectAllocation);
+			if (frame.instanceBuffer != VK_NULL_HANDLE)
+				vulkanDevice.destroyBuffer(frame.instanceBuffer, frame.instanceAllocation);
+		}
+		pipeline.reset();
+		vkDestroyPipelineLayout(vulkanDevice.device(), pipelineLayout, nullptr);
+	}
+
+	static bool sameBufferInfo(const VkDescriptorBufferInfo& a, const VkDescriptorBufferInfo& b)
+	{
+		return a.buffer == b.buffer && a.offset == b.offset && a.range == b.range;
+	}
+
+	void VulkanGpuCulling::prepareFrame(
+		uint32_t frameIndex,
+		const SandboxSimulation::Snapshot& snapshot,
+		const SandboxScene& scene,
+		VulkanFrameRingBuffer& ringBuffer,
+		glm::vec2 viewMin,
+		glm::vec2 viewMax)
+	{
+		FrameResources& frame = frames[frameIndex];
+		readBackStats(frame);
+
+		const uint32_t objectCount = static_cast<uint32_t>(snapshot.modelHandles.size());
+		updateModelDraws(snapshot, scene);
+		frame.objectCount = objectCount;
+		frame.commandCount = static_cast<uint32_t>(modelDraws.size());
+
+		if (frame.pushConstants.viewMin != viewMin || frame.pushConstants.viewMax != viewMax ||
+			frame.pushConstants.objectCount != objectCount)
+		{
+			frame.pushConstants = PushConstants{ viewMin, viewMax, objectCount };
+			frame.recordVersion++;
+		}
+		if (objectCount == 0)
+			return;
+
+		const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		reserveBuffer(
+			frame.indirectBuffer, frame.indirectAllocation, frame.commandCapacity, frame.commandCount,
+			Model::INDIRECT_COMMAND_STRIDE, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+		reserveBuffer(
+			frame.instanceBuffer, frame.instanceAllocation, frame.instanceCapacity, objectCount,
+			sizeof(Model::InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		const uint32_t objectCapacity = frame.objectCapacity;
+		reserveBuffer(
+			frame.objectBuffer, frame.objectAllocation, frame.objectCapacity, objectCount,
+			sizeof(GpuObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+		if (frame.sceneVersion != snapshot.sceneVersion || frame.objectCapacity != objectCapacity)
+			writeObjects(frame, snapshot);
+
+		// Command templates with no instances yet, the shader counts the visible ones into them. Instances are
+		// placed by the shader relative to each model's firstInstance, and the draws bind the instance buffer
+		// at that offset, so firstInstance stays 0 and the drawIndirectFirstInstance feature isn't needed.
+		char* commands = static_cast<char*>(frame.indirectAllocation.mapped);
+		for (size_t i = 0; i < modelDraws.size(); i++)
+			scene.getModel(modelDraws[i].modelHandle)->writeIndirectCommand(commands + i * Model::INDIRECT_COMMAND_STRIDE, 0);
+
+		// Transforms change every frame, so they're streamed like the CPU path's instance data
+		VulkanFrameRingBuffer::Slice transformSlice = ringBuffer.allocateStorage(frameIndex, objectCount * sizeof(glm::mat2));
+		memcpy(transformSlice.mapped, snapshot.transforms.data(), objectCount * sizeof(glm::mat2));
+
+		// Refreshed every frame for the same reason as SandboxApp::cullObjects() does with its extents
+		const size_t modelCount = modelCommandIndices.size();
+		VulkanFrameRingBuffer::Slice modelSlice = ringBuffer.allocateStorage(frameIndex, modelCount * sizeof(GpuModel));
+		GpuModel* models = static_cast<GpuModel*>(modelSlice.mapped);
+		for (SandboxScene::ModelHandle modelHandle = 0; modelHandle < modelCount; modelHandle++)
+		{
+			const Model::Bounds& bounds = scene.getModel(modelHandle)->getBounds();
+			GpuModel& model = models[modelHandle];
+			model.extent = glm::vec4((bounds.min + bounds.max) * 0.5f, (bounds.max - bounds.min) * 0.5f);
+			model.commandIndex = modelCommandIndices[modelHandle];
+			model.firstInstance = model.commandIndex != ~0u ? modelDraws[model.commandIndex].firstInstance : 0;
+		}
+
+		std::array<VkDescriptorBufferInfo, BINDING_COUNT> bufferInfos{};
+		bufferInfos[TRANSFORM_BINDING] = { transformSlice.buffer, transformSlice.offset, transformSlice.size };
+		bufferInfos[OBJECT_BINDING] = { frame.objectBuffer, 0, objectCount * sizeof(GpuObject) };
+		bufferInfos[MODEL_BINDING] = { modelSlice.buffer, modelSlice.offset, modelSlice.size };
+		bufferInfos[COMMAND_BINDING] = { frame.indirectBuffer, 0, frame.commandCount * Model::INDIRECT_COMMAND_STRIDE };
+		bufferInfos[INSTANCE_BINDING] = { frame.instanceBuffer, 0, objectCount * sizeof(Model::InstanceData) };
+		// The ring buffer hands out the same offsets every frame as long as the sizes stay the same, so
+		// usually nothing changes here
+		bool descriptorsChanged = frame.descriptorSet == VK_NULL_HANDLE;
+		for (uint32_t i = 0; i < BINDING_COUNT; i++)
+			descriptorsChanged = descriptorsChanged || !sameBufferInfo(bufferInfos[i], frame.bufferInfos[i]);
+		if (descriptorsChanged)
+			updateDescriptorSet(frame, bufferInfos);
+	}
+
+	void VulkanGpuCulling::recordDispatch(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		const FrameResources& frame = frames[frameIndex];
+		if (frame.objectCount == 0)
+			return;
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &frame.pushConstants);
+		vkCmdDispatch(commandBuffer, VulkanComputePipeline::groupCount(frame.objectCount, WORKGROUP_SIZE), 1, 1);
+
+		// The draws read the counted commands and the instances, and the CPU reads the counts back once the
+		// frame's fence has signalled (the host writes in prepareFrame(..) are made visible by the submission)
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	void VulkanGpuCulling::updateDescriptorSet(FrameResources& frame, const std::array<VkDescriptorBufferInfo, BINDING_COUNT>& bufferInfos)
+	{
+		// No command buffer of this frame slot is pending, the ones that recorded the old set are re-recorded
+		// since the version changes
+		frame.descriptorAllocator->reset();
+		frame.descriptorSet = frame.descriptorAllocator->allocate(setLayout);
+		frame.bufferInfos = bufferInfos;
+		frame.recordVersion++;
+
+		std::array<VkWriteDescriptorSet, BINDING_COUNT> writes{};
+		for (uint32_t i = 0; i < BINDING_COUNT; i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame.descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &frame.bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(vulkanDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void VulkanGpuCulling::readBackStats(FrameResources& frame)
+	{
+		lastFrameStats = FrameStats{};
+		lastFrameStats.objectCount = frame.objectCount;
+		if (frame.objectCount == 0)
+			return;
+
+		const char* commands = static_cast<const char*>(frame.indirectAllocation.mapped);
+		for (uint32_t i = 0; i < frame.commandCount; i++)
+		{
+			uint32_t instanceCount;
+			memcpy(&instanceCount, commands + i * Model::INDIRECT_COMMAND_STRIDE + INSTANCE_COUNT_OFFSET, sizeof(instanceCount));
+			lastFrameStats.drawnObjects += instanceCount;
+		}
+	}
+
+	void VulkanGpuCulling::updateModelDraws(const SandboxSimulation::Snapshot& snapshot, const SandboxScene& scene)
+	{
+		if (modelDrawsVersion == snapshot.sceneVersion)
+			return;
+		modelDrawsVersion = snapshot.sceneVersion;
+
+		// Count each model's objects, then give every used model a contiguous range of the instance buffer
+		// big enough for all of them, the same grouping SandboxApp::updateInstanceData(..) does every frame
+		std::vector<uint32_t> modelObjectCounts(scene.modelCount(), 0);
+		for (SandboxScene::ModelHandle modelHandle : snapshot.modelHandles)
+			modelObjectCounts[modelHandle]++;
+
+		modelDraws.clear();
+		modelCommandIndices.assign(scene.modelCount(), ~0u);
+		uint32_t firstInstance = 0;
+		for (SandboxScene::ModelHandle modelHandle = 0; modelHandle < scene.modelCount(); modelHandle++)
+		{
+			if (modelObjectCounts[modelHandle] == 0)
+				continue;
+			modelCommandIndices[modelHandle] = static_cast<uint32_t>(modelDraws.size());
+			modelDraws.push_back({ modelHandle, firstInstance, modelObjectCounts[modelHandle] });
+			firstInstance += modelObjectCounts[modelHandle];
+		}
+	}
+
+	void VulkanGpuCulling::reserveBuffer(
+		VkBuffer& buffer,
+		VulkanAllocation& allocation,
+		uint32_t& capacity,
+		uint32_t count,
+		VkDeviceSize elementSize,
+		VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags properties)
+	{
+		if (buffer != VK_NULL_HANDLE && capacity >= count)
+			return;
+
+		if (buffer != VK_NULL_HANDLE)
+			vulkanDevice.destroyBuffer(buffer, allocation);
+
+		// Some headroom, so a scene growing a few objects at a time doesn't recreate the buffers every frame
+		capacity = std::max<uint32_t>(count + count / 2, 1);
+		vulkanDevice.createBuffer(capacity * elementSize, usage, properties, buffer, allocation);
+	}
+
+	void VulkanGpuCulling::writeObjects(FrameResources& frame, const SandboxSimulation::Snapshot& snapshot)
+	{
+		GpuObject* objects = static_cast<GpuObject*>(frame.objectAllocation.mapped);
+		for (size_t i = 0; i < snapshot.modelHandles.size(); i++)
+		{
+			objects[i].translation = snapshot.translations[i];
+			objects[i].modelHandle = snapshot.modelHandles[i];
+			objects[i].padding = 0;
+			objects[i].colour = snapshot.colours[i];
+		}
+		frame.sceneVersion = snapshot.sceneVersion;
+	}
+
+}
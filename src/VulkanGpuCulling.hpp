@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Model.hpp"
+#include "SandboxScene.hpp"
+#include "SandboxSimulation.hpp"
+#include "VulkanComputePipeline.hpp"
+#include "VulkanDescriptors.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanFrameRingBuffer.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// GPU driven culling (--gpu-culling): a compute shader runs the same box test as CullKernel over every object
+	// of a snapshot, writes the instance data of the visible ones and counts them into one indirect draw command
+	// per model. The CPU then records a vkCmdDraw(Indexed)Indirect per model without ever looking at the objects,
+	// so per-frame CPU work is a copy of the snapshot's transforms plus a little per model.
+	class VulkanGpuCulling {
+
+	public:
+		static constexpr uint32_t WORKGROUP_SIZE = 64; // must match local_size_x in CullInstances.comp
+
+		// Where one model's instances and indirect command live, the model's instances are packed from
+		// firstInstance on in the instance buffer, its command is at index * Model::INDIRECT_COMMAND_STRIDE
+		struct ModelDraw {
+			SandboxScene::ModelHandle modelHandle;
+			uint32_t firstInstance;
+			uint32_t maxInstances; // every object using the model, ie. nothing culled
+		};
+
+		// What the GPU culled the last time a frame slot was used
+		struct FrameStats {
+			uint32_t objectCount = 0;
+			uint32_t drawnObjects = 0;
+		};
+
+		VulkanGpuCulling(VulkanDevice& device, VulkanDescriptorLayoutCache& layoutCache, uint32_t framesInFlight);
+		~VulkanGpuCulling();
+
+		VulkanGpuCulling(const VulkanGpuCulling&) = delete;
+		VulkanGpuCulling& operator=(const VulkanGpuCulling&) = delete;
+
+		// Writes everything the culling dispatch for frameIndex reads, every frame. The frame slot's fence must have
+		// been waited on (and ringBuffer's frame reset), as its buffers are read back and then rewritten.
+		// Objects overlapping [viewMin, viewMax] are kept.
+		void prepareFrame(
+			uint32_t frameIndex,
+			const SandboxSimulation::Snapshot& snapshot,
+			const SandboxScene& scene,
+			VulkanFrameRingBuffer& ringBuffer,
+			glm::vec2 viewMin,
+			glm::vec2 viewMax);
+		// Records the dispatch prepared for frameIndex, outside of any render pass. The draws must come after it
+		// in the same submission. A command buffer holding it can be submitted again for later frames of the
+		// same slot, until getRecordVersion(..) changes.
+		void recordDispatch(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		// Changes whenever prepareFrame(..) had to change something recordDispatch(..) bakes into the command
+		// buffer (buffers, descriptor set or push constants)
+		uint64_t getRecordVersion(uint32_t frameIndex) const { return frames[frameIndex].recordVersion; }
+
+		// Read back by the last prepareFrame(..), so from framesInFlight frames ago
+		FrameStats getLastFrameStats() const { return lastFrameStats; }
+		// Only models used by at least one object, in the order of their commands
+		const std::vector<ModelDraw>& getModelDraws() const { return modelDraws; }
+		VkBuffer getIndirectBuffer(uint32_t frameIndex) const { return frames[frameIndex].indirectBuffer; }
+		// Model::InstanceData, bound as the instance vertex buffer (and storage buffer) for this frame's draws
+		VkBuffer getInstanceBuffer(uint32_t frameIndex) const { return frames[frameIndex].instanceBuffer; }
+		VkDeviceSize getInstanceBufferSize(uint32_t frameIndex) const { return frames[frameIndex].instanceCapacity * sizeof(Model::InstanceData); }
+
+	private:
+		static constexpr uint32_t BINDING_COUNT = 5;
+
+		// std430 layouts of the shader's buffers, see CullInstances.comp
+		struct GpuObject {
+			glm::vec2 translation;
+			uint32_t modelHandle;
+			uint32_t padding;
+			glm::vec4 colour;
+		};
+		struct GpuModel {
+			glm::vec4 extent; // centre (xy) and half size (zw), like CullKernel's modelExtents
+			uint32_t commandIndex;
+			uint32_t firstInstance;
+			uint32_t padding[2];
+		};
+		struct PushConstants {
+			glm::vec2 viewMin;
+			glm::vec2 viewMax;
+			uint32_t objectCount;
+		};
+
+		// Everything the GPU reads or writes while a frame is in flight, so one set per frame slot
+		struct FrameResources {
+			// Translation, model and colour only change with the scene, so they're kept instead of streamed
+			VkBuffer objectBuffer = VK_NULL_HANDLE;
+			VulkanAllocation objectAllocation;
+			uint32_t objectCapacity = 0;
+			uint64_t sceneVersion = ~0ull;
+
+			// Host visible, so the drawn instance counts can be read back once the frame is done
+			VkBuffer indirectBuffer = VK_NULL_HANDLE;
+			VulkanAllocation indirectAllocation;
+			uint32_t commandCapacity = 0;
+			uint32_t commandCount = 0;
+			uint32_t objectCount = 0;
+
+			// Only ever written by the shader, so device local
+			VkBuffer instanceBuffer = VK_NULL_HANDLE;
+			VulkanAllocation instanceAllocation;
+			uint32_t instanceCapacity = 0;
+
+			// Only rewritten when a buffer range or the push constants change, so recorded dispatches stay valid
+			std::unique_ptr<VulkanDescriptorAllocator> descriptorAllocator;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			std::array<VkDescriptorBufferInfo, BINDING_COUNT> bufferInfos{};
+			PushConstants pushConstants{};
+			uint64_t recordVersion = 0;
+		};
+
+		void readBackStats(FrameResources& frame);
+		void updateModelDraws(const SandboxSimulation::Snapshot& snapshot, const SandboxScene& scene);
+		// Recreates buffer when it holds less than size bytes, the frame slot must not be in flight
+		void reserveBuffer(
+			VkBuffer& buffer,
+			VulkanAllocation& allocation,
+			uint32_t& capacity,
+			uint32_t count,
+			VkDeviceSize elementSize,
+			VkBufferUsageFlags usage,
+			VkMemoryPropertyFlags properties);
+		void writeObjects(FrameResources& frame, const SandboxSimulation::Snapshot& snapshot);
+		void updateDescriptorSet(FrameResources& frame, const std::array<VkDescriptorBufferInfo, BINDING_COUNT>& bufferInfos);
+
+		VulkanDevice& vulkanDevice;
+		VkDescriptorSetLayout setLayout;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<VulkanComputePipeline> pipeline;
+		std::vector<FrameResources> frames;
+
+		std::vector<ModelDraw> modelDraws;
+		// Per scene model handle, index into modelDraws (or ~0u for models no object uses)
+		std::vector<uint32_t> modelCommandIndices;
+		uint64_t modelDrawsVersion = ~0ull;
+		FrameStats lastFrameStats;
+	};
+
+}
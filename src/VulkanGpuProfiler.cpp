@@ -0,0 +1,128 @@
+#include "VulkanGpuProfiler.hpp"
+
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	VulkanGpuProfiler::VulkanGpuProfiler(VulkanDevice& device, uint32_t framesInFlight)
+		: vulkanDevice(device)
+	{
+		timestampValidBits = vulkanDevice.graphicsQueueTimestampValidBits();
+		timestampPeriod = vulkanDevice.properties.limits.timestampPeriod;
+		if (!isSupported())
+			return;
+
+		frames.resize(framesInFlight);
+		for (FrameQueries& frame : frames)
+		{
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2; // begin and end timestamp per scope
+
+			if (vkCreateQueryPool(vulkanDevice.device(), &queryPoolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+		queryResultsBuffer.resize(MAX_SCOPES_PER_FRAME * 2);
+	}
+
+	VulkanGpuProfiler::~VulkanGpuProfiler()
+	{
+		for (FrameQueries& frame : frames)
+			vkDestroyQueryPool(vulkanDevice.device(), frame.queryPool, nullptr);
+	}
+
+	bool VulkanGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!isSupported())
+			return false;
+
+		currentFrame = frameIndex;
+		FrameQueries& frame = frames[currentFrame];
+
+		bool collected = !frame.scopeNames.empty() && collectResults(frame);
+
+		frame.scopeNames.clear();
+		vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MAX_SCOPES_PER_FRAME * 2);
+		return collected;
+	}
+
+	bool VulkanGpuProfiler::replayFrame(uint32_t frameIndex, const std::vector<std::string>& scopeNames)
+	{
+		if (!isSupported())
+			return false;
+
+		currentFrame = frameIndex;
+		FrameQueries& frame = frames[currentFrame];
+
+		bool collected = !frame.scopeNames.empty() && collectResults(frame);
+
+		// The replayed buffer resets the pool and writes these scopes' timestamps itself
+		frame.scopeNames = scopeNames;
+		return collected;
+	}
+
+	const std::vector<std::string>& VulkanGpuProfiler::getScopeNames(uint32_t frameIndex) const
+	{
+		static const std::vector<std::string> noScopes;
+		return isSupported() ? frames[frameIndex].scopeNames : noScopes;
+	}
+
+	uint32_t VulkanGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+	{
+		if (!isSupported())
+			return INVALID_SCOPE;
+
+		FrameQueries& frame = frames[currentFrame];
+		uint32_t scopeId;
+		{
+			std::lock_guard<std::mutex> lock{ scopeMutex };
+			if (frame.scopeNames.size() >= MAX_SCOPES_PER_FRAME)
+				return INVALID_SCOPE;
+
+			scopeId = static_cast<uint32_t>(frame.scopeNames.size());
+			frame.scopeNames.push_back(name);
+		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, scopeId * 2);
+		return scopeId;
+	}
+
+	void VulkanGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scopeId)
+	{
+		if (scopeId == INVALID_SCOPE)
+			return;
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[currentFrame].queryPool, scopeId * 2 + 1);
+	}
+
+	bool VulkanGpuProfiler::collectResults(FrameQueries& frame)
+	{
+		// The swap chain has already waited for this slot's last frame, so no WAIT_BIT is needed here. 
+		// VK_NOT_READY would only mean a scope was opened but never closed, in which case the frame is skipped.
+		const uint32_t queryCount = static_cast<uint32_t>(frame.scopeNames.size()) * 2;
+		VkResult result = vkGetQueryPoolResults(
+			vulkanDevice.device(),
+			frame.queryPool,
+			0,
+			queryCount,
+			queryCount * sizeof(uint64_t),
+			queryResultsBuffer.data(),
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS)
+			return false;
+
+		const uint64_t validMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+
+		latestResults.clear();
+		for (size_t i = 0; i < frame.scopeNames.size(); i++)
+		{
+			uint64_t begin = queryResultsBuffer[i * 2] & validMask;
+			uint64_t end = queryResultsBuffer[i * 2 + 1] & validMask;
+			double nanoseconds = static_cast<double>((end - begin) & validMask) * timestampPeriod;
+			latestResults.push_back({ frame.scopeNames[i], nanoseconds / 1.0e6 });
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// Measures GPU time of named scopes in a frame's command buffer using timestamp queries.
+	// Each frame in flight gets its own query pool, and a frame's results are read back the next time its 
+	// pool is reused (ie. once the swap chain has already waited for that slot's last frame), so nothing stalls.
+	class VulkanGpuProfiler {
+
+	public:
+		static constexpr uint32_t MAX_SCOPES_PER_FRAME = 256;
+		static constexpr uint32_t INVALID_SCOPE = ~0u;
+
+		struct ScopeResult {
+			std::string name;
+			double milliseconds;
+		};
+
+		VulkanGpuProfiler(VulkanDevice& device, uint32_t framesInFlight);
+		~VulkanGpuProfiler();
+
+		VulkanGpuProfiler(const VulkanGpuProfiler&) = delete;
+		VulkanGpuProfiler& operator=(const VulkanGpuProfiler&) = delete;
+
+		// Timestamps are optional on some queues, all scope calls are no-ops when unsupported
+		bool isSupported() const { return timestampValidBits != 0; }
+
+		// Must be recorded outside of a render pass, before any scopes for this frame. Returns true if 
+		// results from the last use of this frame slot were collected (see getLatestResults())
+		bool beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		// For a command buffer recorded earlier for the same frame slot (beginFrame(..) and all its scopes included)
+		// that is submitted again without re-recording. Collects results like beginFrame(..), then expects the
+		// scopes the buffer was recorded with, as returned by getScopeNames(..) right after recording it.
+		bool replayFrame(uint32_t frameIndex, const std::vector<std::string>& scopeNames);
+		const std::vector<std::string>& getScopeNames(uint32_t frameIndex) const;
+
+		// Returns INVALID_SCOPE once the frame runs out of queries, which endScope(..) silently ignores.
+		// Scopes may be opened from several threads at once (ie. in secondary command buffers).
+		uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+		void endScope(VkCommandBuffer commandBuffer, uint32_t scopeId);
+
+		// Results of the most recently completed frame, in the order the scopes were opened
+		const std::vector<ScopeResult>& getLatestResults() const { return latestResults; }
+
+	private:
+		struct FrameQueries {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			std::vector<std::string> scopeNames;
+		};
+
+		bool collectResults(FrameQueries& frame);
+
+		VulkanDevice& vulkanDevice;
+		std::vector<FrameQueries> frames;
+		uint32_t currentFrame = 0;
+		uint32_t timestampValidBits = 0;
+		float timestampPeriod = 1.0f;
+
+		std::vector<ScopeResult> latestResults;
+		std::vector<uint64_t> queryResultsBuffer;
+		mutable std::mutex scopeMutex;
+	};
+
+}
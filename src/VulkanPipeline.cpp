@@ -1,6 +1,8 @@
 #include "VulkanPipeline.hpp"
 #include "Model.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -9,10 +11,40 @@
 
 namespace VulkanSandbox {
 
-	VulkanPipeline::VulkanPipeline(VulkanDevice& vulkanDevice, const std::string& vertexShaderFilepath, const std::string& fragmentShaderFilepath, const PipelineConfigInfo& configInfo)
+	// The constant_id of every specialization constant a SPIR-V module declares, ie. its OpDecorate <id> SpecId
+	// annotations. Those all come before the first function, so the scan stops there.
+	static std::vector<uint32_t> findSpecializationConstantIds(const std::vector<char>& spirv)
+	{
+		constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+		constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+		constexpr uint32_t OP_DECORATE = 71;
+		constexpr uint32_t OP_FUNCTION = 54;
+		constexpr uint32_t DECORATION_SPEC_ID = 1;
+
+		std::vector<uint32_t> words(spirv.size() / sizeof(uint32_t));
+		std::memcpy(words.data(), spirv.data(), words.size() * sizeof(uint32_t));
+
+		std::vector<uint32_t> ids;
+		if (words.size() < SPIRV_HEADER_WORDS || words[0] != SPIRV_MAGIC)
+			return ids;
+
+		for (size_t i = SPIRV_HEADER_WORDS; i < words.size();)
+		{
+			const uint32_t wordCount = words[i] >> 16;
+			const uint32_t opcode = words[i] & 0xffff;
+			if (wordCount == 0 || i + wordCount > words.size() || opcode == OP_FUNCTION)
+				break;
+			if (opcode == OP_DECORATE && wordCount >= 4 && words[i + 2] == DECORATION_SPEC_ID)
+				ids.push_back(words[i + 3]);
+			i += wordCount;
+		}
+		return ids;
+	}
+
+	VulkanPipeline::VulkanPipeline(VulkanDevice& vulkanDevice, const std::string& vertexShaderFilepath, const std::string& fragmentShaderFilepath, const PipelineConfigInfo& configInfo, const ShaderVariant& variant)
 		: vulkanDeviceRef(vulkanDevice)
 	{
-		createGraphicsPipeline(vertexShaderFilepath, fragmentShaderFilepath, configInfo);
+		createGraphicsPipeline(vertexShaderFilepath, fragmentShaderFilepath, configInfo, variant);
 	}
 
 	VulkanPipeline::~VulkanPipeline()
@@ -107,7 +139,7 @@ namespace VulkanSandbox {
 		configInfo.dynamicStateInfo.flags = 0;
 	}
 
-	void VulkanPipeline::createGraphicsPipeline(const std::string& vertexShaderFilepath, const std::string& fragmentShaderFilepath, const PipelineConfigInfo& configInfo)
+	void VulkanPipeline::createGraphicsPipeline(const std::string& vertexShaderFilepath, const std::string& fragmentShaderFilepath, const PipelineConfigInfo& configInfo, const ShaderVariant& variant)
 	{
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline -- missing pipelineLayout in configInfo!");
 		assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline -- missing renderPass in configInfo!");
@@ -118,10 +150,38 @@ namespace VulkanSandbox {
 		std::cout << "VS file size: " << vertexShaderSourceCode.size() << std::endl;
 		std::cout << "FS file size: " << fragmentShaderSourceCode.size() << std::endl;
 
+		// Binaries that weren't rebuilt after a constant was added would quietly ignore it, and every variant
+		// would be the same pipeline under a different key
+		std::vector<uint32_t> declaredConstants = findSpecializationConstantIds(vertexShaderSourceCode);
+		std::vector<uint32_t> fragmentConstants = findSpecializationConstantIds(fragmentShaderSourceCode);
+		declaredConstants.insert(declaredConstants.end(), fragmentConstants.begin(), fragmentConstants.end());
+		for (uint32_t id = 0; id < variant.constants.size(); id++)
+		{
+			if (std::find(declaredConstants.begin(), declaredConstants.end(), id) == declaredConstants.end())
+				throw std::runtime_error(
+					"Neither " + vertexShaderFilepath + " nor " + fragmentShaderFilepath + " declares specialization constant " +
+					std::to_string(id) + ", recompile the shaders with src/compile.bat!");
+		}
+
 		// Create Vulkan shader program modules 
 		createShaderModule(vertexShaderSourceCode, &vertexShaderModule);
 		createShaderModule(fragmentShaderSourceCode, &fragmentShaderModule);
 
+		// One map entry per specialization constant, shared by both stages
+		std::vector<VkSpecializationMapEntry> specializationEntries(variant.constants.size());
+		for (uint32_t i = 0; i < specializationEntries.size(); i++)
+		{
+			specializationEntries[i].constantID = i;
+			specializationEntries[i].offset = i * sizeof(uint32_t);
+			specializationEntries[i].size = sizeof(uint32_t);
+		}
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+		specializationInfo.pMapEntries = specializationEntries.data();
+		specializationInfo.dataSize = variant.constants.size() * sizeof(uint32_t);
+		specializationInfo.pData = variant.constants.data();
+		const VkSpecializationInfo* pSpecializationInfo = variant.constants.empty() ? nullptr : &specializationInfo;
+
 		// Set up info for shader stages (Vertex and Fragment stages only for now)
 		VkPipelineShaderStageCreateInfo shaderStagesInfo[2];
 		// Vertex shader stage
@@ -131,7 +191,7 @@ namespace VulkanSandbox {
 		shaderStagesInfo[0].pName = "main";
 		shaderStagesInfo[0].flags = 0;
 		shaderStagesInfo[0].pNext = nullptr;
-		shaderStagesInfo[0].pSpecializationInfo = nullptr;
+		shaderStagesInfo[0].pSpecializationInfo = pSpecializationInfo;
 		// Fragment shader stage
 		shaderStagesInfo[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStagesInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -139,11 +199,15 @@ namespace VulkanSandbox {
 		shaderStagesInfo[1].pName = "main";
 		shaderStagesInfo[1].flags = 0;
 		shaderStagesInfo[1].pNext = nullptr;
-		shaderStagesInfo[1].pSpecializationInfo = nullptr;
+		shaderStagesInfo[1].pSpecializationInfo = pSpecializationInfo;
 
-		// Define how the vertex buffer data is interpreted 
+		// Define how the vertex buffer data is interpreted (per-vertex data in binding 0, per-instance data in binding 1)
 		auto bindingDescriptions = Model::Vertex::getBindingDescriptions();
 		auto vertexAttributeDescriptions = Model::Vertex::getAttributeDescriptions();
+		auto instanceBindingDescriptions = Model::InstanceData::getBindingDescriptions();
+		auto instanceAttributeDescriptions = Model::InstanceData::getAttributeDescriptions();
+		bindingDescriptions.insert(bindingDescriptions.end(), instanceBindingDescriptions.begin(), instanceBindingDescriptions.end());
+		vertexAttributeDescriptions.insert(vertexAttributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
 		VkPipelineVertexInputStateCreateInfo vertexShaderInputInfo{}; 
 		vertexShaderInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexShaderInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
@@ -172,7 +236,7 @@ namespace VulkanSandbox {
 		vulkanPipelineInfo.subpass = configInfo.subpass;
 
 		// Finally, use the vulkanDeviceRef with this vulkanPipelineInfo to create the graphicsPipeline!
-		if (vkCreateGraphicsPipelines(vulkanDeviceRef.device(), VK_NULL_HANDLE, 1, &vulkanPipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+		if (vkCreateGraphicsPipelines(vulkanDeviceRef.device(), vulkanDeviceRef.pipelineCache(), 1, &vulkanPipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create a graphics pipeline!");
 
 	}
@@ -28,6 +28,15 @@ namespace VulkanSandbox {
 		uint32_t subpass = 0;
 	};
 
+	// Values for a pipeline's specialization constants, constant_id i gets constants[i] in every stage. Each value
+	// is 32 bits, which also covers bool constants (VkBool32), and a stage simply ignores ids it doesn't declare.
+	// Branches on these are resolved when the pipeline is created, so unused shader paths are compiled out.
+	struct ShaderVariant {
+		std::vector<uint32_t> constants;
+
+		bool operator==(const ShaderVariant& other) const { return constants == other.constants; }
+	};
+
 	class VulkanPipeline {
 
 	public:
@@ -36,7 +45,8 @@ namespace VulkanSandbox {
 			VulkanDevice& vulkanDevice,
 			const std::string& vertexShaderFilepath,
 			const std::string& fragmentShaderFilepath,
-			const PipelineConfigInfo& configInfo);
+			const PipelineConfigInfo& configInfo,
+			const ShaderVariant& variant = ShaderVariant{});
 
 		~VulkanPipeline();
 
@@ -47,14 +57,16 @@ namespace VulkanSandbox {
 
 		static void setupDefaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
+		// Reads a whole (SPIR-V) file, shared with VulkanComputePipeline
+		static std::vector<char> readFile(const std::string& filepath);
+
 	private:
 
 		void createGraphicsPipeline(
 			const std::string& vertexShaderFilepath,
 			const std::string& fragmentShaderFilepath,
-			const PipelineConfigInfo& configInfo);
-
-		std::vector<char> readFile(const std::string& filepath);
+			const PipelineConfigInfo& configInfo,
+			const ShaderVariant& variant);
 
 		void createShaderModule(const std::vector<char>& shaderSourceCode, VkShaderModule* shaderModule);
 
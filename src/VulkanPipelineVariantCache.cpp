@@ -0,0 +1,48 @@
+#include "VulkanPipelineVariantCache.hpp"
+
+#include <functional>
+#include <utility>
+
+namespace VulkanSandbox {
+
+	VulkanPipelineVariantCache::VulkanPipelineVariantCache(VulkanDevice& device, std::string vertexShaderFilepath, std::string fragmentShaderFilepath)
+		: vulkanDevice(device), vertexShaderFilepath(std::move(vertexShaderFilepath)), fragmentShaderFilepath(std::move(fragmentShaderFilepath))
+	{
+	}
+
+	VulkanPipeline& VulkanPipelineVariantCache::getPipeline(const PipelineConfigInfo& configInfo, const ShaderVariant& variant, bool* created)
+	{
+		VariantKey key{ configInfo.renderPass, configInfo.pipelineLayout, configInfo.subpass, variant };
+		auto found = pipelines.find(key);
+		if (created)
+			*created = found == pipelines.end();
+		if (found != pipelines.end())
+			return *found->second;
+
+		auto pipeline = std::make_unique<VulkanPipeline>(vulkanDevice, vertexShaderFilepath, fragmentShaderFilepath, configInfo, variant);
+		createdCount++;
+		VulkanPipeline& result = *pipeline;
+		pipelines.emplace(std::move(key), std::move(pipeline));
+		return result;
+	}
+
+	void VulkanPipelineVariantCache::clear()
+	{
+		pipelines.clear();
+	}
+
+	size_t VulkanPipelineVariantCache::VariantKeyHash::operator()(const VariantKey& key) const
+	{
+		size_t seed = 0;
+		auto combine = [&seed](size_t value) {
+			seed ^= std::hash<size_t>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		};
+		combine(std::hash<VkRenderPass>{}(key.renderPass));
+		combine(std::hash<VkPipelineLayout>{}(key.pipelineLayout));
+		combine(key.subpass);
+		for (uint32_t constant : key.variant.constants)
+			combine(constant);
+		return seed;
+	}
+
+}
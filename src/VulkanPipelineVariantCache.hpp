@@ -0,0 +1,60 @@
+#pragma once
+
+#include "VulkanPipeline.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// All pipelines built from one vertex/fragment shader pair, one per combination of render pass, pipeline
+	// layout, subpass and ShaderVariant. A variant is only compiled the first time it's asked for (going through
+	// the device's VkPipelineCache, so that's cheap too once the cache file is warm), after that it's a lookup.
+	// Every other setting comes from the PipelineConfigInfo of that first request, so the config must otherwise
+	// be the same for every variant (ie. VulkanPipeline::setupDefaultPipelineConfigInfo(..)'s defaults).
+	class VulkanPipelineVariantCache {
+
+	public:
+		VulkanPipelineVariantCache(VulkanDevice& device, std::string vertexShaderFilepath, std::string fragmentShaderFilepath);
+
+		VulkanPipelineVariantCache(const VulkanPipelineVariantCache&) = delete;
+		VulkanPipelineVariantCache& operator=(const VulkanPipelineVariantCache&) = delete;
+
+		// Stays valid until clear(), set *created to find out whether it had to be compiled
+		VulkanPipeline& getPipeline(const PipelineConfigInfo& configInfo, const ShaderVariant& variant, bool* created = nullptr);
+
+		// Destroys every pipeline, ie. once the render pass they were created against is gone. None of them
+		// may still be in use by the GPU.
+		void clear();
+
+		size_t size() const { return pipelines.size(); }
+		// Variants compiled over the cache's lifetime, including ones thrown away by clear()
+		uint32_t getCreatedCount() const { return createdCount; }
+
+	private:
+		struct VariantKey {
+			VkRenderPass renderPass;
+			VkPipelineLayout pipelineLayout;
+			uint32_t subpass;
+			ShaderVariant variant;
+
+			bool operator==(const VariantKey& other) const {
+				return renderPass == other.renderPass && pipelineLayout == other.pipelineLayout &&
+					subpass == other.subpass && variant == other.variant;
+			}
+		};
+
+		struct VariantKeyHash {
+			size_t operator()(const VariantKey& key) const;
+		};
+
+		VulkanDevice& vulkanDevice;
+		std::string vertexShaderFilepath;
+		std::string fragmentShaderFilepath;
+		std::unordered_map<VariantKey, std::unique_ptr<VulkanPipeline>, VariantKeyHash> pipelines;
+		uint32_t createdCount = 0;
+	};
+
+}
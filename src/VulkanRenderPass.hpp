@@ -0,0 +1,37 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+namespace VulkanSandbox {
+
+	// The colour + depth render pass used to draw into the swap chain. Kept separate from VulkanSwapChain
+	// (and shared between swap chain instances) so a resize that keeps the same formats can keep using the
+	// same render pass, and every pipeline created against it, instead of rebuilding them.
+	class VulkanRenderPass {
+
+	public:
+		VulkanRenderPass(
+			VulkanDevice& device,
+			VkFormat colourFormat,
+			VkFormat depthFormat,
+			VkImageLayout colourFinalLayout);
+		~VulkanRenderPass();
+
+		VulkanRenderPass(const VulkanRenderPass&) = delete;
+		VulkanRenderPass& operator=(const VulkanRenderPass&) = delete;
+
+		VkRenderPass getRenderPass() { return renderPass; }
+
+		// True if this render pass is exactly what would be created for the given attachments, which also makes
+		// it compatible (same formats, same sample counts) with anything created against such a render pass
+		bool matches(VkFormat colourFormat, VkFormat depthFormat, VkImageLayout colourFinalLayout) const;
+
+	private:
+		VulkanDevice& vulkanDevice;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFormat colourFormat;
+		VkFormat depthFormat;
+		VkImageLayout colourFinalLayout;
+	};
+
+}
@@ -0,0 +1,112 @@
+#include "VulkanSamplerCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	VulkanSamplerCache::VulkanSamplerCache(VulkanDevice& device)
+		: vulkanDevice(device) {}
+
+	VulkanSamplerCache::~VulkanSamplerCache()
+	{
+		for (auto& sampler : samplers)
+			vkDestroySampler(vulkanDevice.device(), sampler.second, nullptr);
+	}
+
+	VkSampler VulkanSamplerCache::getSampler(const VkSamplerCreateInfo& createInfo)
+	{
+		assert(createInfo.pNext == nullptr && "Sampler cache doesn't support sampler extension structs!");
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto cached = samplers.find(createInfo);
+		if (cached != samplers.end())
+			return cached->second;
+
+		VkSampler sampler;
+		if (vkCreateSampler(vulkanDevice.device(), &createInfo, nullptr, &sampler) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create sampler!");
+
+		samplers.emplace(createInfo, sampler);
+		return sampler;
+	}
+
+	VkSamplerCreateInfo VulkanSamplerCache::defaultSamplerInfo(uint32_t mipLevels) const
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.mipLodBias = 0.0f;
+		// samplerAnisotropy is always enabled on the device (it's required by isDeviceSuitable(..))
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = std::min(16.0f, vulkanDevice.properties.limits.maxSamplerAnisotropy);
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = static_cast<float>(mipLevels);
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		return samplerInfo;
+	}
+
+	size_t VulkanSamplerCache::size() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return samplers.size();
+	}
+
+	// Every field that affects the sampler, sType/pNext are always the same
+	size_t VulkanSamplerCache::SamplerKeyHash::operator()(const VkSamplerCreateInfo& info) const
+	{
+		size_t seed = 0;
+		auto combine = [&seed](size_t value) {
+			seed ^= std::hash<size_t>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		};
+		auto combineFloat = [&combine](float value) { combine(std::hash<float>{}(value)); };
+		combine(info.flags);
+		combine(info.magFilter);
+		combine(info.minFilter);
+		combine(info.mipmapMode);
+		combine(info.addressModeU);
+		combine(info.addressModeV);
+		combine(info.addressModeW);
+		combineFloat(info.mipLodBias);
+		combine(info.anisotropyEnable);
+		combineFloat(info.maxAnisotropy);
+		combine(info.compareEnable);
+		combine(info.compareOp);
+		combineFloat(info.minLod);
+		combineFloat(info.maxLod);
+		combine(info.borderColor);
+		combine(info.unnormalizedCoordinates);
+		return seed;
+	}
+
+	bool VulkanSamplerCache::SamplerKeyEqual::operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const
+	{
+		return a.flags == b.flags &&
+			a.magFilter == b.magFilter &&
+			a.minFilter == b.minFilter &&
+			a.mipmapMode == b.mipmapMode &&
+			a.addressModeU == b.addressModeU &&
+			a.addressModeV == b.addressModeV &&
+			a.addressModeW == b.addressModeW &&
+			a.mipLodBias == b.mipLodBias &&
+			a.anisotropyEnable == b.anisotropyEnable &&
+			a.maxAnisotropy == b.maxAnisotropy &&
+			a.compareEnable == b.compareEnable &&
+			a.compareOp == b.compareOp &&
+			a.minLod == b.minLod &&
+			a.maxLod == b.maxLod &&
+			a.borderColor == b.borderColor &&
+			a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+	}
+
+}
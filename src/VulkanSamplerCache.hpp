@@ -0,0 +1,42 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace VulkanSandbox {
+
+	// Hands out one VkSampler per distinct VkSamplerCreateInfo. Samplers are tiny but drivers limit how many can
+	// exist (maxSamplerAllocationCount, as low as 4000), and most textures want the same handful of settings.
+	class VulkanSamplerCache {
+
+	public:
+		explicit VulkanSamplerCache(VulkanDevice& device);
+		~VulkanSamplerCache();
+
+		VulkanSamplerCache(const VulkanSamplerCache&) = delete;
+		VulkanSamplerCache& operator=(const VulkanSamplerCache&) = delete;
+
+		// Extension structs aren't part of the key, createInfo.pNext must be null
+		VkSampler getSampler(const VkSamplerCreateInfo& createInfo);
+
+		// Trilinear, repeating, with as much anisotropy as the device allows, covering mipLevels mip levels
+		VkSamplerCreateInfo defaultSamplerInfo(uint32_t mipLevels) const;
+
+		size_t size() const;
+
+	private:
+		struct SamplerKeyHash {
+			size_t operator()(const VkSamplerCreateInfo& info) const;
+		};
+		struct SamplerKeyEqual {
+			bool operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const;
+		};
+
+		VulkanDevice& vulkanDevice;
+		std::unordered_map<VkSamplerCreateInfo, VkSampler, SamplerKeyHash, SamplerKeyEqual> samplers;
+		mutable std::mutex mutex;
+	};
+
+}
@@ -10,14 +10,23 @@
 
 namespace VulkanSandbox {
 
-	VulkanSwapChain::VulkanSwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent)
-		: device{ deviceRef }, windowExtent{ windowExtent }
+	VulkanSwapChain::VulkanSwapChain(
+		VulkanDevice& deviceRef,
+		VulkanFrameSync& frameSync,
+		VkExtent2D windowExtent,
+		const PresentSettings& presentSettings)
+		: device{ deviceRef }, frameSync{ frameSync }, windowExtent{ windowExtent }, presentSettings{ presentSettings }
 	{
 		init();
 	}
 
-	VulkanSwapChain::VulkanSwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<VulkanSwapChain> previousSwapChain)
-		: device{ deviceRef }, windowExtent{ windowExtent }, oldSwapChain{ previousSwapChain }
+	VulkanSwapChain::VulkanSwapChain(
+		VulkanDevice& deviceRef,
+		VulkanFrameSync& frameSync,
+		VkExtent2D windowExtent,
+		std::shared_ptr<VulkanSwapChain> previousSwapChain,
+		const PresentSettings& presentSettings)
+		: device{ deviceRef }, frameSync{ frameSync }, windowExtent{ windowExtent }, presentSettings{ presentSettings }, oldSwapChain{ previousSwapChain }
 	{
 		init();
 		oldSwapChain = nullptr;
@@ -25,7 +34,11 @@ namespace VulkanSandbox {
 
 	void VulkanSwapChain::init()
 	{
-		createSwapChain();
+		presentTimed = device.supportsPresentWait() && !isHeadless();
+		if (isHeadless())
+			createOffscreenImages();
+		else
+			createSwapChain();
 		createImageViews();
 		createRenderPass();
 		createDepthResources();
@@ -44,39 +57,52 @@ namespace VulkanSandbox {
 			swapChain = nullptr;
 		}
 
+		for (size_t i = 0; i < offscreenImageAllocations.size(); i++) {
+			device.destroyImage(swapChainImages[i], offscreenImageAllocations[i]);
+		}
+
 		for (int i = 0; i < depthImages.size(); i++) {
 			vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-			vkDestroyImage(device.device(), depthImages[i], nullptr);
-			vkFreeMemory(device.device(), depthImageMemories[i], nullptr);
+			device.destroyImage(depthImages[i], depthImageAllocations[i]);
 		}
 
 		for (auto framebuffer : swapChainFramebuffers) {
 			vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
 		}
 
-		vkDestroyRenderPass(device.device(), renderPass, nullptr);
-
 		// cleanup synchronization objects
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
 			vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device.device(), inFlightFences[i], nullptr);
+		}
+
+		if (latencyQueryPool != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(
+				device.device(),
+				device.getCommandPool(),
+				static_cast<uint32_t>(latencyCommandBuffers.size()),
+				latencyCommandBuffers.data());
+			vkDestroyQueryPool(device.device(), latencyQueryPool, nullptr);
 		}
 	}
 
 	VkResult VulkanSwapChain::acquireNextImage(uint32_t* imageIndex) {
-		vkWaitForFences(
-			device.device(),
-			1,
-			&inFlightFences[currentFrame],
-			VK_TRUE,
-			std::numeric_limits<uint64_t>::max());
+		// The only CPU wait of a frame, and only when the GPU is framesInFlight frames behind
+		frameSync.waitForFrameSlot();
+		recordFrameLatency(getCurrentFrame());
+
+		if (isHeadless()) {
+			// Offscreen images are always available, just hand them out round-robin
+			*imageIndex = nextOffscreenImage;
+			nextOffscreenImage = (nextOffscreenImage + 1) % static_cast<uint32_t>(imageCount());
+			return VK_SUCCESS;
+		}
 
 		VkResult result = vkAcquireNextImageKHR(
 			device.device(),
 			swapChain,
 			std::numeric_limits<uint64_t>::max(),
-			imageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
+			imageAvailableSemaphores[getCurrentFrame()],  // must be a not signaled semaphore
 			VK_NULL_HANDLE,
 			imageIndex);
 
@@ -84,36 +110,50 @@ namespace VulkanSandbox {
 	}
 
 	VkResult VulkanSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-		if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+		// With more frames in flight than images (or images acquired out of order) the image may still be
+		// rendered to by an earlier frame, which the frame value it was last used with tells
+		frameSync.waitForValue(imageFrameValues[*imageIndex]);
+		imageFrameValues[*imageIndex] = frameSync.getFrameValue();
+
+		const size_t frameIndex = getCurrentFrame();
+		const uint64_t frameValue = frameSync.getFrameValue();
+		if (!presentTimed) {
+			latencyValues[frameIndex] = frameValue;
 		}
-		imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
-
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
+		// The frame's own command buffer, followed by the slot's end of frame timestamp when latency is GPU timed
+		const bool gpuTimed = hasGpuTimedLatency();
+		const VkCommandBuffer frameBuffers[2] = { buffers[0], gpuTimed ? latencyCommandBuffers[frameIndex] : VK_NULL_HANDLE };
+		const uint32_t frameBufferCount = gpuTimed ? 2 : 1;
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = buffers;
+		// Read just before the submit, so the frame can't have finished before its start was taken
+		if (gpuTimed) {
+			if (device.getDeviceTimestamp(&submitTimestamps[frameIndex]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to read the GPU timestamp at submit!");
+		}
+		else {
+			submitTimes[frameIndex] = std::chrono::steady_clock::now();
+		}
 
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+		if (isHeadless()) {
+			// No acquire/present to synchronize with, the frame value alone tracks the frame
+			frameSync.submitFrame(frameBuffers, frameBufferCount, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+			pollFrameLatencies();
+			return VK_SUCCESS;
+		}
 
-		vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-		if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-			throw std::runtime_error("Failed to submit draw command buffer!");
+		frameSync.submitFrame(
+			frameBuffers,
+			frameBufferCount,
+			imageAvailableSemaphores[frameIndex],
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			renderFinishedSemaphores[frameIndex]);
 
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		presentInfo.pWaitSemaphores = &renderFinishedSemaphores[frameIndex];
 
 		VkSwapchainKHR swapChains[] = { swapChain };
 		presentInfo.swapchainCount = 1;
@@ -121,21 +161,126 @@ namespace VulkanSandbox {
 
 		presentInfo.pImageIndices = imageIndex;
 
-		auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+		// The frame value doubles as the present id, it only ever counts up
+		VkPresentIdKHR presentId{};
+		presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentId.swapchainCount = 1;
+		presentId.pPresentIds = &frameValue;
+		if (presentTimed) {
+			presentInfo.pNext = &presentId;
+		}
+
+		VkResult result;
+		{
+			std::lock_guard<std::mutex> lock{ device.queueMutex() };
+			result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+		}
 
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		// A present that failed never completes, so there would be nothing to wait for
+		if (presentTimed && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+			// Only ever more than a couple when presents stop completing (eg. a hidden window), keep the newest
+			if (pendingPresents.size() >= MAX_PENDING_PRESENTS) {
+				pendingPresents.pop_front();
+			}
+			pendingPresents.emplace_back(frameValue, submitTimes[frameIndex]);
+			lastPresentId = frameValue;
+		}
+
+		pollFrameLatencies();
 
 		return result;
 	}
 
+	void VulkanSwapChain::pollFrameLatencies() {
+		if (presentTimed) {
+			recordPresentLatencies();
+			return;
+		}
+
+		// Catch the earlier frames that finished while this one was recorded, rather than only when their
+		// slot comes around again, which keeps the latency samples within about a frame of the real thing
+		for (size_t i = 0; i < latencyValues.size(); i++) {
+			recordFrameLatency(i);
+		}
+	}
+
+	void VulkanSwapChain::waitForLastSubmittedFrame() {
+		// The present is what the user sees, so that's what to wait for when it can be observed. The timeout
+		// only guards against a present that never completes, the frame is then waited for as without it.
+		if (presentTimed && lastPresentId != 0 &&
+			device.waitForPresent(swapChain, lastPresentId, PRESENT_WAIT_TIMEOUT) == VK_SUCCESS) {
+			recordPresentLatencies();
+			return;
+		}
+
+		const uint64_t lastValue = frameSync.getLastSubmittedValue();
+		frameSync.waitForValue(lastValue);
+		for (size_t i = 0; i < latencyValues.size(); i++) {
+			if (latencyValues[i] == lastValue) {
+				recordFrameLatency(i);
+			}
+		}
+	}
+
+	void VulkanSwapChain::recordFrameLatency(size_t frameIndex) {
+		if (latencyValues[frameIndex] == 0 || !frameSync.isComplete(latencyValues[frameIndex])) {
+			return;
+		}
+
+		latencyValues[frameIndex] = 0;
+
+		if (!hasGpuTimedLatency()) {
+			frameLatencies.push_back(
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitTimes[frameIndex]).count());
+			return;
+		}
+
+		// The frame is done, so its end of frame timestamp is available
+		uint64_t endTimestamp = 0;
+		if (vkGetQueryPoolResults(
+			device.device(),
+			latencyQueryPool,
+			static_cast<uint32_t>(frameIndex),
+			1,
+			sizeof(endTimestamp),
+			&endTimestamp,
+			sizeof(endTimestamp),
+			VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+
+		const uint64_t ticks = (endTimestamp - submitTimestamps[frameIndex]) & timestampMask;
+		frameLatencies.push_back(static_cast<double>(ticks) * timestampPeriod / 1000000.0);
+	}
+
+	void VulkanSwapChain::recordPresentLatencies() {
+		while (!pendingPresents.empty()) {
+			if (device.waitForPresent(swapChain, pendingPresents.front().first, 0) != VK_SUCCESS) {
+				return;
+			}
+
+			frameLatencies.push_back(
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pendingPresents.front().second).count());
+			pendingPresents.pop_front();
+		}
+	}
+
+	std::vector<double> VulkanSwapChain::takeFrameLatencies() {
+		std::vector<double> latencies;
+		latencies.swap(frameLatencies);
+		return latencies;
+	}
+
 	void VulkanSwapChain::createSwapChain() {
 		SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+		presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		uint32_t imageCount = presentSettings.imageCount > 0 ?
+			std::max(presentSettings.imageCount, swapChainSupport.capabilities.minImageCount) :
+			swapChainSupport.capabilities.minImageCount + 1;
 		if (swapChainSupport.capabilities.maxImageCount > 0 &&
 			imageCount > swapChainSupport.capabilities.maxImageCount) {
 			imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -190,6 +335,44 @@ namespace VulkanSandbox {
 		swapChainExtent = extent;
 	}
 
+	void VulkanSwapChain::createOffscreenImages() {
+		swapChainImageFormat = device.findSupportedFormat(
+			{ VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+		swapChainExtent = windowExtent;
+
+		// Same image count a swap chain would typically give us (minImageCount + 1), unless asked otherwise
+		const uint32_t imageCount = presentSettings.imageCount > 0 ? presentSettings.imageCount : frameSync.getFramesInFlight() + 1;
+		swapChainImages.resize(imageCount);
+		offscreenImageAllocations.resize(imageCount);
+
+		for (uint32_t i = 0; i < imageCount; i++) {
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = swapChainExtent.width;
+			imageInfo.extent.height = swapChainExtent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = swapChainImageFormat;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// Transfer source so finished frames can be copied back to the host
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.flags = 0;
+
+			device.createImageWithInfo(
+				imageInfo,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				swapChainImages[i],
+				offscreenImageAllocations[i]);
+		}
+	}
+
 	void VulkanSwapChain::createImageViews() {
 		swapChainImageViews.resize(swapChainImages.size());
 		for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -210,63 +393,18 @@ namespace VulkanSandbox {
 	}
 
 	void VulkanSwapChain::createRenderPass() {
-		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format = findDepthFormat();
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference depthAttachmentRef{};
-		depthAttachmentRef.attachment = 1;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = getSwapChainImageFormat();
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentReference colorAttachmentRef = {};
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.srcAccessMask = 0;
-		dependency.srcStageMask =
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstSubpass = 0;
-		dependency.dstStageMask =
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask =
-			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		renderPassInfo.pAttachments = attachments.data();
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-
-		if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create render pass!");
+		VkFormat depthFormat = findDepthFormat();
+		// PRESENT_SRC_KHR is only valid with the swap chain extension enabled
+		VkImageLayout colourFinalLayout = isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		// A resize almost never changes the surface format, so the previous render pass (and the pipelines 
+		// built against it) can usually be carried over as is
+		if (oldSwapChain != nullptr && oldSwapChain->renderPass->matches(getSwapChainImageFormat(), depthFormat, colourFinalLayout)) {
+			renderPass = oldSwapChain->renderPass;
+			return;
+		}
+
+		renderPass = std::make_shared<VulkanRenderPass>(device, getSwapChainImageFormat(), depthFormat, colourFinalLayout);
 	}
 
 	void VulkanSwapChain::createFramebuffers() {
@@ -277,7 +415,7 @@ namespace VulkanSandbox {
 			VkExtent2D swapChainExtent = getSwapChainExtent();
 			VkFramebufferCreateInfo framebufferInfo = {};
 			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass;
+			framebufferInfo.renderPass = renderPass->getRenderPass();
 			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 			framebufferInfo.pAttachments = attachments.data();
 			framebufferInfo.width = swapChainExtent.width;
@@ -294,7 +432,7 @@ namespace VulkanSandbox {
 		VkExtent2D swapChainExtent = getSwapChainExtent();
 
 		depthImages.resize(imageCount());
-		depthImageMemories.resize(imageCount());
+		depthImageAllocations.resize(imageCount());
 		depthImageViews.resize(imageCount());
 
 		for (int i = 0; i < depthImages.size(); i++) {
@@ -318,7 +456,7 @@ namespace VulkanSandbox {
 				imageInfo,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				depthImages[i],
-				depthImageMemories[i]);
+				depthImageAllocations[i]);
 
 			VkImageViewCreateInfo viewInfo{};
 			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -337,24 +475,68 @@ namespace VulkanSandbox {
 	}
 
 	void VulkanSwapChain::createSyncObjects() {
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+		// Binary semaphores for acquire and present (which can't take timeline semaphores), one per frame slot.
+		// Everything else is tracked through frameSync's frame values.
+		const uint32_t framesInFlight = frameSync.getFramesInFlight();
+		imageAvailableSemaphores.resize(framesInFlight);
+		renderFinishedSemaphores.resize(framesInFlight);
+		imageFrameValues.assign(imageCount(), 0);
+		submitTimes.resize(framesInFlight);
+		latencyValues.assign(framesInFlight, 0);
 
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo = {};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		for (size_t i = 0; i < framesInFlight; i++) {
 			if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+				vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS)
 				throw std::runtime_error("Failed to create synchronization objects for a frame!");
 		}
+
+		createLatencyQueries();
+	}
+
+	void VulkanSwapChain::createLatencyQueries() {
+		// Presents are timed on the CPU clock. Otherwise, without a GPU timestamp to compare against at submit,
+		// the GPU completion latency falls back to the CPU clock too.
+		if (presentTimed || !device.supportsCalibratedTimestamps()) {
+			return;
+		}
+
+		const uint32_t framesInFlight = frameSync.getFramesInFlight();
+		const uint32_t validBits = device.graphicsQueueTimestampValidBits();
+		timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+		timestampPeriod = device.properties.limits.timestampPeriod;
+		submitTimestamps.assign(framesInFlight, 0);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = framesInFlight;
+		if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &latencyQueryPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create the frame latency query pool!");
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = device.getCommandPool();
+		allocInfo.commandBufferCount = framesInFlight;
+		latencyCommandBuffers.resize(framesInFlight);
+		if (vkAllocateCommandBuffers(device.device(), &allocInfo, latencyCommandBuffers.data()) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate the frame latency command buffers!");
+
+		// Recorded once and submitted after every frame of their slot. A bottom of pipe timestamp is only
+		// written once everything submitted before it is done, ie. when the frame finishes on the GPU.
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			if (vkBeginCommandBuffer(latencyCommandBuffers[i], &beginInfo) != VK_SUCCESS)
+				throw std::runtime_error("Failed to begin recording a frame latency command buffer!");
+			vkCmdResetQueryPool(latencyCommandBuffers[i], latencyQueryPool, i, 1);
+			vkCmdWriteTimestamp(latencyCommandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, latencyQueryPool, i);
+			if (vkEndCommandBuffer(latencyCommandBuffers[i]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to record a frame latency command buffer!");
+		}
 	}
 
 	VkSurfaceFormatKHR VulkanSwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -369,26 +551,37 @@ namespace VulkanSandbox {
 	}
 
 	VkPresentModeKHR VulkanSwapChain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-		// Default to Mailbox present mode
+		// Mailbox (the default) replaces the queued image with every new one, so it never blocks but still
+		// doesn't tear. Immediate presents straight away and may tear, FIFO relaxed only tears when a frame
+		// misses its vblank.
 		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				std::cout << "Present mode: Mailbox" << std::endl;
+			if (availablePresentMode == presentSettings.presentMode) {
+				std::cout << "Present mode: " << presentModeName(availablePresentMode) << std::endl;
 				return availablePresentMode;
 			}
 		}
 
-		// for (const auto &availablePresentMode : availablePresentModes) {
-		//   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-		//     std::cout << "Present mode: Immediate" << std::endl;
-		//     return availablePresentMode;
-		//   }
-		// }
-
 		// Fallback to FIFO present mode (guaranteed to be supported)
-		std::cout << "Present mode: V-Sync" << std::endl;
+		if (presentSettings.presentMode != VK_PRESENT_MODE_FIFO_KHR) {
+			std::cout << "Present mode: " << presentModeName(presentSettings.presentMode) << " not supported, using ";
+		}
+		else {
+			std::cout << "Present mode: ";
+		}
+		std::cout << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << std::endl;
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
+	const char* VulkanSwapChain::presentModeName(VkPresentModeKHR presentMode) {
+		switch (presentMode) {
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "Immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "Mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "V-Sync";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "V-Sync (relaxed)";
+		default: return "Unknown";
+		}
+	}
+
 	VkExtent2D VulkanSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 		if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
 			return capabilities.currentExtent;
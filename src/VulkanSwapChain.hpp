@@ -1,9 +1,13 @@
 #pragma once
 
 #include "VulkanDevice.hpp"
+#include "VulkanFrameSync.hpp"
+#include "VulkanRenderPass.hpp"
 
 #include <vulkan/vulkan.h>
 
+#include <chrono>
+#include <deque>
 #include <string>
 #include <vector>
 #include <memory>
@@ -12,17 +16,36 @@ namespace VulkanSandbox {
 
 	class VulkanSwapChain {
 	public:
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-		VulkanSwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent);
-		VulkanSwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<VulkanSwapChain> previousSwapChain);
+		// How frames are handed to the presentation engine, see --present-mode and --swapchain-images
+		struct PresentSettings {
+			// Used when the surface supports it, otherwise FIFO (the only mode every surface has)
+			VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			// Images to ask for, clamped to what the surface allows. 0 asks for minImageCount + 1, which lets
+			// MAILBOX always have an image to render into while one is shown and one is queued.
+			uint32_t imageCount = 0;
+		};
+
+		// frameSync outlives the swap chain, frame values keep counting up across recreations
+		VulkanSwapChain(
+			VulkanDevice& deviceRef,
+			VulkanFrameSync& frameSync,
+			VkExtent2D windowExtent,
+			const PresentSettings& presentSettings);
+		VulkanSwapChain(
+			VulkanDevice& deviceRef,
+			VulkanFrameSync& frameSync,
+			VkExtent2D windowExtent,
+			std::shared_ptr<VulkanSwapChain> previousSwapChain,
+			const PresentSettings& presentSettings);
 		~VulkanSwapChain();
 
 		VulkanSwapChain(const VulkanSwapChain&) = delete;
 		VulkanSwapChain& operator=(const VulkanSwapChain&) = delete;
 
 		VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
-		VkRenderPass getRenderPass() { return renderPass; }
+		VkRenderPass getRenderPass() { return renderPass->getRenderPass(); }
+		// Shared with the previous/next swap chain whenever the attachment formats stay the same
+		std::shared_ptr<VulkanRenderPass> getSharedRenderPass() { return renderPass; }
 		VkImageView getImageView(int index) { return swapChainImageViews[index]; }
 		size_t imageCount() { return swapChainImages.size(); }
 		VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
@@ -35,46 +58,111 @@ namespace VulkanSandbox {
 		}
 		VkFormat findDepthFormat();
 
+		// In headless mode these cycle through offscreen images instead of acquiring/presenting swap chain images
 		VkResult acquireNextImage(uint32_t* imageIndex);
 		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
 
+		bool isHeadless() { return device.isHeadless(); }
+		// Slot of the frame in flight being prepared, ie. between acquireNextImage(..) and submitCommandBuffers(..)
+		size_t getCurrentFrame() { return frameSync.getFrameIndex(); }
+		// What the surface actually gave us, which may differ from PresentSettings (always FIFO when headless)
+		VkPresentModeKHR getPresentMode() { return presentMode; }
+		static const char* presentModeName(VkPresentModeKHR presentMode);
+
+		// Blocks until the last submitted frame has been presented. Sampling input after this (--low-latency)
+		// means no frame is queued ahead of the one it goes into. With hasPresentTimedLatency() that is
+		// vkWaitForPresentKHR on the frame's present id. Without it the present can't be observed, and this
+		// only waits until the frame has finished rendering and its present can go ahead.
+		void waitForLastSubmittedFrame();
+		// Latency in milliseconds of every frame found finished since the last call, starting just before
+		// vkQueueSubmit.
+		// With hasPresentTimedLatency() it ends when vkWaitForPresentKHR reports the frame's present done, ie.
+		// submit to present. Presents are only checked when waited on (--low-latency) or after the next
+		// submit, so otherwise a sample can run up to one frame long.
+		// Without it the sample is submit to GPU completion instead. With hasGpuTimedLatency() both ends are read
+		// off the GPU's timestamp clock, the start through VK_EXT_calibrated_timestamps and the end by a
+		// timestamp written after the frame's commands. Otherwise the end is when the CPU first saw the frame
+		// done, which has the same up to a frame delay as the presents.
+		std::vector<double> takeFrameLatencies();
+		bool hasPresentTimedLatency() const { return presentTimed; }
+		bool hasGpuTimedLatency() const { return latencyQueryPool != VK_NULL_HANDLE; }
+
 	private:
 		void init();
 		void createSwapChain();
+		void createOffscreenImages();
 		void createImageViews();
 		void createDepthResources();
 		void createRenderPass();
 		void createFramebuffers();
 		void createSyncObjects();
+		void createLatencyQueries();
 
 		// Helper functions
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 		VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 		VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+		// Adds the latency sample of every frame that finished since the last poll
+		void pollFrameLatencies();
+		// Adds the latency sample of the frame slot's last frame if it finished
+		void recordFrameLatency(size_t frameIndex);
+		// Adds the latency samples of the presents that are done, oldest first
+		void recordPresentLatencies();
 
 		VkFormat swapChainImageFormat;
 		VkExtent2D swapChainExtent;
 
 		std::vector<VkFramebuffer> swapChainFramebuffers;
-		VkRenderPass renderPass;
+		std::shared_ptr<VulkanRenderPass> renderPass;
 
 		std::vector<VkImage>		depthImages;
-		std::vector<VkDeviceMemory> depthImageMemories;
+		std::vector<VulkanAllocation> depthImageAllocations;
 		std::vector<VkImageView>	depthImageViews;
 		std::vector<VkImage>		swapChainImages;
 		std::vector<VkImageView>	swapChainImageViews;
 
 		VulkanDevice& device;
+		VulkanFrameSync& frameSync;
 		VkExtent2D windowExtent;
+		PresentSettings presentSettings;
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
-		VkSwapchainKHR swapChain;
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 		std::shared_ptr<VulkanSwapChain> oldSwapChain;
 
+		// Headless mode only, the swap chain owns these images rather than the presentation engine
+		std::vector<VulkanAllocation> offscreenImageAllocations;
+		uint32_t nextOffscreenImage = 0;
+
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
-		std::vector<VkFence> imagesInFlight;
-		size_t currentFrame = 0;
+		// Per image, the value of the last frame that rendered to it (0 for none)
+		std::vector<uint64_t> imageFrameValues;
+
+		// Per frame slot, when its last frame was submitted and that frame's value while its latency still
+		// has to be measured (0 otherwise)
+		std::vector<std::chrono::steady_clock::time_point> submitTimes;
+		std::vector<uint64_t> latencyValues;
+		std::vector<double> frameLatencies;
+
+		// Presents not yet seen done before the oldest one's sample is given up on
+		static constexpr size_t MAX_PENDING_PRESENTS = 8;
+		// How long waitForLastSubmittedFrame() waits for a present (1s) before waiting for the frame instead
+		static constexpr uint64_t PRESENT_WAIT_TIMEOUT = 1000000000;
+
+		// Present timed latency only. Each successful present's id (the frame's value) and submit time, oldest
+		// first, until the present is seen done. Presents complete in order, so only the front needs checking.
+		bool presentTimed = false;
+		std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> pendingPresents;
+		uint64_t lastPresentId = 0;
+
+		// GPU timed latency only. Per frame slot, the GPU timestamp read at submit and a command buffer that
+		// writes the slot's end of frame timestamp into latencyQueryPool.
+		VkQueryPool latencyQueryPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> latencyCommandBuffers;
+		std::vector<uint64_t> submitTimestamps;
+		uint64_t timestampMask = ~0ull;
+		float timestampPeriod = 1.0f;
 	};
 
 }
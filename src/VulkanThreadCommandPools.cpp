@@ -0,0 +1,67 @@
+#include "VulkanThreadCommandPools.hpp"
+
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	VulkanThreadCommandPools::VulkanThreadCommandPools(VulkanDevice& device, uint32_t threadCount, uint32_t framesInFlight)
+		: vulkanDevice(device), threadCount(threadCount)
+	{
+		QueueFamilyIndices queueFamilyIndices = vulkanDevice.findPhysicalQueueFamilies();
+
+		pools.resize(threadCount * framesInFlight);
+		for (ThreadPool& pool : pools)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // re-recorded every frame, reset as a whole
+
+			if (vkCreateCommandPool(vulkanDevice.device(), &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create thread command pool!");
+		}
+	}
+
+	VulkanThreadCommandPools::~VulkanThreadCommandPools()
+	{
+		// Destroying a pool frees all of its command buffers
+		for (ThreadPool& pool : pools)
+			vkDestroyCommandPool(vulkanDevice.device(), pool.commandPool, nullptr);
+	}
+
+	void VulkanThreadCommandPools::resetFrame(uint32_t frameIndex)
+	{
+		for (uint32_t thread = 0; thread < threadCount; thread++)
+		{
+			ThreadPool& pool = getPool(frameIndex, thread);
+			if (pool.usedCount == 0)
+				continue;
+
+			vkResetCommandPool(vulkanDevice.device(), pool.commandPool, 0);
+			pool.usedCount = 0;
+		}
+	}
+
+	VkCommandBuffer VulkanThreadCommandPools::acquireSecondary(uint32_t frameIndex, uint32_t threadIndex)
+	{
+		ThreadPool& pool = getPool(frameIndex, threadIndex);
+
+		// Buffers stay allocated across frames, only grow the pool when a thread records more than before
+		if (pool.usedCount == pool.secondaryBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = pool.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate secondary command buffer!");
+			pool.secondaryBuffers.push_back(commandBuffer);
+		}
+
+		return pool.secondaryBuffers[pool.usedCount++];
+	}
+
+}
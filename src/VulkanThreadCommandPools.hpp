@@ -0,0 +1,41 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// One VkCommandPool per worker thread per frame in flight, for recording secondary command buffers in parallel.
+	// Command pools must only be used from one thread at a time, so every thread gets its own, and resetting a
+	// whole pool once the frame's fence has signalled is much cheaper than freeing/resetting buffers one by one.
+	class VulkanThreadCommandPools {
+
+	public:
+		VulkanThreadCommandPools(VulkanDevice& device, uint32_t threadCount, uint32_t framesInFlight);
+		~VulkanThreadCommandPools();
+
+		VulkanThreadCommandPools(const VulkanThreadCommandPools&) = delete;
+		VulkanThreadCommandPools& operator=(const VulkanThreadCommandPools&) = delete;
+
+		// Recycles every buffer handed out for this frame slot, the slot's last frame must have been waited on
+		void resetFrame(uint32_t frameIndex);
+
+		// Returns a secondary command buffer from the given thread's pool, only call from that thread
+		VkCommandBuffer acquireSecondary(uint32_t frameIndex, uint32_t threadIndex);
+
+	private:
+		struct ThreadPool {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> secondaryBuffers;
+			uint32_t usedCount = 0;
+		};
+
+		ThreadPool& getPool(uint32_t frameIndex, uint32_t threadIndex) { return pools[frameIndex * threadCount + threadIndex]; }
+
+		VulkanDevice& vulkanDevice;
+		uint32_t threadCount;
+		std::vector<ThreadPool> pools;
+	};
+
+}
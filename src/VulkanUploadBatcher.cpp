@@ -0,0 +1,301 @@
+#include "VulkanUploadBatcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace VulkanSandbox {
+
+	// Staging offsets are kept aligned for vkCmdCopyBufferToImage (a multiple of the texel size and of 4)
+	static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	VulkanUploadBatcher::VulkanUploadBatcher(VulkanDevice& device, VkDeviceSize batchSize, double maxBatchMilliseconds)
+		: vulkanDevice(device), batchSize(batchSize), maxBatchMilliseconds(maxBatchMilliseconds)
+	{
+		QueueFamilyIndices queueFamilyIndices = vulkanDevice.findPhysicalQueueFamilies();
+
+		batches.resize(BATCHES_IN_FLIGHT);
+		for (Batch& batch : batches)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // re-recorded for every batch, reset as a whole
+			if (vkCreateCommandPool(vulkanDevice.device(), &poolInfo, nullptr, &batch.commandPool) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create upload batcher command pool!");
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = batch.commandPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to allocate upload batcher command buffer!");
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			if (vkCreateFence(vulkanDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create upload batcher fence!");
+
+			// Persistently mapped, so staging an upload is just a memcpy
+			vulkanDevice.createBuffer(
+				batchSize,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				batch.stagingBuffer,
+				batch.stagingAllocation);
+		}
+
+		openBatch().ticket = nextTicket++;
+	}
+
+	VulkanUploadBatcher::~VulkanUploadBatcher()
+	{
+		waitIdle();
+
+		for (Batch& batch : batches)
+		{
+			vulkanDevice.destroyBuffer(batch.stagingBuffer, batch.stagingAllocation);
+			vkDestroyFence(vulkanDevice.device(), batch.fence, nullptr);
+			vkDestroyCommandPool(vulkanDevice.device(), batch.commandPool, nullptr);
+		}
+	}
+
+	VulkanUploadBatcher::Ticket VulkanUploadBatcher::uploadBuffer(
+		VkBuffer dstBuffer,
+		VkDeviceSize dstOffset,
+		const void* data,
+		VkDeviceSize size,
+		VkAccessFlags dstAccess,
+		VkPipelineStageFlags dstStage)
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceSize stagingOffset;
+		Batch& batch = stage(data, size, stagingBuffer, stagingOffset);
+
+		batch.bufferCopies.push_back(BufferCopy{ stagingBuffer, dstBuffer, VkBufferCopy{ stagingOffset, dstOffset, size } });
+		batch.dstAccess |= dstAccess;
+		batch.dstStages |= dstStage;
+		return batch.ticket;
+	}
+
+	VulkanUploadBatcher::Ticket VulkanUploadBatcher::uploadImage(const Texture::UploadedImage& image, const void* pixels, VkDeviceSize size)
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceSize stagingOffset;
+		Batch& batch = stage(pixels, size, stagingBuffer, stagingOffset);
+
+		batch.imageUploads.push_back(ImageUpload{ image, stagingBuffer, stagingOffset });
+		return batch.ticket;
+	}
+
+	VulkanUploadBatcher::Batch& VulkanUploadBatcher::stage(
+		const void* data,
+		VkDeviceSize size,
+		VkBuffer& stagingBuffer,
+		VkDeviceSize& stagingOffset)
+	{
+		stats.uploadCount++;
+		stats.bytesUploaded += size;
+
+		if (size > batchSize)
+		{
+			// Doesn't fit any staging buffer, it still rides along with the open batch's submission though
+			Batch& batch = openBatch();
+			if (batch.empty())
+				batch.openedAt = std::chrono::steady_clock::now();
+
+			VulkanAllocation allocation;
+			vulkanDevice.createBuffer(
+				size,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				stagingBuffer,
+				allocation);
+			memcpy(allocation.mapped, data, static_cast<size_t>(size));
+			batch.oversizedStaging.emplace_back(stagingBuffer, allocation);
+			stagingOffset = 0;
+			return batch;
+		}
+
+		VkDeviceSize alignedOffset = (openBatch().stagingUsed + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		if (alignedOffset + size > batchSize)
+		{
+			stats.sizeFlushes++;
+			flush();
+			alignedOffset = 0;
+		}
+
+		Batch& batch = openBatch();
+		if (batch.empty())
+			batch.openedAt = std::chrono::steady_clock::now();
+
+		memcpy(static_cast<char*>(batch.stagingAllocation.mapped) + alignedOffset, data, static_cast<size_t>(size));
+		batch.stagingUsed = alignedOffset + size;
+		stagingBuffer = batch.stagingBuffer;
+		stagingOffset = alignedOffset;
+		return batch;
+	}
+
+	void VulkanUploadBatcher::flush()
+	{
+		Batch& batch = openBatch();
+		if (batch.empty())
+			return;
+
+		recordBatch(batch);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		{
+			std::lock_guard<std::mutex> lock{ vulkanDevice.queueMutex() };
+			if (vkQueueSubmit(vulkanDevice.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit upload batch!");
+		}
+		batch.submitted = true;
+		stats.batchCount++;
+
+		openNextBatch();
+	}
+
+	void VulkanUploadBatcher::recordBatch(Batch& batch)
+	{
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		if (!batch.bufferCopies.empty())
+		{
+			// Every region going from one buffer into another becomes a single vkCmdCopyBuffer
+			std::stable_sort(batch.bufferCopies.begin(), batch.bufferCopies.end(), [](const BufferCopy& a, const BufferCopy& b) {
+				return a.srcBuffer != b.srcBuffer ? a.srcBuffer < b.srcBuffer : a.dstBuffer < b.dstBuffer;
+			});
+
+			std::vector<VkBufferCopy> regions;
+			for (size_t first = 0; first < batch.bufferCopies.size();)
+			{
+				const BufferCopy& copy = batch.bufferCopies[first];
+				size_t end = first;
+				regions.clear();
+				while (end < batch.bufferCopies.size() &&
+					batch.bufferCopies[end].srcBuffer == copy.srcBuffer &&
+					batch.bufferCopies[end].dstBuffer == copy.dstBuffer)
+				{
+					regions.push_back(batch.bufferCopies[end].region);
+					end++;
+				}
+
+				vkCmdCopyBuffer(batch.commandBuffer, copy.srcBuffer, copy.dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+				first = end;
+			}
+
+			// One barrier covers every copy in the batch
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = batch.dstAccess;
+			const VkPipelineStageFlags dstStages = batch.dstStages != 0 ?
+				batch.dstStages : VkPipelineStageFlags{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT };
+			vkCmdPipelineBarrier(batch.commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0,
+				1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		for (const ImageUpload& upload : batch.imageUploads)
+		{
+			Texture::recordUpload(batch.commandBuffer, upload.stagingBuffer, upload.stagingOffset, upload.image);
+			Texture::recordMipmapGeneration(batch.commandBuffer, upload.image);
+		}
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record upload batch!");
+	}
+
+	void VulkanUploadBatcher::update()
+	{
+		Batch& batch = openBatch();
+		if (!batch.empty())
+		{
+			const double openMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batch.openedAt).count();
+			if (openMilliseconds >= maxBatchMilliseconds)
+			{
+				stats.timeFlushes++;
+				flush();
+			}
+		}
+
+		retireFinishedBatches();
+	}
+
+	bool VulkanUploadBatcher::isComplete(Ticket ticket)
+	{
+		if (ticket > completedTicket)
+			retireFinishedBatches();
+		return ticket <= completedTicket;
+	}
+
+	void VulkanUploadBatcher::wait(Ticket ticket)
+	{
+		if (ticket == openBatch().ticket)
+			flush();
+
+		for (Batch& batch : batches)
+		{
+			if (batch.submitted && batch.ticket <= ticket)
+				retire(batch);
+		}
+	}
+
+	void VulkanUploadBatcher::waitIdle()
+	{
+		flush();
+		for (Batch& batch : batches)
+			retire(batch);
+	}
+
+	void VulkanUploadBatcher::retire(Batch& batch)
+	{
+		if (!batch.submitted)
+			return;
+
+		vkWaitForFences(vulkanDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(vulkanDevice.device(), 1, &batch.fence);
+		vkResetCommandPool(vulkanDevice.device(), batch.commandPool, 0);
+
+		for (auto& staging : batch.oversizedStaging)
+			vulkanDevice.destroyBuffer(staging.first, staging.second);
+		batch.oversizedStaging.clear();
+		batch.bufferCopies.clear();
+		batch.imageUploads.clear();
+		batch.stagingUsed = 0;
+		batch.dstAccess = 0;
+		batch.dstStages = 0;
+		batch.submitted = false;
+
+		// A fence only signals once everything submitted to the queue before it is done as well
+		completedTicket = std::max(completedTicket, batch.ticket);
+	}
+
+	void VulkanUploadBatcher::retireFinishedBatches()
+	{
+		for (Batch& batch : batches)
+		{
+			if (batch.submitted && vkGetFenceStatus(vulkanDevice.device(), batch.fence) == VK_SUCCESS)
+				retire(batch);
+		}
+	}
+
+	void VulkanUploadBatcher::openNextBatch()
+	{
+		openBatchIndex = (openBatchIndex + 1) % BATCHES_IN_FLIGHT;
+
+		// Still in flight from BATCHES_IN_FLIGHT flushes ago, its staging buffer can't be written until it's done
+		retire(openBatch());
+		openBatch().ticket = nextTicket++;
+	}
+
+}
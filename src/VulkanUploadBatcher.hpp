@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Texture.hpp"
+#include "VulkanDevice.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace VulkanSandbox {
+
+	// Coalesces many small uploads into a few submissions. Data is copied into the open batch's staging buffer
+	// straight away and the GPU copies are recorded into a single command buffer when the batch is flushed: when
+	// its staging buffer is full, once it has been open longer than the time threshold (see update()), or when
+	// asked to. Compared to VulkanDevice::copyBuffer(..), which allocates a command buffer, submits it and waits
+	// for the queue to go idle on every call, loading a thousand models costs a handful of submissions instead
+	// of a thousand round trips. Submits to the graphics queue, use it from one thread only.
+	class VulkanUploadBatcher {
+
+	public:
+		static constexpr VkDeviceSize DEFAULT_BATCH_SIZE = 8 * 1024 * 1024;
+		static constexpr double DEFAULT_MAX_BATCH_MILLISECONDS = 2.0;
+		// One batch being filled while the previous one is copied on the GPU
+		static constexpr uint32_t BATCHES_IN_FLIGHT = 2;
+
+		// The batch an upload went into, the upload has finished once that batch's fence has signalled
+		using Ticket = uint64_t;
+
+		struct Stats {
+			uint64_t uploadCount = 0;
+			uint64_t batchCount = 0;		// submissions
+			uint64_t bytesUploaded = 0;
+			uint32_t sizeFlushes = 0;		// batches submitted because their staging buffer was full
+			uint32_t timeFlushes = 0;		// batches submitted because they had been open for too long
+		};
+
+		VulkanUploadBatcher(
+			VulkanDevice& device,
+			VkDeviceSize batchSize = DEFAULT_BATCH_SIZE,
+			double maxBatchMilliseconds = DEFAULT_MAX_BATCH_MILLISECONDS);
+		// Submits whatever is still open and waits for every batch to finish
+		~VulkanUploadBatcher();
+
+		VulkanUploadBatcher(const VulkanUploadBatcher&) = delete;
+		VulkanUploadBatcher& operator=(const VulkanUploadBatcher&) = delete;
+
+		// Copies size bytes of data into dstBuffer (which needs VK_BUFFER_USAGE_TRANSFER_DST_BIT) at dstOffset.
+		// Once complete the data is visible to dstAccess in dstStage on the graphics queue. Uploads within one
+		// batch may be reordered, so don't write the same bytes twice before waiting on the first ticket.
+		Ticket uploadBuffer(
+			VkBuffer dstBuffer,
+			VkDeviceSize dstOffset,
+			const void* data,
+			VkDeviceSize size,
+			VkAccessFlags dstAccess,
+			VkPipelineStageFlags dstStage);
+		// Uploads level 0 of an image made by Texture::createImage(..) and generates the rest of its mip chain,
+		// leaving every level in shader read layout once complete
+		Ticket uploadImage(const Texture::UploadedImage& image, const void* pixels, VkDeviceSize size);
+
+		// Submits the open batch, if anything was uploaded into it
+		void flush();
+		// Submits the open batch once it's older than the time threshold and recycles finished batches. Call it
+		// regularly (eg. once per frame) while uploads trickle in, so none of them wait around for company.
+		void update();
+		bool isComplete(Ticket ticket);
+		// Submits the ticket's batch if it's still open, then blocks until it has finished
+		void wait(Ticket ticket);
+		void waitIdle();
+
+		Stats getStats() const { return stats; }
+
+	private:
+		struct BufferCopy {
+			VkBuffer srcBuffer;
+			VkBuffer dstBuffer;
+			VkBufferCopy region;
+		};
+
+		struct ImageUpload {
+			Texture::UploadedImage image;
+			VkBuffer stagingBuffer;
+			VkDeviceSize stagingOffset;
+		};
+
+		struct Batch {
+			Ticket ticket = 0;
+			bool submitted = false;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+
+			VkBuffer stagingBuffer = VK_NULL_HANDLE;
+			VulkanAllocation stagingAllocation;
+			VkDeviceSize stagingUsed = 0;
+			// Uploads bigger than a whole staging buffer get one of their own, destroyed once the batch retires
+			std::vector<std::pair<VkBuffer, VulkanAllocation>> oversizedStaging;
+
+			std::vector<BufferCopy> bufferCopies;
+			std::vector<ImageUpload> imageUploads;
+			VkAccessFlags dstAccess = 0;
+			VkPipelineStageFlags dstStages = 0;
+			std::chrono::steady_clock::time_point openedAt;
+
+			bool empty() const { return bufferCopies.empty() && imageUploads.empty(); }
+		};
+
+		// Finds room for size bytes in the open batch (flushing it first if it's full) and copies data there
+		Batch& stage(const void* data, VkDeviceSize size, VkBuffer& stagingBuffer, VkDeviceSize& stagingOffset);
+		void recordBatch(Batch& batch);
+		// Waits for the batch's fence if it was submitted, then makes it reusable
+		void retire(Batch& batch);
+		void retireFinishedBatches();
+		// Moves on to the next batch slot once the open one has been submitted
+		void openNextBatch();
+		Batch& openBatch() { return batches[openBatchIndex]; }
+
+		VulkanDevice& vulkanDevice;
+		VkDeviceSize batchSize;
+		double maxBatchMilliseconds;
+
+		std::vector<Batch> batches;
+		uint32_t openBatchIndex = 0;
+		Ticket nextTicket = 1;
+		Ticket completedTicket = 0;	// every batch up to and including this one has finished
+		Stats stats;
+	};
+
+}
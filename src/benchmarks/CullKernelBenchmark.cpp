@@ -0,0 +1,130 @@
+// Microbenchmark for CullKernel::cullObjects(..) at each SIMD level, plus a check that every level keeps exactly
+// the same objects as the scalar path.
+//
+// Build (from the repository root) together with the kernels, eg.
+//   g++ -O2 -std=c++17 -Isrc src/benchmarks/CullKernelBenchmark.cpp src/SandboxCullKernel.cpp src/SandboxTransformKernel.cpp
+//   cl /O2 /std:c++17 /EHsc /Isrc src\benchmarks\CullKernelBenchmark.cpp src\SandboxCullKernel.cpp src\SandboxTransformKernel.cpp
+// Usage: CullKernelBenchmark [objectCount] [iterations] [gridSpan]
+
+#include "../SandboxCullKernel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace VulkanSandbox;
+
+using Clock = std::chrono::steady_clock;
+
+struct CullInput {
+	std::vector<glm::mat2> transforms;
+	std::vector<glm::vec2> translations;
+	std::vector<uint32_t> modelIndices;
+	std::vector<glm::vec4> modelExtents;
+};
+
+// Best of several runs, in nanoseconds per object. visibleCount is the result of the last run.
+static double timeCulling(
+	CullKernel::SimdLevel level,
+	const CullInput& input,
+	std::vector<uint32_t>& visibleIndices,
+	uint32_t& visibleCount,
+	int iterations)
+{
+	const size_t count = input.transforms.size();
+	double best = 1e300;
+	for (int run = 0; run < 5; run++)
+	{
+		auto start = Clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			visibleCount = CullKernel::cullObjects(
+				level,
+				input.transforms.data(),
+				input.translations.data(),
+				input.modelIndices.data(),
+				input.modelExtents.data(),
+				glm::vec2(-1.0f),
+				glm::vec2(1.0f),
+				visibleIndices.data(),
+				count);
+		}
+		double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		best = std::min(best, nanoseconds / (static_cast<double>(iterations) * count));
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t objectCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	const int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+	// Like --grid-span, objects are spread over this many times the view's size
+	const float gridSpan = argc > 3 ? static_cast<float>(std::atof(argv[3])) : 4.0f;
+
+	std::mt19937 random{ 1234 };
+	std::uniform_real_distribution<float> rotationDistribution{ -100.0f, 100.0f };
+	std::uniform_real_distribution<float> scaleDistribution{ 0.01f, 0.1f };
+	std::uniform_real_distribution<float> positionDistribution{ -gridSpan, gridSpan };
+
+	// A handful of models with different bounds, like --models
+	CullInput input;
+	input.modelExtents = {
+		glm::vec4(0.0f, 0.0f, 0.5f, 0.5f),
+		glm::vec4(0.0f, 0.0f, 0.35f, 0.5f),
+		glm::vec4(0.1f, -0.2f, 0.25f, 0.1f),
+		glm::vec4(0.0f, 0.0f, 0.5f, 0.25f),
+	};
+
+	std::vector<float> rotations(objectCount);
+	std::vector<glm::vec2> scales(objectCount);
+	input.transforms.resize(objectCount);
+	input.translations.resize(objectCount);
+	input.modelIndices.resize(objectCount);
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		rotations[i] = rotationDistribution(random);
+		scales[i] = glm::vec2(scaleDistribution(random), scaleDistribution(random));
+		input.translations[i] = glm::vec2(positionDistribution(random), positionDistribution(random));
+		input.modelIndices[i] = static_cast<uint32_t>(i % input.modelExtents.size());
+	}
+	TransformKernel::computeTransforms(rotations.data(), scales.data(), input.transforms.data(), objectCount);
+
+	CullKernel::SimdLevel detected = TransformKernel::detectSimdLevel();
+	std::cout << "Objects: " << objectCount << ", iterations: " << iterations << ", grid span: " << gridSpan
+		<< ", widest SIMD level: " << TransformKernel::simdLevelName(detected) << "\n";
+	std::cout << std::fixed << std::setprecision(3);
+
+	std::vector<uint32_t> scalarVisible(objectCount);
+	uint32_t scalarCount = 0;
+	double scalarTime = timeCulling(CullKernel::SimdLevel::Scalar, input, scalarVisible, scalarCount, iterations);
+	std::cout << "  scalar " << scalarTime << " ns/object, " << scalarCount << " visible ("
+		<< 100.0 * scalarCount / std::max<size_t>(objectCount, 1) << "%)\n";
+
+	struct Level { const char* name; CullKernel::SimdLevel level; };
+	const Level levels[] = {
+		{ "SSE2  ", CullKernel::SimdLevel::SSE2 },
+		{ "AVX2  ", CullKernel::SimdLevel::AVX2 },
+	};
+	for (const Level& level : levels)
+	{
+		if (detected == CullKernel::SimdLevel::Scalar ||
+			(level.level == CullKernel::SimdLevel::AVX2 && detected != CullKernel::SimdLevel::AVX2))
+			continue;
+
+		std::vector<uint32_t> visible(objectCount);
+		uint32_t visibleCount = 0;
+		double time = timeCulling(level.level, input, visible, visibleCount, iterations);
+		const bool matches = visibleCount == scalarCount &&
+			memcmp(visible.data(), scalarVisible.data(), visibleCount * sizeof(uint32_t)) == 0;
+		std::cout << "  " << level.name << " " << time << " ns/object, x" << scalarTime / time
+			<< (matches ? " (same objects as scalar)" : " (MISMATCH against scalar)") << "\n";
+	}
+
+	return 0;
+}
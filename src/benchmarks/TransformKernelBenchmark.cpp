@@ -0,0 +1,152 @@
+// Microbenchmark for TransformKernel::computeTransforms(..) against the std::sin/std::cos reference path,
+// plus the accuracy check behind the error bound documented in SandboxTransformKernel.hpp.
+//
+// Build (from the repository root) together with the kernel, eg.
+//   g++ -O2 -std=c++17 -Isrc src/benchmarks/TransformKernelBenchmark.cpp src/SandboxTransformKernel.cpp
+//   cl /O2 /std:c++17 /EHsc /Isrc src\benchmarks\TransformKernelBenchmark.cpp src\SandboxTransformKernel.cpp
+// Usage: TransformKernelBenchmark [objectCount] [iterations]
+
+#include "../SandboxTransformKernel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace VulkanSandbox;
+
+using Clock = std::chrono::steady_clock;
+using TransformFunction = void (*)(const float*, const glm::vec2*, glm::mat2*, size_t);
+
+// Best of several runs, in nanoseconds per object
+static double timeTransforms(
+	TransformFunction function,
+	const std::vector<float>& rotations,
+	const std::vector<glm::vec2>& scales,
+	std::vector<glm::mat2>& transforms,
+	int iterations)
+{
+	double best = 1e300;
+	for (int run = 0; run < 5; run++)
+	{
+		auto start = Clock::now();
+		for (int i = 0; i < iterations; i++)
+			function(rotations.data(), scales.data(), transforms.data(), rotations.size());
+		double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		best = std::min(best, nanoseconds / (static_cast<double>(iterations) * rotations.size()));
+	}
+	return best;
+}
+
+static double maxDifference(const std::vector<glm::mat2>& a, const std::vector<glm::mat2>& b)
+{
+	double difference = 0.0;
+	const float* aFloats = reinterpret_cast<const float*>(a.data());
+	const float* bFloats = reinterpret_cast<const float*>(b.data());
+	for (size_t i = 0; i < a.size() * 4; i++)
+		difference = std::max(difference, static_cast<double>(std::fabs(aFloats[i] - bFloats[i])));
+	return difference;
+}
+
+// The SIMD levels' polynomial one object at a time, what SimdLevel::Scalar would cost if it used it too
+static void polynomialTransforms(const float* rotations, const glm::vec2* scales, glm::mat2* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float s, c;
+		TransformKernel::sinCos(rotations[i], s, c);
+		float* outFloats = reinterpret_cast<float*>(&out[i]);
+		outFloats[0] = c * scales[i].x;
+		outFloats[1] = s * scales[i].x;
+		outFloats[2] = -s * scales[i].y;
+		outFloats[3] = c * scales[i].y;
+	}
+}
+
+static void scalarTransforms(const float* rotations, const glm::vec2* scales, glm::mat2* out, size_t count)
+{
+	TransformKernel::computeTransforms(TransformKernel::SimdLevel::Scalar, rotations, scales, out, count);
+}
+
+static void sse2Transforms(const float* rotations, const glm::vec2* scales, glm::mat2* out, size_t count)
+{
+	TransformKernel::computeTransforms(TransformKernel::SimdLevel::SSE2, rotations, scales, out, count);
+}
+
+static void avx2Transforms(const float* rotations, const glm::vec2* scales, glm::mat2* out, size_t count)
+{
+	TransformKernel::computeTransforms(TransformKernel::SimdLevel::AVX2, rotations, scales, out, count);
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t objectCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	const int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	// Accuracy of the sin/cos approximation over the range the error bound is documented for
+	double maxSinError = 0.0;
+	double maxCosError = 0.0;
+	for (double sweep = -8192.0; sweep <= 8192.0; sweep += 8192.0 / 3.0e6)
+	{
+		float x = static_cast<float>(sweep);
+		float s, c;
+		TransformKernel::sinCos(x, s, c);
+		maxSinError = std::max(maxSinError, std::fabs(s - std::sin(static_cast<double>(x))));
+		maxCosError = std::max(maxCosError, std::fabs(c - std::cos(static_cast<double>(x))));
+	}
+	std::cout << std::scientific << std::setprecision(3);
+	std::cout << "sinCos max abs error for |x| <= 8192: sin " << maxSinError << ", cos " << maxCosError << "\n";
+
+	std::mt19937 random{ 1234 };
+	std::uniform_real_distribution<float> rotationDistribution{ -100.0f, 100.0f };
+	std::uniform_real_distribution<float> scaleDistribution{ 0.1f, 2.0f };
+
+	std::vector<float> rotations(objectCount);
+	std::vector<glm::vec2> scales(objectCount);
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		rotations[i] = rotationDistribution(random);
+		scales[i] = glm::vec2(scaleDistribution(random), scaleDistribution(random));
+	}
+
+	std::vector<glm::mat2> reference(objectCount);
+	std::vector<glm::mat2> polynomial(objectCount);
+	std::vector<glm::mat2> transforms(objectCount);
+
+	TransformKernel::SimdLevel detected = TransformKernel::detectSimdLevel();
+	std::cout << "Objects: " << objectCount << ", iterations: " << iterations
+		<< ", widest SIMD level: " << TransformKernel::simdLevelName(detected) << "\n";
+	std::cout << std::fixed << std::setprecision(3);
+
+	double referenceTime = timeTransforms(TransformKernel::computeTransformsReference, rotations, scales, reference, iterations);
+	double polynomialTime = timeTransforms(polynomialTransforms, rotations, scales, polynomial, iterations);
+	double scalarTime = timeTransforms(scalarTransforms, rotations, scales, transforms, iterations);
+	std::cout << "  reference (std::sin/cos) " << referenceTime << " ns/object\n";
+	std::cout << "  scalar polynomial        " << polynomialTime << " ns/object, x" << referenceTime / polynomialTime << "\n";
+	std::cout << "  scalar                   " << scalarTime << " ns/object, x" << referenceTime / scalarTime
+		<< " (max difference to reference " << std::scientific << maxDifference(transforms, reference) << std::fixed << ")\n";
+
+	struct Level { const char* name; TransformFunction function; TransformKernel::SimdLevel level; };
+	const Level levels[] = {
+		{ "SSE2                     ", sse2Transforms, TransformKernel::SimdLevel::SSE2 },
+		{ "AVX2                     ", avx2Transforms, TransformKernel::SimdLevel::AVX2 },
+	};
+	for (const Level& level : levels)
+	{
+		if (detected == TransformKernel::SimdLevel::Scalar || 
+			(level.level == TransformKernel::SimdLevel::AVX2 && detected != TransformKernel::SimdLevel::AVX2))
+			continue;
+
+		double time = timeTransforms(level.function, rotations, scales, transforms, iterations);
+		std::cout << "  " << level.name << time << " ns/object, x" << referenceTime / time
+			<< " (max difference to scalar polynomial " << std::scientific << maxDifference(transforms, polynomial) << std::fixed << ")\n";
+	}
+
+	std::cout << std::scientific << "Max difference scalar polynomial vs reference: " << maxDifference(polynomial, reference) << "\n";
+	return 0;
+}
@@ -1,3 +1,4 @@
 C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\VertexShader.vert -o shaders\VertexShader.vert.spv
 C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\FragmentShader.frag -o shaders\FragmentShader.frag.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\CullInstances.comp -o shaders\CullInstances.comp.spv
 pause
\ No newline at end of file
@@ -1,12 +1,20 @@
 #include <stdexcept>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 
 #include "SandboxApp.hpp"
 
-int main() {
-	VulkanSandbox::SandboxApp app;
+int main(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--help") == 0) {
+			std::cout << VulkanSandbox::SandboxConfig::usage();
+			return EXIT_SUCCESS;
+		}
+	}
+
 	try {
+		VulkanSandbox::SandboxApp app{ VulkanSandbox::SandboxConfig::fromCommandLine(argc, argv) };
 		app.run();
 	} 
 	catch (const std::exception& e) {
@@ -1,13 +1,28 @@
 #version 450 
 
-layout(push_constant) uniform PushConstantData {
-	mat2 transform;
-	vec2 offset;
-	vec4 colour;
-} pushConstantData;
+// Specialization constants, fixed per pipeline variant (see SandboxApp::getShaderVariant())
+layout(constant_id = 1) const bool TEXTURED = true;
+layout(constant_id = 2) const uint DEBUG_VIEW = 0; // SandboxConfig::DebugView: 0 off, 1 UVs, 2 colour per instance
+
+layout(location = 0) in vec4 in_colour;
+layout(location = 1) in vec2 in_uv;
+layout(location = 2) flat in uint in_instance;
+
+// Binding 1 of the frame set, or the first element of the bindless texture array (see SandboxApp::createDescriptors)
+layout(set = 0, binding = 1) uniform sampler2D sandboxTexture;
 
 layout(location = 0) out vec4 fragColour;
 
 void main() {
-	fragColour = pushConstantData.colour;
-}
\ No newline at end of file
+	if (DEBUG_VIEW == 1) {
+		fragColour = vec4(in_uv, 0.0, 1.0);
+	} else if (DEBUG_VIEW == 2) {
+		// Cheap integer hash, so neighbouring instances get clearly different colours
+		uint hash = in_instance * 2654435761u;
+		fragColour = vec4(vec3((hash >> 8) & 255u, (hash >> 16) & 255u, (hash >> 24) & 255u) / 255.0, 1.0);
+	} else if (TEXTURED) {
+		fragColour = in_colour * texture(sandboxTexture, in_uv);
+	} else {
+		fragColour = in_colour;
+	}
+}
@@ -1,13 +1,25 @@
 #version 450 
 
+// Specialization constants, fixed per pipeline variant (see SandboxApp::getShaderVariant())
+layout(constant_id = 0) const bool VERTEX_COLOURS = false;
+
 layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec4 in_vertexColour;
+layout(location = 6) in vec2 in_uv;
+
+// Per-instance attributes, see Model::InstanceData
+layout(location = 2) in mat2 in_transform; // mat2 takes up locations 2 and 3
+layout(location = 4) in vec2 in_offset;
+layout(location = 5) in vec4 in_colour;
 
-layout(push_constant) uniform PushConstantData {
-	mat2 transform;
-	vec2 offset;
-	vec4 colour;
-} pushConstantData;
+layout(location = 0) out vec4 out_colour;
+layout(location = 1) out vec2 out_uv;
+layout(location = 2) flat out uint out_instance;
 
 void main() {
-	gl_Position = vec4((pushConstantData.transform * in_position) + pushConstantData.offset, 0.0, 1.0);
-}
\ No newline at end of file
+	gl_Position = vec4((in_transform * in_position) + in_offset, 0.0, 1.0);
+	// A constant condition, the unused side is removed when the pipeline is created
+	out_colour = VERTEX_COLOURS ? in_colour * in_vertexColour : in_colour;
+	out_uv = in_uv;
+	out_instance = gl_InstanceIndex;
+}